@@ -16,6 +16,7 @@ if (maek.OS === 'linux') {
 
 	maek.options.CPPFlags = [
 		'-O2',
+		'-mssse3', // SIMD paths, e.g. the frame readback swizzle
 		`-I${VULKAN_SDK}/include`
 	];
 
@@ -183,7 +184,9 @@ maek.GLSLC = (glslFile, spirvFileBase, localOptions = {}) => {
 
 const shaders = [
 	maek.GLSLC('src\\Main\\shader\\s72.vert'),
+	maek.GLSLC('src\\Main\\shader\\s72_depth.vert'),
 	maek.GLSLC('src\\Main\\shader\\s72.frag'),
+	maek.GLSLC('src\\Main\\shader\\s72_bindless.frag'),
 ];
 
 // #TODO: compile shaders
@@ -192,6 +195,7 @@ const shaders = [
 async function main() {
     let AllSources = await compileEngineSources('src\\Engine');
     AllSources.push(compileSource('main.cpp', 'src\\Main'));
+    AllSources.push(compileSource('Benchmark.cpp', 'src\\Main'));
     // AllSources.push(shaders_obj);
 
     const Main_exe = maek.LINK(AllSources, `build\\${PROFILE}\\Main`);
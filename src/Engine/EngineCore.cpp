@@ -1,5 +1,9 @@
 #include "EngineCore.hpp"
 #include "IO/IOInput.hpp"
+#include "Threading/JobSystem.hpp"
+#include "Utilities/FrameProfiler.hpp"
+#include "Utilities/FramePacer.hpp"
+#include "Utilities/Trace.hpp"
 #include "pch.hpp"
 
 // #include "GraphicsCore.hpp"
@@ -40,15 +44,50 @@ void TerminateApplication(IApp& app)
     // GameInput::Shutdown();
 }
 
-bool UpdateApplication(IApp& app)
+static float ComputeDeltaTime(const IWindow& window)
 {
-    // EngineProfiling::Update();
-
-    static auto startTime = std::chrono::high_resolution_clock::now();
     static auto lastTime = std::chrono::high_resolution_clock::now();
     auto currentTime = std::chrono::high_resolution_clock::now();
     float DeltaTime = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - lastTime).count();
     lastTime = currentTime;
+    // A headless window in virtual time steps by its event timestamps instead
+    return window.GetFrameDeltaTime().value_or(DeltaTime);
+}
+
+// Simulation job of the pipelined mode, at most one is in flight
+static JobCounter s_simulationCounter;
+
+void WaitForSimulation()
+{
+    JobSystem::GetInstance().Wait(s_simulationCounter);
+}
+
+// Frame N is rendered on the calling thread while frame N+1 is simulated on a job thread.
+// The window is pumped in between, while the simulation is idle, so event handlers never race with it.
+bool UpdateApplicationPipelined(IApp& app, IWindow& window)
+{
+    WaitForSimulation();
+    app.PublishRenderSnapshot();
+
+    window.Update();
+
+    float DeltaTime = ComputeDeltaTime(window);
+    JobSystem::GetInstance().Run("Simulation", [&app, DeltaTime]() {
+        app.Update(DeltaTime);
+        app.ExtractRenderSnapshot();
+    },
+        &s_simulationCounter);
+
+    app.RenderScene();
+
+    return !app.IsDone();
+}
+
+bool UpdateApplication(IApp& app, IWindow& window)
+{
+    // EngineProfiling::Update();
+
+    float DeltaTime = ComputeDeltaTime(window);
     // float ElapsedTime = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
 
     // float DeltaTime = Graphics::GetFrameTime();
@@ -57,6 +96,8 @@ bool UpdateApplication(IApp& app)
     // EngineTuning::Update(DeltaTime);
     //
     app.Update(DeltaTime);
+    app.ExtractRenderSnapshot();
+    app.PublishRenderSnapshot();
     app.RenderScene();
 
     // PostEffects::Render();
@@ -79,6 +120,17 @@ bool UpdateApplication(IApp& app)
     return !app.IsDone();
 }
 
+// Sleeps through the time an idle app would otherwise spin until the window has something to process
+static void WaitWhileIdle(IApp& app, IWindow& window, Utility::FramePacer& pacer)
+{
+    if (!app.IsIdle())
+        return;
+    if (auto nextEventTime = window.GetNextEventTime()) {
+        Utility::ScopedCpuTimer idleTimer(Utility::ECpuPhase::Idle);
+        pacer.WaitUntil(*nextEventTime);
+    }
+}
+
 // Default implementation to be overridden by the application
 bool IApp::IsDone(void)
 {
@@ -126,6 +178,24 @@ int RunApplication(IApp&& app, const char* className, const Utility::ArgsParser&
 {
     app.ParseArguments(args);
 
+    Utility::Tracer& tracer = Utility::Tracer::GetInstance();
+    if (app.args.traceOutputPath.has_value()) {
+        tracer.Init(app.args.traceOutputPath.value());
+        tracer.SetThreadName("Main");
+    }
+
+    JobSystem::GetInstance().Init(app.args.workerThreads.value_or(JobSystem::DefaultWorkerCount()), app.args.pinThreads);
+    if (Utility::Tracer::IsEnabled()) {
+        JobSystem::GetInstance().SetInstrumentationHook([](const JobTiming& timing) {
+            thread_local bool isNamed = false;
+            if (!isNamed && timing.threadIndex != 0) {
+                Utility::Tracer::GetInstance().SetThreadName("Worker " + std::to_string(timing.threadIndex));
+                isNamed = true;
+            }
+            Utility::Tracer::GetInstance().Record(timing.name ? timing.name : "Job", timing.start, timing.end);
+        });
+    }
+
     auto windowSize = app.GetWindowSize();
     std::shared_ptr<IWindow> window = CreateIWindow(app.args.headlessEventsPath);
     window->Create(className, windowSize.first, windowSize.second, app);
@@ -133,13 +203,30 @@ int RunApplication(IApp&& app, const char* className, const Utility::ArgsParser&
     app.bindWindow(window);
     InitializeApplication(app);
 
-    while (!window->ShouldClose()) {
-        window->Update();
-        UpdateApplication(app);
+    Utility::FramePacer pacer;
+    if (app.args.pipelined) {
+        while (!window->ShouldClose()) {
+            UpdateApplicationPipelined(app, *window);
+            WaitWhileIdle(app, *window, pacer);
+            if (Utility::Tracer::IsEnabled())
+                tracer.Flush();
+        }
+        WaitForSimulation();
+    } else {
+        while (!window->ShouldClose()) {
+            window->Update();
+            UpdateApplication(app, *window);
+            WaitWhileIdle(app, *window, pacer);
+            if (Utility::Tracer::IsEnabled())
+                tracer.Flush();
+        }
     }
+    pacer.PrintStatistics();
 
     TerminateApplication(app);
     window->Destroy();
+    JobSystem::GetInstance().Shutdown();
+    tracer.Shutdown(); // After the workers are joined
 
     return 0;
 }
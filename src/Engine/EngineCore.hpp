@@ -19,11 +19,23 @@ public:
     // Decide if you want the app to exit.  By default, app continues until the 'ESC' key is pressed.
     virtual bool IsDone(void);
 
+    // Nothing changes until the window's next event, e.g. a headless -limitfps run waiting for an AVAILABLE image.
+    // The main loop then sleeps until that event instead of spinning.
+    virtual bool IsIdle(void) { return false; }
+
     // The update method will be invoked once per frame.  Both state updating and scene
     // rendering should be handled by this method.
     virtual void Update(float deltaT) = 0;
 
-    // Official rendering pass
+    // Copies what the renderer needs out of the simulation state into the back render snapshot.
+    // In pipelined mode this runs on a job thread right after Update(), concurrently with RenderScene().
+    virtual void ExtractRenderSnapshot(void) = 0;
+
+    // Makes the last extracted snapshot the one RenderScene() draws.
+    // Called while neither the simulation nor the renderer touch the snapshots.
+    virtual void PublishRenderSnapshot(void) = 0;
+
+    // Official rendering pass, draws the published render snapshot
     virtual void RenderScene(void) = 0;
 
     virtual std::pair<int, int> GetWindowSize() = 0;
@@ -62,6 +74,7 @@ public:
     struct ApplicationArgs {
         std::string scenePath;
         std::optional<std::string> cameraName;
+        std::optional<std::vector<std::string>> renderCameras; // Camera names or "all", rendered every frame in one submission
         std::optional<std::string> physicalDeviceName;
         std::pair<int, int> windowSize = { 800, 600 };
         std::optional<std::string> cullingType;
@@ -69,6 +82,22 @@ public:
         bool measure = false;
         bool limitFPS = false;
         bool headlessIgnoreSaveFrame = false;
+        std::optional<uint32_t> workerThreads; // Defaults to hardware threads - 1
+        bool pinThreads = false;
+        bool pipelined = false; // Simulate frame N+1 while frame N is rendered
+        bool uberShader = false; // One pipeline that branches on the material type instead of one specialized pipeline per type
+        bool bindless = false; // All material textures in one descriptor array, needs descriptor indexing
+        std::string pipelineCachePath = "pipeline_cache.bin"; // Empty keeps the pipeline cache in memory only
+        std::optional<std::string> profileOutputPath; // Per frame CPU/GPU timings, CSV or .json
+        std::optional<std::string> metricsOutputPath; // Frame time and CPU phase percentiles per MARK segment, CSV or .json
+        std::optional<std::string> traceOutputPath; // Chrome trace event JSON of the TRACE_ZONE scopes and jobs
+        uint32_t framesInFlight = 2; // Frames the CPU may record ahead of the GPU, clamped to [1, MAX_FRAMES_IN_FLIGHT]
+        bool depthPrepass = false; // Depth-only pass over a position stream first, then shade with an EQUAL depth test
+        uint32_t headlessImages = 3; // Images of the headless fake swap chain, the most AVAILABLE events that can be pending
+        bool virtualTime = false; // Headless event timestamps drive the simulation clock, frames render back to back
+        std::string lambertianMode = "sh"; // Environment diffuse lighting: "sh" spherical harmonics or "montecarlo" blur_cube
+        std::string iblCachePath = "ibl_cache"; // Directory of the generated environment lighting, empty regenerates it every run
+        std::vector<std::string> iblAssetPaths; // Read-only directories searched for generated environment lighting first
     } args;
 };
 }
@@ -0,0 +1,219 @@
+#include "BindlessMaterials.hpp"
+#include "Scene/Material.hpp"
+#include "VulkanCore.hpp"
+
+bool BindlessMaterials::IsSupported(VkPhysicalDevice physicalDevice)
+{
+    VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES,
+    };
+    VkPhysicalDeviceFeatures2 features {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &indexingFeatures,
+    };
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+    // Indices are dynamically uniform (one material per draw), non-uniform indexing is not needed
+    return indexingFeatures.runtimeDescriptorArray && indexingFeatures.descriptorBindingPartiallyBound && indexingFeatures.descriptorBindingVariableDescriptorCount;
+}
+
+VkPhysicalDeviceDescriptorIndexingFeatures BindlessMaterials::GetRequiredFeatures()
+{
+    return VkPhysicalDeviceDescriptorIndexingFeatures {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES,
+        .descriptorBindingPartiallyBound = VK_TRUE,
+        .descriptorBindingVariableDescriptorCount = VK_TRUE,
+        .runtimeDescriptorArray = VK_TRUE,
+    };
+}
+
+uint32_t BindlessMaterials::GetMaxTextureCount(VkPhysicalDevice physicalDevice, uint32_t reservedSamplers)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    uint32_t limit = std::min(properties.limits.maxPerStageDescriptorSamplers, properties.limits.maxPerStageDescriptorSampledImages);
+    limit = std::min({ limit, properties.limits.maxDescriptorSetSamplers, properties.limits.maxDescriptorSetSampledImages });
+    return std::min(kMaxTextures, limit > reservedSamplers ? limit - reservedSamplers : 0u);
+}
+
+VkDescriptorSetLayout BindlessMaterials::CreateDescriptorSetLayout(VkDevice device, uint32_t maxTextureCount)
+{
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings {
+        VkDescriptorSetLayoutBinding {
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        },
+        {
+            .binding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = maxTextureCount,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        },
+    };
+    // The texture array is the last binding, so its size is chosen when the set is allocated
+    std::array<VkDescriptorBindingFlags, 2> bindingFlags {
+        0,
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT,
+    };
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+        .bindingCount = static_cast<uint32_t>(bindingFlags.size()),
+        .pBindingFlags = bindingFlags.data(),
+    };
+    VkDescriptorSetLayoutCreateInfo layoutInfo {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = &bindingFlagsInfo,
+        .bindingCount = static_cast<uint32_t>(bindings.size()),
+        .pBindings = bindings.data(),
+    };
+
+    VkDescriptorSetLayout layout;
+    VK(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout));
+    return layout;
+}
+
+void BindlessMaterials::Init(VulkanCore* pVulkanCore, VkDescriptorSetLayout layout, uint32_t maxTextureCount)
+{
+    m_pVulkanCore = pVulkanCore;
+    m_layout = layout;
+    m_maxTextureCount = maxTextureCount;
+
+    // Index 0 is the fallback for every missing map, same as the per material descriptor sets
+    AddTexture(*g_emptyTexture);
+}
+
+void BindlessMaterials::Destroy()
+{
+    VkDevice device = m_pVulkanCore->GetDevice();
+    if (m_descriptorPool != VK_NULL_HANDLE)
+        vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+    m_descriptorPool = VK_NULL_HANDLE;
+    m_descriptorSet = VK_NULL_HANDLE;
+
+    if (m_materialBuffer.m_isValid)
+        m_materialBuffer.Destroy();
+
+    m_materials.clear();
+    m_textures.clear();
+    m_textureIndices.clear();
+}
+
+uint32_t BindlessMaterials::AddTexture(Texture& texture)
+{
+    auto it = m_textureIndices.find(&texture);
+    if (it != m_textureIndices.end())
+        return it->second;
+
+    if (m_textures.size() >= m_maxTextureCount)
+        throw std::runtime_error("BindlessMaterials: the scene has more textures than the device can bind (" + std::to_string(m_maxTextureCount) + "), run without --bindless");
+
+    texture.uploadTextureToGPU(m_pVulkanCore);
+    uint32_t index = static_cast<uint32_t>(m_textures.size());
+    m_textures.push_back(&texture);
+    m_textureIndices.emplace(&texture, index);
+    return index;
+}
+
+uint32_t BindlessMaterials::AddMaterial(Material& material)
+{
+    if (material.bindlessIndex != UINT32_MAX)
+        return material.bindlessIndex;
+    assert(m_descriptorSet == VK_NULL_HANDLE && "Materials have to be added before Finalize()");
+
+    auto textures = material.GetTextures();
+    material.bindlessIndex = static_cast<uint32_t>(m_materials.size());
+    m_materials.push_back(MaterialParameters {
+        .albedo = AddTexture(*textures[0]),
+        .roughness = AddTexture(*textures[1]),
+        .metalness = AddTexture(*textures[2]),
+        .normal = AddTexture(*textures[3]),
+        .type = static_cast<uint32_t>(material.type),
+    });
+    return material.bindlessIndex;
+}
+
+void BindlessMaterials::Finalize()
+{
+    assert(m_descriptorSet == VK_NULL_HANDLE);
+    VkDevice device = m_pVulkanCore->GetDevice();
+
+    // Draws without a material are skipped, but keep the buffer non-empty
+    if (m_materials.empty())
+        m_materials.push_back(MaterialParameters { 0, 0, 0, 0, static_cast<uint32_t>(EMaterialType::SIMPLE) });
+
+    VkDeviceSize bufferSize = sizeof(MaterialParameters) * m_materials.size();
+    m_materialBuffer.Init(m_pVulkanCore, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_materialBuffer.UploadData(m_materials.data(), bufferSize);
+
+    uint32_t textureCount = static_cast<uint32_t>(m_textures.size());
+    std::array<VkDescriptorPoolSize, 2> poolSizes {
+        VkDescriptorPoolSize {
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+        },
+        {
+            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = textureCount,
+        },
+    };
+    VkDescriptorPoolCreateInfo poolInfo {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = 1,
+        .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+        .pPoolSizes = poolSizes.data(),
+    };
+    VK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &m_descriptorPool));
+
+    VkDescriptorSetVariableDescriptorCountAllocateInfo variableCountInfo {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO,
+        .descriptorSetCount = 1,
+        .pDescriptorCounts = &textureCount,
+    };
+    VkDescriptorSetAllocateInfo allocInfo {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = &variableCountInfo,
+        .descriptorPool = m_descriptorPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &m_layout,
+    };
+    VK(vkAllocateDescriptorSets(device, &allocInfo, &m_descriptorSet));
+
+    VkDescriptorBufferInfo bufferInfo {
+        .buffer = m_materialBuffer.buffer,
+        .offset = 0,
+        .range = bufferSize,
+    };
+    std::vector<VkDescriptorImageInfo> imageInfos;
+    imageInfos.reserve(textureCount);
+    for (Texture* pTexture : m_textures)
+        imageInfos.push_back(pTexture->textureImage.GetDescriptorImageInfo());
+
+    std::array<VkWriteDescriptorSet, 2> descriptorWrites {
+        VkWriteDescriptorSet {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = m_descriptorSet,
+            .dstBinding = 0,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pBufferInfo = &bufferInfo,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = m_descriptorSet,
+            .dstBinding = 1,
+            .dstArrayElement = 0,
+            .descriptorCount = textureCount,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .pImageInfo = imageInfos.data(),
+        },
+    };
+    vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+
+#if VERBOSE
+    std::cout << "BindlessMaterials: " << m_materials.size() << " materials, " << textureCount << "/" << m_maxTextureCount << " textures" << std::endl;
+#endif
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Buffer.hpp"
+#include "pch.hpp"
+
+class Material;
+class Texture;
+class VulkanCore;
+
+// Descriptor indexing ("bindless") material table.
+// Every material texture of the scene sits in one variable sized sampler array and every material is one entry of a storage buffer
+// holding texture indices and the material type. The whole table is a single descriptor set, bound once per frame. Draws select
+// their material through firstInstance, which the vertex shader forwards as gl_InstanceIndex.
+// Layout (set = 1): binding 0 = MaterialParameters[], binding 1 = sampler2D[]. Must match s72_shading.glsl.
+class BindlessMaterials {
+public:
+    struct MaterialParameters {
+        uint32_t albedo;
+        uint32_t roughness;
+        uint32_t metalness;
+        uint32_t normal;
+        uint32_t type; // EMaterialType
+    };
+    static_assert(sizeof(MaterialParameters) == 20, "std430 layout of MaterialParameters in s72_shading.glsl");
+
+    static constexpr uint32_t kMaxTextures = 16384;
+
+    // Device features the bindless path needs, chained into vkCreateDevice when supported
+    static bool IsSupported(VkPhysicalDevice physicalDevice);
+    static VkPhysicalDeviceDescriptorIndexingFeatures GetRequiredFeatures();
+    // Number of textures the variable sized array can hold on this device, leaves room for the global set's samplers
+    static uint32_t GetMaxTextureCount(VkPhysicalDevice physicalDevice, uint32_t reservedSamplers);
+    static VkDescriptorSetLayout CreateDescriptorSetLayout(VkDevice device, uint32_t maxTextureCount);
+
+    void Init(VulkanCore* pVulkanCore, VkDescriptorSetLayout layout, uint32_t maxTextureCount);
+    void Destroy();
+
+    // Uploads the material's textures and assigns its table index, once per material
+    uint32_t AddMaterial(Material& material);
+    // Uploads the parameter buffer and writes every descriptor, call once after all materials were added
+    void Finalize();
+
+    VkDescriptorSet GetDescriptorSet() const { return m_descriptorSet; }
+    uint32_t GetMaterialCount() const { return static_cast<uint32_t>(m_materials.size()); }
+    uint32_t GetTextureCount() const { return static_cast<uint32_t>(m_textures.size()); }
+
+private:
+    uint32_t AddTexture(Texture& texture);
+
+private:
+    VulkanCore* m_pVulkanCore = nullptr;
+    VkDescriptorSetLayout m_layout = VK_NULL_HANDLE; // Owned by VulkanCore
+    uint32_t m_maxTextureCount = 0;
+
+    VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
+    Buffer m_materialBuffer;
+
+    std::vector<MaterialParameters> m_materials;
+    std::vector<Texture*> m_textures;
+    std::unordered_map<const Texture*, uint32_t> m_textureIndices;
+};
@@ -17,18 +17,8 @@ bool Buffer::Init(const VulkanCore* pVulkanCore, VkDeviceSize size, VkBufferUsag
     VK(vkCreateBuffer(m_pVulkanCore->GetDevice(), &bufferInfo, nullptr, &buffer));
     m_bufferInfo = std::move(bufferInfo);
 
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(m_pVulkanCore->GetDevice(), buffer, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .allocationSize = memRequirements.size,
-        .memoryTypeIndex = m_pVulkanCore->findMemoryType(memRequirements.memoryTypeBits, properties),
-    };
-
-    VK(vkAllocateMemory(m_pVulkanCore->GetDevice(), &allocInfo, nullptr, &bufferMemory));
-
-    vkBindBufferMemory(m_pVulkanCore->GetDevice(), buffer, bufferMemory, 0);
+    m_allocation = m_pVulkanCore->GetMemoryAllocator().AllocateForBuffer(buffer, properties);
+    VK(vkBindBufferMemory(m_pVulkanCore->GetDevice(), buffer, m_allocation.memory, m_allocation.offset));
     m_isValid = true;
     m_mappable = (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
     if (m_mappable && alwaysMap)
@@ -39,27 +29,23 @@ bool Buffer::Init(const VulkanCore* pVulkanCore, VkDeviceSize size, VkBufferUsag
 void Buffer::Destroy()
 {
     if (m_isValid) {
-        if (m_pMappedData)
-            Unmap();
         vkDestroyBuffer(m_pVulkanCore->GetDevice(), buffer, nullptr);
-        vkFreeMemory(m_pVulkanCore->GetDevice(), bufferMemory, nullptr);
+        m_pVulkanCore->GetMemoryAllocator().Free(m_allocation);
+        m_pMappedData = std::nullopt;
         m_isValid = false;
     }
 }
 
+// Host visible memory is persistently mapped by the allocator, Map/Unmap only hand out the pointer
 void* Buffer::Map()
 {
     if (!m_mappable)
         return nullptr;
-    void* data;
-    VK(vkMapMemory(m_pVulkanCore->GetDevice(), bufferMemory, 0, m_bufferInfo.size, 0, &data));
-    return data;
+    return m_allocation.pMapped;
 }
 
 void Buffer::Unmap()
 {
-    if (m_mappable)
-        vkUnmapMemory(m_pVulkanCore->GetDevice(), bufferMemory);
 }
 
 void Buffer::CopyToBuffer(Buffer& dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset /*= 0*/, VkDeviceSize dstOffset /*= 0*/)
@@ -77,21 +63,10 @@ void Buffer::CopyToBuffer(Buffer& dstBuffer, VkDeviceSize size, VkDeviceSize src
     m_pVulkanCore->endSingleTimeCommands(commandBuffer);
 }
 
+// Recorded into the upload manager's current batch, the data is on the GPU once the batch is flushed and completed
 void Buffer::UploadData(const void* data, VkDeviceSize size)
 {
-    // Create a staging buffer
-    Buffer stagingBuffer;
-    stagingBuffer.Init(m_pVulkanCore, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-    // Map memory and copy data to the staging buffer
-    void* mappedData = stagingBuffer.Map();
-    memcpy(mappedData, data, static_cast<size_t>(size));
-    stagingBuffer.Unmap();
-
-    stagingBuffer.CopyToBuffer(*this, size);
-
-    // Clean up the staging buffer
-    stagingBuffer.Destroy();
+    m_pVulkanCore->GetUploadManager().UploadToBuffer(*this, data, size);
 }
 
 void Buffer::CopyToImage(Image& image)
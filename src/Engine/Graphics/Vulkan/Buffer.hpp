@@ -1,5 +1,6 @@
 #pragma once
 
+#include "MemoryAllocator.hpp"
 #include "pch.hpp"
 
 class Image;
@@ -21,7 +22,7 @@ public:
     bool m_isValid = false;
 
     VkBuffer buffer;
-    VkDeviceMemory bufferMemory;
+    MemoryAllocation m_allocation;
     VkBufferView bufferView;
     VkBufferCreateInfo m_bufferInfo;
 
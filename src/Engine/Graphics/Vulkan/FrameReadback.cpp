@@ -0,0 +1,212 @@
+#include "FrameReadback.hpp"
+#include "Image.hpp"
+#include "VulkanCore.hpp"
+
+// frame.ppm of the view "Camera 1" is written to frame.Camera 1.ppm
+static std::string GetViewPath(const std::string& savePath, const std::string& viewName)
+{
+    if (viewName.empty())
+        return savePath;
+
+    std::string suffix = "." + viewName;
+    std::replace_if(suffix.begin(), suffix.end(), [](char c) { return c == '/' || c == '\\'; }, '_');
+    std::filesystem::path path(savePath);
+    std::filesystem::path extension = path.extension();
+    path.replace_extension();
+    path += suffix;
+    path += extension;
+    return path.string();
+}
+
+void FrameReadback::Init(VulkanCore* pVulkanCore, VkSemaphore frameTimeline, uint32_t ringSize, std::vector<std::string> viewNames)
+{
+    assert(!viewNames.empty());
+    m_pVulkanCore = pVulkanCore;
+    m_frameTimeline = frameTimeline;
+    m_viewNames = std::move(viewNames);
+    m_slots.resize(ringSize);
+}
+
+void FrameReadback::Destroy()
+{
+    WaitIdle();
+    m_sinks.CloseAll();
+    DestroyBuffers();
+    m_slots.clear();
+    m_lastRecordedSlot.reset();
+}
+
+void FrameReadback::WaitIdle()
+{
+    if (!m_pendingSaves.empty())
+        DispatchSaves(m_pendingSaves.back().timelineValue);
+    auto& jobSystem = EngineCore::JobSystem::GetInstance();
+    for (auto& slot : m_slots)
+        jobSystem.Wait(*slot.readers);
+    jobSystem.Wait(m_encoders);
+}
+
+void FrameReadback::CreateBuffers(VkExtent2D extent)
+{
+    m_extent = extent;
+    VkDeviceSize bufferSize = VkDeviceSize(extent.width) * extent.height * 4;
+    for (auto& slot : m_slots) {
+        slot.buffers.resize(m_viewNames.size());
+        for (auto& buffer : slot.buffers)
+            buffer.Init(m_pVulkanCore, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, true);
+    }
+}
+
+void FrameReadback::WaitForCopies()
+{
+    uint64_t lastFrameIndex = 0;
+    bool hasRecordedFrames = false;
+    for (const auto& slot : m_slots) {
+        if (slot.frameIndex) {
+            lastFrameIndex = std::max(lastFrameIndex, *slot.frameIndex);
+            hasRecordedFrames = true;
+        }
+    }
+    if (!hasRecordedFrames)
+        return;
+
+    // Frame i signals i + 1 on the frame timeline
+    uint64_t timelineValue = lastFrameIndex + 1;
+    VkSemaphoreWaitInfo waitInfo {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &m_frameTimeline,
+        .pValues = &timelineValue,
+    };
+    VK(vkWaitSemaphores(m_pVulkanCore->GetDevice(), &waitInfo, UINT64_MAX));
+}
+
+void FrameReadback::DestroyBuffers()
+{
+    for (auto& slot : m_slots) {
+        for (auto& buffer : slot.buffers)
+            buffer.Destroy();
+        slot.buffers.clear();
+        slot.frameIndex.reset();
+    }
+    m_extent = {};
+}
+
+void FrameReadback::RecordCopy(VkCommandBuffer commandBuffer, const std::vector<Image*>& images, uint64_t frameIndex)
+{
+    assert(images.size() == m_viewNames.size());
+    VkExtent2D extent { images[0]->m_imageInfo.extent.width, images[0]->m_imageInfo.extent.height };
+    if (extent.width != m_extent.width || extent.height != m_extent.height) {
+        // Resized, the old buffers go once the frames in flight have copied into them and their pending saves are done
+        WaitForCopies();
+        WaitIdle();
+        DestroyBuffers();
+        CreateBuffers(extent);
+        m_lastRecordedSlot.reset();
+    }
+
+    // The ring is at least as long as the frames in flight, so the GPU is done with the slot and the wait below returns right away.
+    // Its pending saves have to be read out before it is reused, their readers may still be busy.
+    uint64_t slotWaitValue = 0;
+    for (const auto& save : m_pendingSaves) {
+        if (save.slot == m_nextSlot)
+            slotWaitValue = std::max(slotWaitValue, save.timelineValue);
+    }
+    DispatchSaves(slotWaitValue);
+    Slot& slot = m_slots[m_nextSlot];
+    EngineCore::JobSystem::GetInstance().Wait(*slot.readers);
+    slot.frameIndex = frameIndex;
+    m_lastRecordedSlot = m_nextSlot;
+    m_nextSlot = (m_nextSlot + 1) % m_slots.size();
+
+    for (size_t i = 0; i < images.size(); i++) {
+        Image& image = *images[i];
+        VkImageLayout oldLayout = image.m_currentLayout;
+        image.TransitionLayout(commandBuffer, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        image.CopyToBuffer(commandBuffer, slot.buffers[i]);
+        image.TransitionLayout(commandBuffer, oldLayout);
+    }
+
+    // Make the copy visible to the host once the frame timeline signals
+    VkMemoryBarrier hostBarrier {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+}
+
+void FrameReadback::RequestSave(const std::string& savePath)
+{
+    if (!m_lastRecordedSlot) {
+        std::cerr << "FrameReadback: no frame has been rendered yet, skipping " << savePath << std::endl;
+        return;
+    }
+
+    auto& jobSystem = EngineCore::JobSystem::GetInstance();
+    if (m_queuedFrames.load(std::memory_order_relaxed) >= kMaxQueuedFrames)
+        jobSystem.Wait(m_encoders); // Encoding fell behind, bound the memory held by queued frames
+
+    Slot& slot = m_slots[*m_lastRecordedSlot];
+    PendingSave save { .slot = *m_lastRecordedSlot, .timelineValue = *slot.frameIndex + 1, .savePath = savePath };
+    for (size_t i = 0; i < m_viewNames.size(); i++)
+        save.tickets.push_back(m_sinks.Open(GetViewPath(savePath, m_viewNames[i])));
+    m_queuedFrames.fetch_add(static_cast<uint32_t>(m_viewNames.size()), std::memory_order_relaxed);
+    m_pendingSaves.push_back(std::move(save));
+}
+
+void FrameReadback::DispatchSaves(uint64_t waitValue)
+{
+    if (m_pendingSaves.empty())
+        return;
+
+    VkDevice device = m_pVulkanCore->GetDevice();
+    VkResult result = VK_SUCCESS;
+    if (waitValue > 0) {
+        VkSemaphoreWaitInfo waitInfo {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+            .semaphoreCount = 1,
+            .pSemaphores = &m_frameTimeline,
+            .pValues = &waitValue,
+        };
+        result = vkWaitSemaphores(device, &waitInfo, UINT64_MAX);
+    }
+    uint64_t completedValue = 0;
+    if (result == VK_SUCCESS)
+        result = vkGetSemaphoreCounterValue(device, m_frameTimeline, &completedValue);
+    if (result != VK_SUCCESS) {
+        // None of the pending frames will arrive. Streams write in sequence order, later frames would wait for these forever.
+        for (const auto& save : m_pendingSaves) {
+            std::cerr << "FrameReadback: waiting for the frame failed, skipping " << save.savePath << std::endl;
+            for (const auto& ticket : save.tickets)
+                ticket.sink->Skip(ticket.sequence);
+            m_queuedFrames.fetch_sub(static_cast<uint32_t>(save.tickets.size()), std::memory_order_relaxed);
+        }
+        m_pendingSaves.clear();
+        return;
+    }
+
+    auto& jobSystem = EngineCore::JobSystem::GetInstance();
+    for (; !m_pendingSaves.empty() && m_pendingSaves.front().timelineValue <= completedValue; m_pendingSaves.pop_front()) {
+        const PendingSave& save = m_pendingSaves.front();
+        Slot& slot = m_slots[save.slot];
+        std::vector<const uint8_t*> viewData;
+        for (const auto& buffer : slot.buffers)
+            viewData.push_back(static_cast<const uint8_t*>(*buffer.m_pMappedData));
+        VkExtent2D extent = m_extent;
+
+        jobSystem.Run("ReadbackFrame", [this, viewData, extent, tickets = save.tickets]() {
+            // Copy out so the ring slot is free again before the slow part, then encode every view on its own
+            for (size_t i = 0; i < tickets.size(); i++) {
+                const uint8_t* pData = viewData[i];
+                auto pixels = std::make_shared<std::vector<uint8_t>>(pData, pData + size_t(extent.width) * extent.height * 4);
+                EngineCore::JobSystem::GetInstance().Run("EncodeFrame", [this, pixels, extent, ticket = tickets[i]]() {
+                    ticket.sink->Write(ticket.sequence, Utility::FrameView { .pBGRA = pixels->data(), .width = extent.width, .height = extent.height });
+                    m_queuedFrames.fetch_sub(1, std::memory_order_relaxed);
+                },
+                    &m_encoders);
+            }
+        },
+            slot.readers.get());
+    }
+}
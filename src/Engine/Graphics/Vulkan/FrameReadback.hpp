@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Buffer.hpp"
+#include "Threading/JobSystem.hpp"
+#include "Utilities/FrameSinks.hpp"
+#include "pch.hpp"
+
+class Image;
+class VulkanCore;
+
+// Ring of persistently mapped host-visible buffers for headless frame capture (SAVE events).
+// Every headless frame copies its resolved image into the next ring buffer from inside its own command buffer. A save request is
+// only queued; every frame RecordCopy polls the frame timeline semaphore and hands the saves whose frame is done to a job that copies
+// it out of the ring. Encoding and writing (see Utility::FrameSinks, picked by the path's extension) run as separate jobs, so the
+// render loop never waits for the encoder or the disk, and no job ever blocks on the GPU. A ring buffer is only reused once its frame
+// was copied out.
+// With several views (-render-cameras) every slot holds one buffer per view and a save writes one file per view, named
+// <stem>.<view name><extension>.
+class FrameReadback {
+public:
+    // viewNames has one entry per image RecordCopy is given, an empty name keeps the SAVE path as is
+    void Init(VulkanCore* pVulkanCore, VkSemaphore frameTimeline, uint32_t ringSize, std::vector<std::string> viewNames);
+    // Waits for every queued write
+    void Destroy();
+
+    // Records the copies of the frame's resolved color images, one per view and all of the same size, after rendering.
+    // frameIndex + 1 is the frame timeline value of the submission the command buffer belongs to.
+    void RecordCopy(VkCommandBuffer commandBuffer, const std::vector<Image*>& images, uint64_t frameIndex);
+    // Writes the most recently recorded frame to savePath, returns right away. Same thread as RecordCopy.
+    void RequestSave(const std::string& savePath);
+    void WaitIdle();
+
+private:
+    struct Slot {
+        std::vector<Buffer> buffers; // One per view
+        std::optional<uint64_t> frameIndex; // Frame whose copies the buffers hold or will hold
+        std::unique_ptr<EngineCore::JobCounter> readers = std::make_unique<EngineCore::JobCounter>();
+    };
+
+    // A save whose frame the GPU may not have finished yet
+    struct PendingSave {
+        uint32_t slot;
+        uint64_t timelineValue;
+        std::vector<Utility::FrameSinkTicket> tickets; // One per view
+        std::string savePath;
+    };
+
+    // Frames copied out of the ring but not written yet, beyond this the next save waits for the encoders to catch up
+    static constexpr uint32_t kMaxQueuedFrames = 16;
+
+    void CreateBuffers(VkExtent2D extent);
+    // Waits for the GPU copies of every recorded frame, they may still be writing to the buffers
+    void WaitForCopies();
+    // Waits for the frame timeline to reach waitValue, 0 does not wait, then starts the readers of the pending saves the GPU is done with
+    void DispatchSaves(uint64_t waitValue);
+    void DestroyBuffers();
+
+private:
+    VulkanCore* m_pVulkanCore = nullptr;
+    VkSemaphore m_frameTimeline = VK_NULL_HANDLE; // Owned by VulkanCore
+    VkExtent2D m_extent {};
+    std::vector<std::string> m_viewNames;
+
+    std::vector<Slot> m_slots;
+    uint32_t m_nextSlot = 0;
+    std::optional<uint32_t> m_lastRecordedSlot;
+    std::deque<PendingSave> m_pendingSaves; // In timeline order
+
+    Utility::FrameSinks m_sinks;
+    EngineCore::JobCounter m_encoders;
+    std::atomic<uint32_t> m_queuedFrames { 0 };
+};
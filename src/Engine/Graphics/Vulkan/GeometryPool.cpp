@@ -0,0 +1,265 @@
+#include "GeometryPool.hpp"
+#include "VulkanCore.hpp"
+
+void GeometryPool::Init(VulkanCore* pVulkanCore, uint32_t vertexStride, std::optional<uint32_t> positionOffset /*= std::nullopt*/)
+{
+    assert(!positionOffset || *positionOffset + kPositionStride <= vertexStride);
+    m_pVulkanCore = pVulkanCore;
+    m_vertexStride = vertexStride;
+    m_positionOffset = positionOffset;
+    m_vertexAllocator.Init(0);
+    m_indexAllocator.Init(0);
+    m_records.clear();
+    m_freeHandles.clear();
+    m_liveCount = 0;
+}
+
+void GeometryPool::Shutdown()
+{
+#if VERBOSE
+    if (m_liveCount > 0)
+        std::cerr << "GeometryPool: " << m_liveCount << " meshes were not removed before shutdown" << std::endl;
+#endif
+    if (m_vertexBuffer.m_isValid)
+        m_vertexBuffer.Destroy();
+    if (m_positionBuffer.m_isValid)
+        m_positionBuffer.Destroy();
+    if (m_indexBuffer.m_isValid)
+        m_indexBuffer.Destroy();
+    m_records.clear();
+    m_freeHandles.clear();
+    m_liveCount = 0;
+}
+
+void GeometryPool::Reserve(uint32_t vertexCount, uint32_t indexCount)
+{
+    if (m_vertexAllocator.GetLargestFreeRange() >= vertexCount && m_indexAllocator.GetLargestFreeRange() >= indexCount)
+        return;
+
+    Rebuild(std::max<uint64_t>(m_vertexAllocator.GetSize(), m_vertexAllocator.GetUsedSize() + vertexCount),
+        std::max<uint64_t>(m_indexAllocator.GetSize(), m_indexAllocator.GetUsedSize() + indexCount));
+}
+
+GeometryPool::Handle GeometryPool::Add(const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount)
+{
+    assert(vertexCount > 0);
+
+    auto allocateRanges = [&](std::optional<TlsfAllocator::Allocation>& vertexRange, std::optional<TlsfAllocator::Allocation>& indexRange) {
+        vertexRange = m_vertexAllocator.Allocate(vertexCount);
+        indexRange = indexCount > 0 ? m_indexAllocator.Allocate(indexCount) : std::optional(TlsfAllocator::Allocation {});
+        if (vertexRange && indexRange)
+            return true;
+        if (vertexRange)
+            m_vertexAllocator.Free(*vertexRange);
+        if (indexRange && indexRange->IsValid())
+            m_indexAllocator.Free(*indexRange);
+        return false;
+    };
+
+    std::optional<TlsfAllocator::Allocation> vertexRange, indexRange;
+    if (!allocateRanges(vertexRange, indexRange)) {
+        // Compacting alone is enough when the free space is only fragmented, otherwise grow geometrically while at it
+        uint64_t vertexCapacity = m_vertexAllocator.GetSize();
+        uint64_t indexCapacity = m_indexAllocator.GetSize();
+        if (m_vertexAllocator.GetFreeSize() < vertexCount)
+            vertexCapacity = std::max<uint64_t>(vertexCapacity * 2, m_vertexAllocator.GetUsedSize() + vertexCount);
+        if (m_indexAllocator.GetFreeSize() < indexCount)
+            indexCapacity = std::max<uint64_t>(indexCapacity * 2, m_indexAllocator.GetUsedSize() + indexCount);
+        Rebuild(vertexCapacity, indexCapacity);
+
+        if (!allocateRanges(vertexRange, indexRange))
+            throw std::runtime_error("GeometryPool: failed to allocate geometry after rebuilding!");
+    }
+
+    Handle handle;
+    if (!m_freeHandles.empty()) {
+        handle = m_freeHandles.back();
+        m_freeHandles.pop_back();
+    } else {
+        handle = static_cast<Handle>(m_records.size());
+        m_records.emplace_back();
+    }
+
+    Record& record = m_records[handle];
+    record = Record {
+        .drawInfo = {
+            .indexCount = indexCount,
+            .vertexCount = vertexCount,
+            .firstIndex = static_cast<uint32_t>(indexRange->offset),
+            .vertexOffset = static_cast<int32_t>(vertexRange->offset),
+        },
+        .vertexRange = *vertexRange,
+        .indexRange = *indexRange,
+        .isLive = true,
+    };
+    m_liveCount++;
+
+    UploadManager& uploadManager = m_pVulkanCore->GetUploadManager();
+    uploadManager.UploadToBuffer(m_vertexBuffer, vertices, VkDeviceSize(vertexCount) * m_vertexStride, vertexRange->offset * m_vertexStride);
+    if (m_positionOffset) {
+        // The upload copies into staging right away, so the packed positions only need to live until then
+        std::vector<float> positions(size_t(vertexCount) * 3);
+        const uint8_t* pVertex = static_cast<const uint8_t*>(vertices) + *m_positionOffset;
+        for (uint32_t i = 0; i < vertexCount; i++, pVertex += m_vertexStride)
+            std::memcpy(&positions[size_t(i) * 3], pVertex, kPositionStride);
+        uploadManager.UploadToBuffer(m_positionBuffer, positions.data(), VkDeviceSize(vertexCount) * kPositionStride, vertexRange->offset * kPositionStride);
+    }
+    if (indexCount > 0)
+        uploadManager.UploadToBuffer(m_indexBuffer, indices, VkDeviceSize(indexCount) * sizeof(uint32_t), indexRange->offset * sizeof(uint32_t));
+
+    return handle;
+}
+
+void GeometryPool::Remove(Handle handle)
+{
+    Record& record = m_records[handle];
+    assert(record.isLive);
+
+    m_vertexAllocator.Free(record.vertexRange);
+    if (record.indexRange.IsValid())
+        m_indexAllocator.Free(record.indexRange);
+    record = Record {};
+    m_freeHandles.push_back(handle);
+    m_liveCount--;
+}
+
+void GeometryPool::Bind(VkCommandBuffer commandBuffer) const
+{
+    if (!m_vertexBuffer.m_isValid)
+        return;
+
+    VkDeviceSize offsets[] = { 0 };
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_vertexBuffer.buffer, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+void GeometryPool::BindPositions(VkCommandBuffer commandBuffer) const
+{
+    if (!m_positionBuffer.m_isValid)
+        return;
+
+    VkDeviceSize offsets[] = { 0 };
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_positionBuffer.buffer, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+void GeometryPool::Draw(VkCommandBuffer commandBuffer, Handle handle, uint32_t instanceCount /*= 1*/, uint32_t firstInstance /*= 0*/) const
+{
+    const DrawInfo& drawInfo = GetDrawInfo(handle);
+    if (drawInfo.indexCount > 0)
+        vkCmdDrawIndexed(commandBuffer, drawInfo.indexCount, instanceCount, drawInfo.firstIndex, drawInfo.vertexOffset, firstInstance);
+    else
+        vkCmdDraw(commandBuffer, drawInfo.vertexCount, instanceCount, static_cast<uint32_t>(drawInfo.vertexOffset), firstInstance);
+}
+
+void GeometryPool::Compact()
+{
+    if (m_vertexAllocator.GetFreeRangeCount() <= 1 && m_indexAllocator.GetFreeRangeCount() <= 1)
+        return; // Already packed
+
+    // Keep a quarter of headroom so that the next few meshes do not trigger a rebuild right away
+    uint64_t vertexCapacity = m_vertexAllocator.GetUsedSize() + m_vertexAllocator.GetUsedSize() / 4;
+    uint64_t indexCapacity = m_indexAllocator.GetUsedSize() + m_indexAllocator.GetUsedSize() / 4;
+    Rebuild(std::min(vertexCapacity, m_vertexAllocator.GetSize()), std::min(indexCapacity, m_indexAllocator.GetSize()));
+}
+
+void GeometryPool::PrintStatistics() const
+{
+    std::cout << "GeometryPool: " << m_liveCount << " meshes, "
+              << m_vertexAllocator.GetUsedSize() << "/" << m_vertexAllocator.GetSize() << " vertices, "
+              << m_indexAllocator.GetUsedSize() << "/" << m_indexAllocator.GetSize() << " indices, "
+              << m_vertexAllocator.GetFreeRangeCount() << "/" << m_indexAllocator.GetFreeRangeCount() << " free vertex/index ranges" << std::endl;
+}
+
+void GeometryPool::CreateBuffers(Buffer& vertexBuffer, Buffer& positionBuffer, Buffer& indexBuffer, uint64_t vertexCapacity, uint64_t indexCapacity)
+{
+    // Zero sized buffers are not allowed, TRANSFER_SRC is for the copies of the next rebuild
+    vertexBuffer.Init(m_pVulkanCore, std::max<uint64_t>(vertexCapacity, 1) * m_vertexStride, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (m_positionOffset)
+        positionBuffer.Init(m_pVulkanCore, std::max<uint64_t>(vertexCapacity, 1) * kPositionStride, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    indexBuffer.Init(m_pVulkanCore, std::max<uint64_t>(indexCapacity, 1) * sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+void GeometryPool::Rebuild(uint64_t vertexCapacity, uint64_t indexCapacity)
+{
+    Buffer vertexBuffer, positionBuffer, indexBuffer;
+    CreateBuffers(vertexBuffer, positionBuffer, indexBuffer, vertexCapacity, indexCapacity);
+    TlsfAllocator vertexAllocator(vertexCapacity);
+    TlsfAllocator indexAllocator(indexCapacity);
+
+    if (m_vertexBuffer.m_isValid) {
+        // Pending uploads still target the old buffers, and frames in flight may read them. Rebuilds are rare (load time, explicit
+        // compaction), so a full stall is acceptable here.
+        m_pVulkanCore->GetUploadManager().WaitIdle();
+        m_pVulkanCore->WaitIdle();
+
+        // Live ranges are packed to the front in handle order
+        std::vector<VkBufferCopy> vertexCopies;
+        std::vector<VkBufferCopy> positionCopies;
+        std::vector<VkBufferCopy> indexCopies;
+        for (auto& record : m_records) {
+            if (!record.isLive)
+                continue;
+
+            auto vertexRange = *vertexAllocator.Allocate(record.drawInfo.vertexCount);
+            vertexCopies.push_back(VkBufferCopy {
+                .srcOffset = record.vertexRange.offset * m_vertexStride,
+                .dstOffset = vertexRange.offset * m_vertexStride,
+                .size = VkDeviceSize(record.drawInfo.vertexCount) * m_vertexStride,
+            });
+            if (m_positionOffset) {
+                positionCopies.push_back(VkBufferCopy {
+                    .srcOffset = record.vertexRange.offset * kPositionStride,
+                    .dstOffset = vertexRange.offset * kPositionStride,
+                    .size = VkDeviceSize(record.drawInfo.vertexCount) * kPositionStride,
+                });
+            }
+            record.vertexRange = vertexRange;
+            record.drawInfo.vertexOffset = static_cast<int32_t>(vertexRange.offset);
+
+            if (record.indexRange.IsValid()) {
+                auto indexRange = *indexAllocator.Allocate(record.drawInfo.indexCount);
+                indexCopies.push_back(VkBufferCopy {
+                    .srcOffset = record.indexRange.offset * sizeof(uint32_t),
+                    .dstOffset = indexRange.offset * sizeof(uint32_t),
+                    .size = VkDeviceSize(record.drawInfo.indexCount) * sizeof(uint32_t),
+                });
+                record.indexRange = indexRange;
+                record.drawInfo.firstIndex = static_cast<uint32_t>(indexRange.offset);
+            }
+        }
+
+        if (!vertexCopies.empty() || !indexCopies.empty()) {
+            VkCommandBuffer commandBuffer = m_pVulkanCore->beginSingleTimeCommands();
+            if (!vertexCopies.empty())
+                vkCmdCopyBuffer(commandBuffer, m_vertexBuffer.buffer, vertexBuffer.buffer, static_cast<uint32_t>(vertexCopies.size()), vertexCopies.data());
+            if (!positionCopies.empty())
+                vkCmdCopyBuffer(commandBuffer, m_positionBuffer.buffer, positionBuffer.buffer, static_cast<uint32_t>(positionCopies.size()), positionCopies.data());
+            if (!indexCopies.empty())
+                vkCmdCopyBuffer(commandBuffer, m_indexBuffer.buffer, indexBuffer.buffer, static_cast<uint32_t>(indexCopies.size()), indexCopies.data());
+
+            VkMemoryBarrier barrier {
+                .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT,
+            };
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+            m_pVulkanCore->endSingleTimeCommands(commandBuffer);
+        }
+
+        m_vertexBuffer.Destroy();
+        if (m_positionBuffer.m_isValid)
+            m_positionBuffer.Destroy();
+        m_indexBuffer.Destroy();
+    }
+
+    m_vertexBuffer = vertexBuffer;
+    m_positionBuffer = positionBuffer;
+    m_indexBuffer = indexBuffer;
+    m_vertexAllocator = std::move(vertexAllocator);
+    m_indexAllocator = std::move(indexAllocator);
+
+#if VERBOSE
+    PrintStatistics();
+#endif
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Buffer.hpp"
+#include "TlsfAllocator.hpp"
+#include "pch.hpp"
+
+class VulkanCore;
+
+// Packs the geometry of all meshes into one device local vertex buffer and one 32 bit index buffer.
+// Every mesh is a (vertexOffset, firstIndex, indexCount) record, so a frame binds the two buffers once and issues
+// vkCmdDrawIndexed with offsets. Indices stay relative to the mesh's first vertex, which lets ranges move during compaction
+// without rewriting them. Meshes are referred to by a stable handle for that reason.
+// Optionally the pool keeps a second, tightly packed position-only stream (12 bytes per vertex) at the same vertex offsets, for
+// depth-only passes that would otherwise fetch whole vertices for one attribute.
+class GeometryPool {
+public:
+    using Handle = uint32_t;
+    static constexpr Handle kInvalidHandle = UINT32_MAX;
+    static constexpr uint32_t kPositionStride = 3 * sizeof(float);
+
+    struct DrawInfo {
+        uint32_t indexCount = 0; // 0 for non-indexed meshes
+        uint32_t vertexCount = 0;
+        uint32_t firstIndex = 0;
+        int32_t vertexOffset = 0;
+    };
+
+    // positionOffset is the byte offset of the vertex's vec3 position, setting it enables the position stream
+    void Init(VulkanCore* pVulkanCore, uint32_t vertexStride, std::optional<uint32_t> positionOffset = std::nullopt);
+    void Shutdown();
+
+    // Makes room for this many more vertices and indices, so that a known set of meshes is added without growing in between
+    void Reserve(uint32_t vertexCount, uint32_t indexCount);
+
+    // Uploads through the upload manager, the data is usable once its batch completes
+    Handle Add(const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount);
+    // Frees the ranges right away, the GPU must no longer read the mesh
+    void Remove(Handle handle);
+
+    const DrawInfo& GetDrawInfo(Handle handle) const { return m_records[handle].drawInfo; }
+    void Bind(VkCommandBuffer commandBuffer) const;
+    // Binds the position stream instead of the full vertices, for pipelines whose only input is a vec3 at location 0
+    void BindPositions(VkCommandBuffer commandBuffer) const;
+    bool HasPositionStream() const { return m_positionOffset.has_value(); }
+    void Draw(VkCommandBuffer commandBuffer, Handle handle, uint32_t instanceCount = 1, uint32_t firstInstance = 0) const;
+
+    // Moves all live meshes to the front of freshly sized buffers, releasing the holes left by removed meshes
+    void Compact();
+
+    uint32_t GetVertexStride() const { return m_vertexStride; }
+    uint32_t GetMeshCount() const { return m_liveCount; }
+    uint64_t GetVertexCapacity() const { return m_vertexAllocator.GetSize(); }
+    uint64_t GetIndexCapacity() const { return m_indexAllocator.GetSize(); }
+    void PrintStatistics() const;
+
+private:
+    struct Record {
+        DrawInfo drawInfo;
+        TlsfAllocator::Allocation vertexRange;
+        TlsfAllocator::Allocation indexRange;
+        bool isLive = false;
+    };
+
+    void CreateBuffers(Buffer& vertexBuffer, Buffer& positionBuffer, Buffer& indexBuffer, uint64_t vertexCapacity, uint64_t indexCapacity);
+    // Reallocates the buffers with the given capacities and copies the live ranges over, packed. Waits for the device to be idle.
+    void Rebuild(uint64_t vertexCapacity, uint64_t indexCapacity);
+
+private:
+    VulkanCore* m_pVulkanCore = nullptr;
+    uint32_t m_vertexStride = 0;
+    std::optional<uint32_t> m_positionOffset;
+
+    Buffer m_vertexBuffer;
+    Buffer m_positionBuffer; // Only with a position stream, indexed like m_vertexBuffer
+    Buffer m_indexBuffer;
+    TlsfAllocator m_vertexAllocator; // In vertices
+    TlsfAllocator m_indexAllocator; // In indices
+
+    std::vector<Record> m_records;
+    std::vector<Handle> m_freeHandles;
+    uint32_t m_liveCount = 0;
+};
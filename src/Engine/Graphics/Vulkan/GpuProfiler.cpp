@@ -0,0 +1,177 @@
+#include "GpuProfiler.hpp"
+#include "VulkanHelper.hpp"
+
+using Utility::EGpuScope;
+
+// Order matches Utility::EPipelineStatistic, results come back in bit order
+static constexpr VkQueryPipelineStatisticFlags kPipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT
+    | VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT
+    | VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+    | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT
+    | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+static uint32_t GetTimestampValidBits(VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex)
+{
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+    return queueFamilyIndex < queueFamilyCount ? queueFamilies[queueFamilyIndex].timestampValidBits : 0;
+}
+
+bool GpuProfiler::SupportsTimestamps(VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    return GetTimestampValidBits(physicalDevice, queueFamilyIndex) > 0 && properties.limits.timestampPeriod > 0.0f;
+}
+
+bool GpuProfiler::SupportsPipelineStatistics(VkPhysicalDevice physicalDevice)
+{
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+    return features.pipelineStatisticsQuery;
+}
+
+void GpuProfiler::Init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex, uint32_t frameCount, bool pipelineStatistics)
+{
+    m_device = device;
+    m_slots.assign(frameCount, Slot {});
+
+    if (SupportsTimestamps(physicalDevice, queueFamilyIndex)) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        uint32_t validBits = GetTimestampValidBits(physicalDevice, queueFamilyIndex);
+        m_timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+        m_timestampPeriod = properties.limits.timestampPeriod;
+
+        VkQueryPoolCreateInfo poolInfo {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = frameCount * kScopeCount * 2,
+        };
+        VK(vkCreateQueryPool(m_device, &poolInfo, nullptr, &m_timestampPool));
+
+#if VERBOSE
+        std::cout << "GpuProfiler: " << m_timestampPeriod << " ns per tick, " << validBits << " valid timestamp bits" << std::endl;
+#endif
+    } else {
+        std::cerr << "GpuProfiler: the graphics queue does not support timestamps, GPU times will not be recorded" << std::endl;
+    }
+
+    if (pipelineStatistics) {
+        VkQueryPoolCreateInfo poolInfo {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+            .queryCount = frameCount,
+            .pipelineStatistics = kPipelineStatistics,
+        };
+        VK(vkCreateQueryPool(m_device, &poolInfo, nullptr, &m_statisticsPool));
+    } else {
+        std::cerr << "GpuProfiler: pipeline statistics queries are not supported, they will not be recorded" << std::endl;
+    }
+}
+
+void GpuProfiler::Destroy()
+{
+    if (m_timestampPool != VK_NULL_HANDLE)
+        vkDestroyQueryPool(m_device, m_timestampPool, nullptr);
+    if (m_statisticsPool != VK_NULL_HANDLE)
+        vkDestroyQueryPool(m_device, m_statisticsPool, nullptr);
+    m_timestampPool = VK_NULL_HANDLE;
+    m_statisticsPool = VK_NULL_HANDLE;
+    m_slots.clear();
+}
+
+void GpuProfiler::BeginFrame(VkCommandBuffer commandBuffer, uint32_t slotIndex, uint64_t frameIndex)
+{
+    if (!IsEnabled())
+        return;
+
+    m_currentSlot = slotIndex;
+    Slot& slot = m_slots[slotIndex];
+    Collect(slot, slotIndex);
+
+    if (m_timestampPool != VK_NULL_HANDLE)
+        vkCmdResetQueryPool(commandBuffer, m_timestampPool, slotIndex * kScopeCount * 2, kScopeCount * 2);
+    if (m_statisticsPool != VK_NULL_HANDLE)
+        vkCmdResetQueryPool(commandBuffer, m_statisticsPool, slotIndex, 1);
+    slot = Slot { .frameIndex = frameIndex };
+}
+
+void GpuProfiler::BeginScope(VkCommandBuffer commandBuffer, EGpuScope scope)
+{
+    if (m_timestampPool == VK_NULL_HANDLE)
+        return;
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_timestampPool, GetTimestampQuery(m_currentSlot, scope, false));
+    m_slots[m_currentSlot].scopeBegun[static_cast<size_t>(scope)] = true;
+}
+
+void GpuProfiler::EndScope(VkCommandBuffer commandBuffer, EGpuScope scope)
+{
+    if (m_timestampPool == VK_NULL_HANDLE)
+        return;
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_timestampPool, GetTimestampQuery(m_currentSlot, scope, true));
+    m_slots[m_currentSlot].scopeEnded[static_cast<size_t>(scope)] = true;
+}
+
+void GpuProfiler::BeginStatistics(VkCommandBuffer commandBuffer)
+{
+    if (m_statisticsPool == VK_NULL_HANDLE)
+        return;
+    vkCmdBeginQuery(commandBuffer, m_statisticsPool, m_currentSlot, 0);
+}
+
+void GpuProfiler::EndStatistics(VkCommandBuffer commandBuffer)
+{
+    if (m_statisticsPool == VK_NULL_HANDLE)
+        return;
+    vkCmdEndQuery(commandBuffer, m_statisticsPool, m_currentSlot);
+    m_slots[m_currentSlot].statisticsWritten = true;
+}
+
+void GpuProfiler::CollectAll()
+{
+    // Oldest frame first, the FrameProfiler writes records in frame order
+    std::vector<uint32_t> slotIndices;
+    for (uint32_t i = 0; i < m_slots.size(); i++) {
+        if (m_slots[i].frameIndex)
+            slotIndices.push_back(i);
+    }
+    std::sort(slotIndices.begin(), slotIndices.end(), [this](uint32_t a, uint32_t b) { return *m_slots[a].frameIndex < *m_slots[b].frameIndex; });
+
+    for (uint32_t slotIndex : slotIndices)
+        Collect(m_slots[slotIndex], slotIndex);
+}
+
+void GpuProfiler::Collect(Slot& slot, uint32_t slotIndex)
+{
+    if (!slot.frameIndex)
+        return;
+
+    // No VK_QUERY_RESULT_WAIT_BIT, the slot's previous frame already completed. Queries that are still not available (e.g. the frame was
+    // abandoned before submission) report VK_NOT_READY and are left out.
+    Utility::GpuFrameResults results {};
+    for (uint32_t i = 0; i < kScopeCount; i++) {
+        if (!slot.scopeBegun[i] || !slot.scopeEnded[i])
+            continue;
+        std::array<uint64_t, 2> timestamps {};
+        VkResult result = vkGetQueryPoolResults(m_device, m_timestampPool, GetTimestampQuery(slotIndex, static_cast<EGpuScope>(i), false), 2,
+            sizeof(timestamps), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+        if (result != VK_SUCCESS)
+            continue;
+        uint64_t ticks = ((timestamps[1] & m_timestampMask) - (timestamps[0] & m_timestampMask)) & m_timestampMask;
+        results.scopeMilliseconds[i] = ticks * m_timestampPeriod * 1e-6;
+    }
+
+    if (slot.statisticsWritten) {
+        std::array<uint64_t, static_cast<size_t>(Utility::EPipelineStatistic::COUNT)> statistics {};
+        VkResult result = vkGetQueryPoolResults(m_device, m_statisticsPool, slotIndex, 1, sizeof(statistics), statistics.data(), sizeof(statistics), VK_QUERY_RESULT_64_BIT);
+        if (result == VK_SUCCESS)
+            results.pipelineStatistics = statistics;
+    }
+
+    Utility::FrameProfiler::GetInstance().SetGpuResults(*slot.frameIndex, results);
+    slot.frameIndex.reset();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Utilities/FrameProfiler.hpp"
+#include "pch.hpp"
+
+// Timestamp and pipeline statistics queries of the frame command buffers.
+// Every frame in flight owns its own range of queries. Results are read when the slot is reused, after the frame timeline passed
+// its previous frame, so the read never waits on the GPU and a frame's results reach the FrameProfiler -frames-in-flight frames later.
+// Devices without timestamp support on the graphics queue (or without pipelineStatisticsQuery) simply leave those columns empty.
+class GpuProfiler {
+public:
+    static bool SupportsTimestamps(VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex);
+    static bool SupportsPipelineStatistics(VkPhysicalDevice physicalDevice);
+
+    // pipelineStatistics must only be set when the feature was enabled on the device
+    void Init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex, uint32_t frameCount, bool pipelineStatistics);
+    void Destroy();
+
+    bool IsEnabled() const { return m_timestampPool != VK_NULL_HANDLE || m_statisticsPool != VK_NULL_HANDLE; }
+
+    // Reports the slot's previous frame and resets its queries, record right after vkBeginCommandBuffer.
+    // The caller must have waited for the slot's fence.
+    void BeginFrame(VkCommandBuffer commandBuffer, uint32_t slot, uint64_t frameIndex);
+    void BeginScope(VkCommandBuffer commandBuffer, Utility::EGpuScope scope);
+    void EndScope(VkCommandBuffer commandBuffer, Utility::EGpuScope scope);
+    // Around the shading draws of the main pass only, inside its BeginRendering/EndRendering so the depth pre-pass is not counted
+    void BeginStatistics(VkCommandBuffer commandBuffer);
+    void EndStatistics(VkCommandBuffer commandBuffer);
+
+    // Reports every frame still in flight, the device must be idle
+    void CollectAll();
+
+private:
+    static constexpr uint32_t kScopeCount = static_cast<uint32_t>(Utility::EGpuScope::COUNT);
+
+    struct Slot {
+        std::optional<uint64_t> frameIndex; // Set while the slot holds results nobody has read yet
+        std::array<bool, kScopeCount> scopeBegun {};
+        std::array<bool, kScopeCount> scopeEnded {};
+        bool statisticsWritten = false;
+    };
+
+    void Collect(Slot& slot, uint32_t slotIndex);
+    uint32_t GetTimestampQuery(uint32_t slotIndex, Utility::EGpuScope scope, bool end) const { return (slotIndex * kScopeCount + static_cast<uint32_t>(scope)) * 2 + (end ? 1 : 0); }
+
+private:
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkQueryPool m_timestampPool = VK_NULL_HANDLE;
+    VkQueryPool m_statisticsPool = VK_NULL_HANDLE;
+    double m_timestampPeriod = 0.0; // Nanoseconds per tick
+    uint64_t m_timestampMask = 0; // Only timestampValidBits are meaningful
+
+    std::vector<Slot> m_slots;
+    uint32_t m_currentSlot = 0;
+};
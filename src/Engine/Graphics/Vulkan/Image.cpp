@@ -40,17 +40,8 @@ bool Image::Init(VulkanCore* pVulkanCore, ExtentVariant extent, uint32_t mipLeve
     VK(vkCreateImage(m_pVulkanCore->GetDevice(), &imageInfo, nullptr, &image));
     m_imageInfo = std::move(imageInfo);
 
-    VkMemoryRequirements memRequirements;
-    vkGetImageMemoryRequirements(m_pVulkanCore->GetDevice(), image, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .allocationSize = memRequirements.size,
-        .memoryTypeIndex = m_pVulkanCore->findMemoryType(memRequirements.memoryTypeBits, properties)
-    };
-
-    VK(vkAllocateMemory(m_pVulkanCore->GetDevice(), &allocInfo, nullptr, &imageMemory));
-    VK(vkBindImageMemory(m_pVulkanCore->GetDevice(), image, imageMemory, 0));
+    m_allocation = m_pVulkanCore->GetMemoryAllocator().AllocateForImage(image, tiling, properties);
+    VK(vkBindImageMemory(m_pVulkanCore->GetDevice(), image, m_allocation.memory, m_allocation.offset));
 
     m_isValid = true;
     m_currentLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -65,7 +56,7 @@ void Image::Destroy()
     vkDestroySampler(m_pVulkanCore->GetDevice(), sampler, nullptr);
     vkDestroyImageView(m_pVulkanCore->GetDevice(), imageView, nullptr);
     vkDestroyImage(m_pVulkanCore->GetDevice(), image, nullptr);
-    vkFreeMemory(m_pVulkanCore->GetDevice(), imageMemory, nullptr);
+    m_pVulkanCore->GetMemoryAllocator().Free(m_allocation);
     m_isValid = false;
     m_currentLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 }
@@ -126,7 +117,7 @@ std::pair<VkAccessFlags, VkPipelineStageFlags> getMinimalAccessMaskAndStage(VkIm
         return { 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT };
 
     case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
-        return { VK_ACCESS_COLOR_ATTACHMENT_READ_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+        return { VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
 
     case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
         return { VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT };
@@ -151,16 +142,13 @@ std::pair<VkAccessFlags, VkPipelineStageFlags> getMinimalAccessMaskAndStage(VkIm
 void Image::TransitionLayout(std::optional<VkCommandBuffer> commandBuffer, VkImageLayout newLayout, std::optional<VkImageLayout> forceOldLayout /*= std::nullopt*/)
 {
     assert(m_isValid);
-    VkCommandBuffer cmd;
-    if (!commandBuffer)
-        cmd = m_pVulkanCore->beginSingleTimeCommands();
-    else
-        cmd = *commandBuffer;
-
     VkImageLayout oldLayout = forceOldLayout.value_or(m_currentLayout);
 	if (newLayout == oldLayout)
 		return;
 
+    // Without a command buffer the transition is batched with the pending uploads
+    VkCommandBuffer cmd = commandBuffer ? *commandBuffer : m_pVulkanCore->GetUploadManager().GetGraphicsCommandBuffer();
+
     auto [srcAccessMask, sourceStage] = getMinimalAccessMaskAndStage(oldLayout);
     auto [dstAccessMask, destinationStage] = getMinimalAccessMaskAndStage(newLayout);
 
@@ -196,8 +184,6 @@ void Image::TransitionLayout(std::optional<VkCommandBuffer> commandBuffer, VkIma
 
     m_historyLayouts.push_back(m_currentLayout);
     m_currentLayout = newLayout;
-    if (!commandBuffer)
-        m_pVulkanCore->endSingleTimeCommands(cmd);
 }
 
 void Image::ReturnLayout(std::optional<VkCommandBuffer> commandBuffer)
@@ -206,18 +192,8 @@ void Image::ReturnLayout(std::optional<VkCommandBuffer> commandBuffer)
 	if (m_historyLayouts.empty())
 		return;
 
-	VkCommandBuffer cmd;
-	if (!commandBuffer)
-		cmd = m_pVulkanCore->beginSingleTimeCommands();
-	else
-		cmd = *commandBuffer;
-
 	VkImageLayout newLayout = m_historyLayouts.back();
-	TransitionLayout(cmd, newLayout);
-
-	if (!commandBuffer)
-		m_pVulkanCore->endSingleTimeCommands(cmd);
-
+	TransitionLayout(commandBuffer, newLayout);
 }
 
 ExtentVariant Image::GetImageExtent()
@@ -240,7 +216,13 @@ void Image::CopyToBuffer(Buffer& buffer)
 {
     assert(m_isValid);
     VkCommandBuffer commandBuffer = m_pVulkanCore->beginSingleTimeCommands();
+    CopyToBuffer(commandBuffer, buffer);
+    m_pVulkanCore->endSingleTimeCommands(commandBuffer);
+}
 
+void Image::CopyToBuffer(VkCommandBuffer commandBuffer, Buffer& buffer)
+{
+    assert(m_isValid);
     VkBufferImageCopy region {
         .bufferOffset = 0,
         .bufferRowLength = 0,
@@ -264,8 +246,6 @@ void Image::CopyToBuffer(Buffer& buffer)
         buffer.buffer,
         1,
         &region);
-
-    m_pVulkanCore->endSingleTimeCommands(commandBuffer);
 }
 
 void Image::CopyToImage(Image& dstImage, VkImageCopy imageCopy)
@@ -300,10 +280,13 @@ std::unique_ptr<uint8_t[]> Image::copyToMemory()
     Buffer stagingBuffer;
     stagingBuffer.Init(m_pVulkanCore, imageSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
+    // One submission for the transition, the copy and the transition back
+    VkCommandBuffer commandBuffer = m_pVulkanCore->beginSingleTimeCommands();
     auto oldLayout = m_currentLayout;
-    this->TransitionLayout(std::nullopt, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-    this->CopyToBuffer(stagingBuffer);
-    this->TransitionLayout(std::nullopt, oldLayout);
+    this->TransitionLayout(commandBuffer, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    this->CopyToBuffer(commandBuffer, stagingBuffer);
+    this->TransitionLayout(commandBuffer, oldLayout);
+    m_pVulkanCore->endSingleTimeCommands(commandBuffer);
 
     void* data = stagingBuffer.Map();
     memcpy(bufferData.get(), data, static_cast<size_t>(imageSize)); // Copy data into the unique_ptr buffer
@@ -313,23 +296,11 @@ std::unique_ptr<uint8_t[]> Image::copyToMemory()
     return bufferData; // Return the unique_ptr containing the copied texture data
 }
 
-void Image::UploadData(const void* data, VkDeviceSize size)
+// Recorded into the upload manager's current batch, the data is on the GPU once the batch is flushed and completed
+void Image::UploadData(const void* data, VkDeviceSize size, uint32_t mipLevelCount /*= 1*/)
 {
-    // Create a staging buffer
-    Buffer stagingBuffer;
-    stagingBuffer.Init(m_pVulkanCore, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-    // Map memory and copy data to the staging buffer
-    void* mappedData = stagingBuffer.Map();
-    memcpy(mappedData, data, static_cast<size_t>(size));
-    stagingBuffer.Unmap();
-
-    this->TransitionLayout(std::nullopt, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    stagingBuffer.CopyToImage(*this);
+    m_pVulkanCore->GetUploadManager().UploadToImage(*this, data, size, mipLevelCount);
     this->TransitionLayout(std::nullopt, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-    // Clean up the staging buffer
-    stagingBuffer.Destroy();
 }
 
 // it is uncommon in practice to generate the mipmap levels at runtime, but here it is.
@@ -342,8 +313,8 @@ void Image::GenerateMipmaps(std::optional<VkCommandBuffer> commandBuffer, uint32
         throw std::runtime_error("texture image format does not support linear blitting!");
     }
 
-    if (!commandBuffer)
-        commandBuffer = m_pVulkanCore->beginSingleTimeCommands();
+    // Without a command buffer the blits are batched with the pending uploads
+    VkCommandBuffer cmd = commandBuffer ? *commandBuffer : m_pVulkanCore->GetUploadManager().GetGraphicsCommandBuffer();
 
     VkImageMemoryBarrier barrier {
         .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
@@ -352,13 +323,14 @@ void Image::GenerateMipmaps(std::optional<VkCommandBuffer> commandBuffer, uint32
         .image = image,
         .subresourceRange = m_imageViewInfo.subresourceRange,
     };
+    barrier.subresourceRange.levelCount = 1; // Each barrier below covers a single level
 
     int32_t mipWidth = m_imageInfo.extent.width;
     int32_t mipHeight = m_imageInfo.extent.height;
     int32_t mipDepth = m_imageInfo.extent.depth;
 
-    this->TransitionLayout(std::nullopt, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL); //TODO: still buggy
-    
+    this->TransitionLayout(cmd, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
     // generate mipmap using blit from 1->2, 2->3, ...
     for (uint32_t i = 1; i < mipLevels; i++) {
         barrier.subresourceRange.baseMipLevel = i - 1;
@@ -367,7 +339,7 @@ void Image::GenerateMipmaps(std::optional<VkCommandBuffer> commandBuffer, uint32
         barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
         barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
 
-        vkCmdPipelineBarrier(*commandBuffer,
+        vkCmdPipelineBarrier(cmd,
             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
             0, nullptr,
             0, nullptr,
@@ -388,26 +360,25 @@ void Image::GenerateMipmaps(std::optional<VkCommandBuffer> commandBuffer, uint32
             },
             .dstOffsets = { VkOffset3D { 0, 0, 0 }, { mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, mipDepth > 1 ? mipDepth / 2 : 1 } },
         };
-        vkCmdBlitImage(*commandBuffer,
+        vkCmdBlitImage(cmd,
             image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
             image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
             1, &blit,
             VK_FILTER_LINEAR);
 
         // i-1 -> VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-		barrier.subresourceRange.baseMipLevel = i - 1;
-		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
-        vkCmdPipelineBarrier(*commandBuffer,
+        vkCmdPipelineBarrier(cmd,
             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
             0, nullptr,
             0, nullptr,
             1, &barrier);
 
-		if (mipWidth > 1)
+        if (mipWidth > 1)
             mipWidth /= 2;
         if (mipHeight > 1)
             mipHeight /= 2;
@@ -416,17 +387,18 @@ void Image::GenerateMipmaps(std::optional<VkCommandBuffer> commandBuffer, uint32
     }
 
     // handle last level mipmap barrier
-    barrier.subresourceRange.baseMipLevel = mipLevels - 1,
-    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+    barrier.subresourceRange.baseMipLevel = mipLevels - 1;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
-    vkCmdPipelineBarrier(*commandBuffer,
+    vkCmdPipelineBarrier(cmd,
         VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
         0, nullptr,
         0, nullptr,
         1, &barrier);
 
-    m_pVulkanCore->endSingleTimeCommands(*commandBuffer);
+    m_historyLayouts.push_back(m_currentLayout);
+    m_currentLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "MemoryAllocator.hpp"
 #include "pch.hpp"
 
 class Buffer;
@@ -20,10 +21,12 @@ public:
 
 public:
 	void CopyToBuffer(Buffer& buffer);
+	void CopyToBuffer(VkCommandBuffer commandBuffer, Buffer& buffer);
 	void CopyToImage(Image& dstImage, VkImageCopy imageCopy);
 
     std::unique_ptr<uint8_t[]> copyToMemory();
-    void UploadData(const void* data, VkDeviceSize size); // #TODO
+    // mipLevelCount levels of tightly packed texels, see UploadManager::UploadToImage
+    void UploadData(const void* data, VkDeviceSize size, uint32_t mipLevelCount = 1);
     void GenerateMipmaps(std::optional<VkCommandBuffer> commandBuffer, uint32_t mipLevels);
 
 public:
@@ -43,7 +46,7 @@ public:
 
     VkImage image;
     VkImageView imageView;
-    VkDeviceMemory imageMemory;
+    MemoryAllocation m_allocation;
     VkSampler sampler;
     VkImageCreateInfo m_imageInfo;
     VkImageViewCreateInfo m_imageViewInfo;
@@ -0,0 +1,328 @@
+#include "MemoryAllocator.hpp"
+#include "VulkanHelper.hpp"
+
+static constexpr VkDeviceSize kDefaultBlockSize = 64ull * 1024 * 1024;
+static constexpr VkDeviceSize kSmallHeapSize = 1024ull * 1024 * 1024;
+
+void MemoryAllocator::Init(VkPhysicalDevice physicalDevice, VkDevice device)
+{
+    m_physicalDevice = physicalDevice;
+    m_device = device;
+    m_memoryProperties = getAllMemoryProperties(physicalDevice);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    m_bufferImageGranularity = properties.limits.bufferImageGranularity;
+
+    m_hasMemoryBudget = false;
+    for (const auto& extension : getAllAvailableDeviceExtensions(physicalDevice)) {
+        if (strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+            m_hasMemoryBudget = true;
+    }
+
+    m_heapUsage.assign(m_memoryProperties.memoryHeapCount, 0);
+}
+
+void MemoryAllocator::Shutdown()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    uint32_t leakedAllocations = m_dedicatedCount;
+    for (auto& block : m_blocks) {
+        if (!block)
+            continue;
+        leakedAllocations += block->allocator.GetAllocationCount();
+        FreeDeviceMemory(block->memoryTypeIndex, block->allocator.GetSize(), block->memory);
+    }
+    m_blocks.clear();
+
+#if VERBOSE
+    if (leakedAllocations > 0)
+        std::cerr << "MemoryAllocator: " << leakedAllocations << " allocations were not freed before shutdown" << std::endl;
+#endif
+}
+
+MemoryAllocation MemoryAllocator::AllocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties)
+{
+    VkBufferMemoryRequirementsInfo2 requirementsInfo {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2,
+        .buffer = buffer,
+    };
+    VkMemoryDedicatedRequirements dedicatedRequirements {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS,
+    };
+    VkMemoryRequirements2 requirements {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
+        .pNext = &dedicatedRequirements,
+    };
+    vkGetBufferMemoryRequirements2(m_device, &requirementsInfo, &requirements);
+
+    return Allocate(requirements.memoryRequirements, properties, EResourceKind::Linear,
+        dedicatedRequirements.requiresDedicatedAllocation, DedicatedInfo { .buffer = buffer });
+}
+
+MemoryAllocation MemoryAllocator::AllocateForImage(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags properties)
+{
+    VkImageMemoryRequirementsInfo2 requirementsInfo {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2,
+        .image = image,
+    };
+    VkMemoryDedicatedRequirements dedicatedRequirements {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS,
+    };
+    VkMemoryRequirements2 requirements {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
+        .pNext = &dedicatedRequirements,
+    };
+    vkGetImageMemoryRequirements2(m_device, &requirementsInfo, &requirements);
+
+    // Drivers ask for dedicated memory on render targets where it enables compression, follow the hint for images
+    bool dedicated = dedicatedRequirements.requiresDedicatedAllocation || dedicatedRequirements.prefersDedicatedAllocation;
+    EResourceKind kind = tiling == VK_IMAGE_TILING_LINEAR ? EResourceKind::Linear : EResourceKind::Optimal;
+    return Allocate(requirements.memoryRequirements, properties, kind, dedicated, DedicatedInfo { .image = image });
+}
+
+MemoryAllocation MemoryAllocator::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, EResourceKind kind, bool dedicated, DedicatedInfo dedicatedInfo)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Without a granularity constraint linear and optimal resources can share blocks
+    if (m_bufferImageGranularity <= 1)
+        kind = EResourceKind::Linear;
+
+    // Same order as VulkanCore::findMemoryType, fall through to the next compatible type when a heap is exhausted
+    for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+        if (!(requirements.memoryTypeBits & (1 << i)) || (m_memoryProperties.memoryTypes[i].propertyFlags & properties) != properties)
+            continue;
+
+        bool useDedicated = dedicated || requirements.size > GetPreferredBlockSize(i) / 2;
+        if (!useDedicated) {
+            if (auto allocation = AllocateFromBlocks(i, requirements, kind))
+                return *allocation;
+        }
+        if (auto allocation = AllocateDedicated(i, requirements.size, dedicatedInfo))
+            return *allocation;
+    }
+
+    throw std::runtime_error("failed to allocate device memory!");
+}
+
+std::optional<MemoryAllocation> MemoryAllocator::AllocateFromBlocks(uint32_t memoryTypeIndex, const VkMemoryRequirements& requirements, EResourceKind kind)
+{
+    auto makeAllocation = [&](uint32_t blockIndex, const TlsfAllocator::Allocation& subAllocation) {
+        Block& block = *m_blocks[blockIndex];
+        return MemoryAllocation {
+            .memory = block.memory,
+            .offset = subAllocation.offset,
+            .size = subAllocation.size,
+            .pMapped = block.pMapped ? static_cast<uint8_t*>(block.pMapped) + subAllocation.offset : nullptr,
+            .memoryTypeIndex = memoryTypeIndex,
+            .blockIndex = blockIndex,
+            .subAllocation = subAllocation,
+        };
+    };
+
+    for (uint32_t i = 0; i < m_blocks.size(); i++) {
+        auto& block = m_blocks[i];
+        if (!block || block->memoryTypeIndex != memoryTypeIndex || block->kind != kind)
+            continue;
+        if (auto subAllocation = block->allocator.Allocate(requirements.size, requirements.alignment))
+            return makeAllocation(i, *subAllocation);
+    }
+
+    // No room, open a new block. Shrink it while it would exceed the heap budget.
+    uint32_t heapIndex = m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+    VkDeviceSize budget = GetHeapBudget(heapIndex);
+    VkDeviceSize blockSize = GetPreferredBlockSize(memoryTypeIndex);
+    while (blockSize / 2 >= requirements.size && m_heapUsage[heapIndex] + blockSize > budget) {
+        blockSize /= 2;
+    }
+    blockSize = std::max(blockSize, requirements.size);
+
+    auto block = std::make_unique<Block>();
+    if (AllocateDeviceMemory(memoryTypeIndex, blockSize, nullptr, block->memory, block->pMapped) != VK_SUCCESS)
+        return std::nullopt;
+    block->memoryTypeIndex = memoryTypeIndex;
+    block->kind = kind;
+    block->allocator.Init(blockSize);
+
+    auto subAllocation = block->allocator.Allocate(requirements.size, requirements.alignment);
+    assert(subAllocation);
+
+    uint32_t blockIndex = 0;
+    while (blockIndex < m_blocks.size() && m_blocks[blockIndex]) {
+        blockIndex++;
+    }
+    if (blockIndex == m_blocks.size())
+        m_blocks.emplace_back();
+    m_blocks[blockIndex] = std::move(block);
+
+    return makeAllocation(blockIndex, *subAllocation);
+}
+
+std::optional<MemoryAllocation> MemoryAllocator::AllocateDedicated(uint32_t memoryTypeIndex, VkDeviceSize size, DedicatedInfo dedicatedInfo)
+{
+    VkMemoryDedicatedAllocateInfo dedicatedAllocateInfo {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+        .image = dedicatedInfo.image,
+        .buffer = dedicatedInfo.buffer,
+    };
+
+    MemoryAllocation allocation {
+        .size = size,
+        .memoryTypeIndex = memoryTypeIndex,
+    };
+    if (AllocateDeviceMemory(memoryTypeIndex, size, &dedicatedAllocateInfo, allocation.memory, allocation.pMapped) != VK_SUCCESS)
+        return std::nullopt;
+
+    m_dedicatedCount++;
+    m_dedicatedBytes += size;
+    return allocation;
+}
+
+VkResult MemoryAllocator::AllocateDeviceMemory(uint32_t memoryTypeIndex, VkDeviceSize size, const void* pNext, VkDeviceMemory& memory, void*& pMapped)
+{
+    uint32_t heapIndex = m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+#if VERBOSE
+    if (m_heapUsage[heapIndex] + size > GetHeapBudget(heapIndex))
+        std::cerr << "MemoryAllocator: heap " << heapIndex << " is over budget" << std::endl;
+#endif
+
+    VkMemoryAllocateInfo allocInfo {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext = pNext,
+        .allocationSize = size,
+        .memoryTypeIndex = memoryTypeIndex,
+    };
+    VkResult result = vkAllocateMemory(m_device, &allocInfo, nullptr, &memory);
+    if (result != VK_SUCCESS)
+        return result;
+
+    pMapped = nullptr;
+    if (IsHostVisible(memoryTypeIndex))
+        VK(vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, &pMapped));
+
+    m_heapUsage[heapIndex] += size;
+    m_deviceMemoryCount++;
+    return VK_SUCCESS;
+}
+
+void MemoryAllocator::FreeDeviceMemory(uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceMemory memory)
+{
+    // Freeing implicitly unmaps
+    vkFreeMemory(m_device, memory, nullptr);
+    m_heapUsage[m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex] -= size;
+    m_deviceMemoryCount--;
+}
+
+void MemoryAllocator::Free(MemoryAllocation& allocation)
+{
+    if (!allocation.IsValid())
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (allocation.IsDedicated()) {
+        FreeDeviceMemory(allocation.memoryTypeIndex, allocation.size, allocation.memory);
+        m_dedicatedCount--;
+        m_dedicatedBytes -= allocation.size;
+    } else {
+        auto& block = m_blocks[allocation.blockIndex];
+        block->allocator.Free(allocation.subAllocation);
+
+        // Release empty blocks, but keep one per memory type and kind around to avoid thrashing
+        if (block->allocator.IsEmpty()) {
+            bool hasSibling = false;
+            for (auto& other : m_blocks) {
+                if (other && other != block && other->memoryTypeIndex == block->memoryTypeIndex && other->kind == block->kind)
+                    hasSibling = true;
+            }
+            if (hasSibling) {
+                FreeDeviceMemory(block->memoryTypeIndex, block->allocator.GetSize(), block->memory);
+                block.reset();
+            }
+        }
+    }
+
+    allocation = MemoryAllocation {};
+}
+
+VkDeviceSize MemoryAllocator::GetPreferredBlockSize(uint32_t memoryTypeIndex) const
+{
+    uint32_t heapIndex = m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+    VkDeviceSize heapSize = m_memoryProperties.memoryHeaps[heapIndex].size;
+    return heapSize <= kSmallHeapSize ? heapSize / 8 : kDefaultBlockSize;
+}
+
+VkDeviceSize MemoryAllocator::GetHeapBudget(uint32_t heapIndex) const
+{
+    if (m_hasMemoryBudget) {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+        };
+        VkPhysicalDeviceMemoryProperties2 memoryProperties {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+            .pNext = &budgetProperties,
+        };
+        vkGetPhysicalDeviceMemoryProperties2(m_physicalDevice, &memoryProperties);
+        // The driver's usage also counts memory allocated outside of this allocator (swapchain, ...), leave that out of our share
+        VkDeviceSize otherUsage = budgetProperties.heapUsage[heapIndex] > m_heapUsage[heapIndex] ? budgetProperties.heapUsage[heapIndex] - m_heapUsage[heapIndex] : 0;
+        return budgetProperties.heapBudget[heapIndex] > otherUsage ? budgetProperties.heapBudget[heapIndex] - otherUsage : 0;
+    }
+
+    // Without the extension, assume the rest of the system leaves us 80% of the heap
+    return m_memoryProperties.memoryHeaps[heapIndex].size * 8 / 10;
+}
+
+bool MemoryAllocator::IsHostVisible(uint32_t memoryTypeIndex) const
+{
+    return m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+}
+
+MemoryStatistics MemoryAllocator::GetStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    MemoryStatistics statistics {
+        .deviceMemoryCount = m_deviceMemoryCount,
+        .dedicatedCount = m_dedicatedCount,
+        .allocationCount = m_dedicatedCount,
+        .dedicatedBytes = m_dedicatedBytes,
+    };
+
+    VkDeviceSize freeBytes = 0;
+    for (const auto& block : m_blocks) {
+        if (!block)
+            continue;
+        statistics.blockCount++;
+        statistics.allocationCount += block->allocator.GetAllocationCount();
+        statistics.blockBytes += block->allocator.GetSize();
+        statistics.blockUsedBytes += block->allocator.GetUsedSize();
+        statistics.freeRangeCount += block->allocator.GetFreeRangeCount();
+        statistics.largestFreeRange = std::max(statistics.largestFreeRange, block->allocator.GetLargestFreeRange());
+        freeBytes += block->allocator.GetFreeSize();
+    }
+    if (freeBytes > 0)
+        statistics.fragmentation = 1.0f - static_cast<float>(statistics.largestFreeRange) / static_cast<float>(freeBytes);
+
+    statistics.heapUsage = m_heapUsage;
+    for (uint32_t i = 0; i < m_memoryProperties.memoryHeapCount; i++) {
+        statistics.heapBudget.push_back(GetHeapBudget(i));
+    }
+    return statistics;
+}
+
+void MemoryAllocator::PrintStatistics() const
+{
+    MemoryStatistics statistics = GetStatistics();
+    constexpr double MiB = 1024.0 * 1024.0;
+
+    std::cout << "Device memory: " << statistics.deviceMemoryCount << " vkAllocateMemory objects, "
+              << statistics.allocationCount << " allocations" << std::endl;
+    std::cout << "  Blocks: " << statistics.blockCount << ", " << statistics.blockUsedBytes / MiB << "/" << statistics.blockBytes / MiB << " MiB used, "
+              << statistics.freeRangeCount << " free ranges, largest " << statistics.largestFreeRange / MiB << " MiB, fragmentation " << statistics.fragmentation << std::endl;
+    std::cout << "  Dedicated: " << statistics.dedicatedCount << ", " << statistics.dedicatedBytes / MiB << " MiB" << std::endl;
+    for (size_t i = 0; i < statistics.heapUsage.size(); i++) {
+        std::cout << "  Heap " << i << ": " << statistics.heapUsage[i] / MiB << "/" << statistics.heapBudget[i] / MiB << " MiB of budget" << std::endl;
+    }
+}
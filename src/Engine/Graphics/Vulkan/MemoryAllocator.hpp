@@ -0,0 +1,98 @@
+#pragma once
+
+#include "TlsfAllocator.hpp"
+#include "pch.hpp"
+
+#include <mutex>
+
+struct MemoryAllocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void* pMapped = nullptr; // Persistently mapped pointer to offset, host visible memory only
+    uint32_t memoryTypeIndex = 0;
+    uint32_t blockIndex = UINT32_MAX; // UINT32_MAX for dedicated allocations
+    TlsfAllocator::Allocation subAllocation;
+
+    bool IsValid() const { return memory != VK_NULL_HANDLE; }
+    bool IsDedicated() const { return blockIndex == UINT32_MAX; }
+};
+
+struct MemoryStatistics {
+    uint32_t deviceMemoryCount = 0; // Live vkAllocateMemory objects
+    uint32_t blockCount = 0;
+    uint32_t dedicatedCount = 0;
+    uint32_t allocationCount = 0; // Sub-allocations and dedicated allocations
+
+    VkDeviceSize blockBytes = 0;
+    VkDeviceSize blockUsedBytes = 0;
+    VkDeviceSize dedicatedBytes = 0;
+
+    uint32_t freeRangeCount = 0;
+    VkDeviceSize largestFreeRange = 0;
+    // 0 when all free space in blocks is one range, approaching 1 when it is scattered in small pieces
+    float fragmentation = 0.0f;
+
+    std::vector<VkDeviceSize> heapUsage;
+    std::vector<VkDeviceSize> heapBudget;
+};
+
+// Sub-allocates device memory out of large blocks, one set of blocks per memory type.
+// Buffers and linear images never share a block with optimal images, which keeps bufferImageGranularity from ever applying.
+// Large images, and resources the driver prefers to be dedicated, get their own VkDeviceMemory.
+// Host visible blocks stay mapped for their whole lifetime. Thread safe.
+class MemoryAllocator {
+public:
+    void Init(VkPhysicalDevice physicalDevice, VkDevice device);
+    void Shutdown();
+
+    MemoryAllocation AllocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties);
+    MemoryAllocation AllocateForImage(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags properties);
+    void Free(MemoryAllocation& allocation);
+
+    MemoryStatistics GetStatistics() const;
+    void PrintStatistics() const;
+
+    VkDeviceSize GetPreferredBlockSize(uint32_t memoryTypeIndex) const;
+
+private:
+    enum class EResourceKind {
+        Linear, // Buffers and linear images
+        Optimal, // Optimal tiling images
+    };
+
+    struct Block {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void* pMapped = nullptr;
+        uint32_t memoryTypeIndex = 0;
+        EResourceKind kind = EResourceKind::Linear;
+        TlsfAllocator allocator;
+    };
+
+    struct DedicatedInfo {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkImage image = VK_NULL_HANDLE;
+    };
+
+    MemoryAllocation Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, EResourceKind kind, bool dedicated, DedicatedInfo dedicatedInfo);
+    std::optional<MemoryAllocation> AllocateFromBlocks(uint32_t memoryTypeIndex, const VkMemoryRequirements& requirements, EResourceKind kind);
+    std::optional<MemoryAllocation> AllocateDedicated(uint32_t memoryTypeIndex, VkDeviceSize size, DedicatedInfo dedicatedInfo);
+    VkResult AllocateDeviceMemory(uint32_t memoryTypeIndex, VkDeviceSize size, const void* pNext, VkDeviceMemory& memory, void*& pMapped);
+    void FreeDeviceMemory(uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceMemory memory);
+    VkDeviceSize GetHeapBudget(uint32_t heapIndex) const;
+    bool IsHostVisible(uint32_t memoryTypeIndex) const;
+
+private:
+    VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties m_memoryProperties {};
+    VkDeviceSize m_bufferImageGranularity = 1;
+    bool m_hasMemoryBudget = false;
+
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<Block>> m_blocks; // Freed blocks leave a nullptr behind so indices stay stable
+    std::vector<VkDeviceSize> m_heapUsage;
+    uint32_t m_deviceMemoryCount = 0;
+    uint32_t m_dedicatedCount = 0;
+    VkDeviceSize m_dedicatedBytes = 0;
+};
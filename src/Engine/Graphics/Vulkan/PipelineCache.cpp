@@ -0,0 +1,218 @@
+#include "PipelineCache.hpp"
+#include "Threading/JobSystem.hpp"
+#include "VulkanHelper.hpp"
+
+#include <random>
+
+uint64_t PipelineCache::Hash(const void* data, size_t size, uint64_t seed /*= 0xcbf29ce484222325ull*/)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+uint64_t PipelineCache::HashShaderDirectory(const std::filesystem::path& directory)
+{
+    std::vector<std::filesystem::path> shaderFiles;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".spv")
+            shaderFiles.push_back(entry.path());
+    }
+    std::sort(shaderFiles.begin(), shaderFiles.end());
+
+    uint64_t hash = Hash(nullptr, 0);
+    for (const auto& shaderFile : shaderFiles) {
+        std::string name = shaderFile.filename().string();
+        hash = Hash(name.data(), name.size(), hash);
+
+        std::ifstream file(shaderFile, std::ios::binary);
+        std::vector<char> code((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        hash = Hash(code.data(), code.size(), hash);
+    }
+    return hash;
+}
+
+void PipelineCache::Init(VkDevice device, VkPhysicalDevice physicalDevice, const std::filesystem::path& path, uint64_t shaderHash)
+{
+    m_device = device;
+    m_path = path;
+    m_shaderHash = shaderHash;
+    vkGetPhysicalDeviceProperties(physicalDevice, &m_properties);
+
+    std::vector<char> initialData = LoadValidated();
+    m_loadedDataHash = initialData.empty() ? 0 : Hash(initialData.data(), initialData.size());
+
+    VkPipelineCacheCreateInfo createInfo {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .initialDataSize = initialData.size(),
+        .pInitialData = initialData.empty() ? nullptr : initialData.data(),
+    };
+    if (vkCreatePipelineCache(m_device, &createInfo, nullptr, &m_pipelineCache) != VK_SUCCESS) {
+        // Drivers may still reject data that passed our checks, start empty in that case
+        createInfo.initialDataSize = 0;
+        createInfo.pInitialData = nullptr;
+        m_loadedDataHash = 0;
+        VK(vkCreatePipelineCache(m_device, &createInfo, nullptr, &m_pipelineCache));
+    }
+
+#if VERBOSE
+    if (!m_path.empty())
+        std::cout << "PipelineCache: " << (initialData.empty() ? "cold" : "warm") << " start, loaded " << initialData.size() << " bytes from " << m_path.string() << std::endl;
+#endif
+}
+
+void PipelineCache::Save()
+{
+    if (m_pipelineCache == VK_NULL_HANDLE || m_path.empty())
+        return;
+
+    size_t dataSize = 0;
+    VK(vkGetPipelineCacheData(m_device, m_pipelineCache, &dataSize, nullptr));
+    std::vector<char> data(dataSize);
+    VK(vkGetPipelineCacheData(m_device, m_pipelineCache, &dataSize, data.data()));
+    data.resize(dataSize);
+
+    uint64_t dataHash = Hash(data.data(), data.size());
+    if (data.empty() || dataHash == m_loadedDataHash)
+        return; // Nothing new was compiled
+
+    // Write next to the destination and rename over it, a crash mid-write leaves the previous cache intact. The temporary file is
+    // unique to this writer, other processes sharing the cache file may be saving at the same time.
+    std::filesystem::path tempPath = m_path;
+    tempPath += ".tmp-" + std::to_string(std::random_device {}());
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            std::cerr << "PipelineCache: failed to open " << tempPath.string() << " for writing" << std::endl;
+            return;
+        }
+        FileHeader header = MakeHeader(data.size(), dataHash);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(data.data(), data.size());
+        if (!file) {
+            std::cerr << "PipelineCache: failed to write " << tempPath.string() << std::endl;
+            file.close();
+            std::filesystem::remove(tempPath);
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, m_path, error);
+    if (error) {
+        std::cerr << "PipelineCache: failed to replace " << m_path.string() << ": " << error.message() << std::endl;
+        std::filesystem::remove(tempPath, error);
+        return;
+    }
+    m_loadedDataHash = dataHash;
+
+#if VERBOSE
+    std::cout << "PipelineCache: saved " << data.size() << " bytes to " << m_path.string() << std::endl;
+#endif
+}
+
+void PipelineCache::Destroy()
+{
+    if (m_pipelineCache != VK_NULL_HANDLE)
+        vkDestroyPipelineCache(m_device, m_pipelineCache, nullptr);
+    m_pipelineCache = VK_NULL_HANDLE;
+}
+
+void PipelineCache::CreateGraphicsPipelines(const VkGraphicsPipelineCreateInfo* pCreateInfos, uint32_t count, VkPipeline* pPipelines) const
+{
+    if (count <= 1) {
+        if (count == 1 && vkCreateGraphicsPipelines(m_device, m_pipelineCache, 1, pCreateInfos, nullptr, pPipelines) != VK_SUCCESS)
+            throw std::runtime_error("failed to create graphics pipeline!");
+        return;
+    }
+
+    // One pipeline per job, jobs must not throw so the results are checked afterwards
+    std::vector<VkResult> results(count, VK_SUCCESS);
+    EngineCore::JobSystem::GetInstance().ParallelFor("CreateGraphicsPipelines", count, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++)
+            results[i] = vkCreateGraphicsPipelines(m_device, m_pipelineCache, 1, &pCreateInfos[i], nullptr, &pPipelines[i]);
+    });
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (results[i] != VK_SUCCESS) {
+            for (uint32_t j = 0; j < count; j++) {
+                if (results[j] == VK_SUCCESS)
+                    vkDestroyPipeline(m_device, pPipelines[j], nullptr);
+                pPipelines[j] = VK_NULL_HANDLE;
+            }
+            throw std::runtime_error("failed to create graphics pipeline " + std::to_string(i) + ": " + string_VkResult(results[i]));
+        }
+    }
+}
+
+PipelineCache::FileHeader PipelineCache::MakeHeader(uint64_t dataSize, uint64_t dataHash) const
+{
+    FileHeader header {
+        .magic = kMagic,
+        .version = kVersion,
+        .vendorID = m_properties.vendorID,
+        .deviceID = m_properties.deviceID,
+        .driverVersion = m_properties.driverVersion,
+        .pipelineCacheUUID = {},
+        .reserved = 0,
+        .shaderHash = m_shaderHash,
+        .dataSize = dataSize,
+        .dataHash = dataHash,
+    };
+    std::memcpy(header.pipelineCacheUUID, m_properties.pipelineCacheUUID, VK_UUID_SIZE);
+    return header;
+}
+
+std::vector<char> PipelineCache::LoadValidated() const
+{
+    if (m_path.empty() || !std::filesystem::exists(m_path))
+        return {};
+
+    auto reject = [this](const char* reason) {
+        std::cerr << "PipelineCache: ignoring " << m_path.string() << ", " << reason << std::endl;
+        return std::vector<char>();
+    };
+
+    std::error_code error;
+    uintmax_t fileSize = std::filesystem::file_size(m_path, error);
+    if (error)
+        return reject("cannot read its size");
+
+    std::ifstream file(m_path, std::ios::binary);
+    FileHeader header {};
+    if (fileSize < sizeof(header) || !file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        return reject("truncated header");
+
+    FileHeader expected = MakeHeader(header.dataSize, header.dataHash);
+    if (header.magic != expected.magic || header.version != expected.version)
+        return reject("not a pipeline cache");
+    if (header.vendorID != expected.vendorID || header.deviceID != expected.deviceID || header.driverVersion != expected.driverVersion
+        || std::memcmp(header.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+        return reject("written by a different device or driver");
+    if (header.shaderHash != expected.shaderHash)
+        return reject("shaders changed");
+
+    // The size comes from the file, check it before allocating
+    if (header.dataSize != fileSize - sizeof(header))
+        return reject("data size does not match the file");
+
+    std::vector<char> data(header.dataSize);
+    if (!file.read(data.data(), data.size()) || Hash(data.data(), data.size()) != header.dataHash)
+        return reject("data is corrupted");
+
+    // The driver checks its own header too, but a mismatch there is reported as an error by some implementations
+    VkPipelineCacheHeaderVersionOne vulkanHeader {};
+    if (data.size() < sizeof(vulkanHeader))
+        return reject("data is too small");
+    std::memcpy(&vulkanHeader, data.data(), sizeof(vulkanHeader));
+    if (vulkanHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE || vulkanHeader.headerSize < sizeof(vulkanHeader) || vulkanHeader.vendorID != m_properties.vendorID
+        || vulkanHeader.deviceID != m_properties.deviceID || std::memcmp(vulkanHeader.pipelineCacheUUID, m_properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+        return reject("Vulkan cache header does not match the device");
+
+    return data;
+}
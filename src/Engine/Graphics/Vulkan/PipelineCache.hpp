@@ -0,0 +1,58 @@
+#pragma once
+
+#include "pch.hpp"
+
+// Disk backed VkPipelineCache.
+// The file is keyed by the device's pipelineCacheUUID, vendor/device id, driver version and a hash of the SPIR-V the engine ships,
+// so a driver update or a shader rebuild starts from an empty cache instead of feeding the driver stale data.
+// Loading validates our own header and the Vulkan cache header, any mismatch or corruption is ignored. Saving goes through a temporary
+// file and a rename, so an interrupted run never leaves a truncated cache behind.
+class PipelineCache {
+public:
+    // Empty path keeps the cache in memory only
+    void Init(VkDevice device, VkPhysicalDevice physicalDevice, const std::filesystem::path& path, uint64_t shaderHash);
+    // Writes the cache back if the driver added anything since it was loaded
+    void Save();
+    void Destroy();
+
+    VkPipelineCache GetHandle() const { return m_pipelineCache; }
+
+    // Creates the pipelines through the cache. With more than one pipeline they are compiled in parallel on the job system,
+    // VkPipelineCache is internally synchronized.
+    void CreateGraphicsPipelines(const VkGraphicsPipelineCreateInfo* pCreateInfos, uint32_t count, VkPipeline* pPipelines) const;
+
+    // 64 bit FNV-1a
+    static uint64_t Hash(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull);
+    // Hashes the names and contents of every .spv file in the directory, in name order
+    static uint64_t HashShaderDirectory(const std::filesystem::path& directory);
+
+private:
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+        uint32_t reserved; // Always 0, keeps the header free of implicit padding so every written byte is initialized
+        uint64_t shaderHash;
+        uint64_t dataSize;
+        uint64_t dataHash;
+    };
+    static_assert(sizeof(FileHeader) == 64, "FileHeader is written to disk as is and must not contain padding");
+
+    static constexpr uint32_t kMagic = 0x43505653; // "SVPC"
+    static constexpr uint32_t kVersion = 1;
+
+    FileHeader MakeHeader(uint64_t dataSize, uint64_t dataHash) const;
+    std::vector<char> LoadValidated() const;
+
+private:
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties m_properties {};
+    std::filesystem::path m_path;
+    uint64_t m_shaderHash = 0;
+    uint64_t m_loadedDataHash = 0;
+
+    VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+};
@@ -0,0 +1,259 @@
+#include "TlsfAllocator.hpp"
+
+#include <bit>
+
+void TlsfAllocator::Init(uint64_t size)
+{
+    m_size = size;
+    m_usedSize = 0;
+    m_allocationCount = 0;
+    m_freeRangeCount = 0;
+    m_firstLevelBitmap = 0;
+    m_secondLevelBitmaps.fill(0);
+    for (auto& heads : m_freeHeads) {
+        heads.fill(kInvalidNode);
+    }
+    m_nodes.clear();
+    m_unusedNodes.clear();
+    m_lastPhysical = kInvalidNode;
+
+    if (size == 0)
+        return;
+
+    uint32_t node = NewNode();
+    m_nodes[node].offset = 0;
+    m_nodes[node].size = size;
+    m_lastPhysical = node;
+    InsertFree(node);
+}
+
+void TlsfAllocator::Grow(uint64_t newSize)
+{
+    if (newSize <= m_size)
+        return;
+
+    uint64_t extraSize = newSize - m_size;
+    if (m_lastPhysical != kInvalidNode && m_nodes[m_lastPhysical].isFree) {
+        uint32_t last = m_lastPhysical;
+        RemoveFree(last);
+        m_nodes[last].size += extraSize;
+        InsertFree(last);
+    } else {
+        uint32_t node = NewNode();
+        m_nodes[node].offset = m_size;
+        m_nodes[node].size = extraSize;
+        m_nodes[node].prevPhysical = m_lastPhysical;
+        if (m_lastPhysical != kInvalidNode)
+            m_nodes[m_lastPhysical].nextPhysical = node;
+        m_lastPhysical = node;
+        InsertFree(node);
+    }
+    m_size = newSize;
+}
+
+std::optional<TlsfAllocator::Allocation> TlsfAllocator::Allocate(uint64_t size, uint64_t alignment /*= 1*/)
+{
+    size = std::max<uint64_t>(size, 1);
+    alignment = std::max<uint64_t>(alignment, 1);
+
+    // Ask for the worst case padding so that any range found can be aligned
+    uint32_t node = FindFree(size + alignment - 1);
+    if (node == kInvalidNode)
+        return std::nullopt;
+    RemoveFree(node);
+
+    uint64_t offset = m_nodes[node].offset;
+    uint64_t alignedOffset = (offset + alignment - 1) / alignment * alignment;
+    if (alignedOffset != offset) {
+        // Give the padding in front back as its own free range
+        SplitFront(node, alignedOffset - offset);
+        uint32_t padding = node;
+        node = m_nodes[padding].nextPhysical;
+        InsertFree(padding);
+    }
+
+    if (m_nodes[node].size > size) {
+        SplitFront(node, size);
+        InsertFree(m_nodes[node].nextPhysical);
+    }
+
+    m_nodes[node].isFree = false;
+    m_usedSize += m_nodes[node].size;
+    m_allocationCount++;
+
+    return Allocation {
+        .offset = m_nodes[node].offset,
+        .size = m_nodes[node].size,
+        .node = node,
+    };
+}
+
+void TlsfAllocator::Free(const Allocation& allocation)
+{
+    uint32_t node = allocation.node;
+    assert(node < m_nodes.size() && !m_nodes[node].isFree);
+
+    m_usedSize -= m_nodes[node].size;
+    m_allocationCount--;
+
+    // Merge with the previous range
+    uint32_t prev = m_nodes[node].prevPhysical;
+    if (prev != kInvalidNode && m_nodes[prev].isFree) {
+        RemoveFree(prev);
+        m_nodes[prev].size += m_nodes[node].size;
+        m_nodes[prev].nextPhysical = m_nodes[node].nextPhysical;
+        if (m_nodes[node].nextPhysical != kInvalidNode)
+            m_nodes[m_nodes[node].nextPhysical].prevPhysical = prev;
+        if (m_lastPhysical == node)
+            m_lastPhysical = prev;
+        ReleaseNode(node);
+        node = prev;
+    }
+
+    // Merge with the next range
+    uint32_t next = m_nodes[node].nextPhysical;
+    if (next != kInvalidNode && m_nodes[next].isFree) {
+        RemoveFree(next);
+        m_nodes[node].size += m_nodes[next].size;
+        m_nodes[node].nextPhysical = m_nodes[next].nextPhysical;
+        if (m_nodes[next].nextPhysical != kInvalidNode)
+            m_nodes[m_nodes[next].nextPhysical].prevPhysical = node;
+        if (m_lastPhysical == next)
+            m_lastPhysical = node;
+        ReleaseNode(next);
+    }
+
+    InsertFree(node);
+}
+
+uint64_t TlsfAllocator::GetLargestFreeRange() const
+{
+    if (m_firstLevelBitmap == 0)
+        return 0;
+
+    uint32_t firstLevel = 63 - std::countl_zero(m_firstLevelBitmap);
+    uint32_t secondLevel = 31 - std::countl_zero(m_secondLevelBitmaps[firstLevel]);
+
+    // Ranges within one bin differ in size, walk the (short) list of the largest bin
+    uint64_t largest = 0;
+    for (uint32_t node = m_freeHeads[firstLevel][secondLevel]; node != kInvalidNode; node = m_nodes[node].nextFree) {
+        largest = std::max(largest, m_nodes[node].size);
+    }
+    return largest;
+}
+
+void TlsfAllocator::MappingInsert(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel)
+{
+    firstLevel = static_cast<uint32_t>(std::bit_width(size) - 1);
+    if (firstLevel >= kSecondLevelLog2)
+        secondLevel = static_cast<uint32_t>(size >> (firstLevel - kSecondLevelLog2)) & (kSecondLevelCount - 1);
+    else
+        secondLevel = static_cast<uint32_t>(size << (kSecondLevelLog2 - firstLevel)) & (kSecondLevelCount - 1);
+}
+
+void TlsfAllocator::MappingSearch(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel)
+{
+    // Round up to the next bin boundary so that every range in the resulting bin is large enough
+    uint32_t level = static_cast<uint32_t>(std::bit_width(size) - 1);
+    if (level >= kSecondLevelLog2)
+        size += (uint64_t(1) << (level - kSecondLevelLog2)) - 1;
+    MappingInsert(size, firstLevel, secondLevel);
+}
+
+uint32_t TlsfAllocator::FindFree(uint64_t size)
+{
+    uint32_t firstLevel, secondLevel;
+    MappingSearch(size, firstLevel, secondLevel);
+    if (firstLevel >= kFirstLevelCount)
+        return kInvalidNode;
+
+    uint32_t secondLevelMap = m_secondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+    if (secondLevelMap == 0) {
+        uint64_t firstLevelMap = firstLevel + 1 < kFirstLevelCount ? m_firstLevelBitmap & (~uint64_t(0) << (firstLevel + 1)) : 0;
+        if (firstLevelMap == 0)
+            return kInvalidNode;
+        firstLevel = static_cast<uint32_t>(std::countr_zero(firstLevelMap));
+        secondLevelMap = m_secondLevelBitmaps[firstLevel];
+    }
+    secondLevel = static_cast<uint32_t>(std::countr_zero(secondLevelMap));
+    return m_freeHeads[firstLevel][secondLevel];
+}
+
+void TlsfAllocator::SplitFront(uint32_t node, uint64_t size)
+{
+    assert(m_nodes[node].size > size);
+    uint32_t remainder = NewNode();
+
+    Node& front = m_nodes[node];
+    Node& back = m_nodes[remainder];
+    back.offset = front.offset + size;
+    back.size = front.size - size;
+    back.prevPhysical = node;
+    back.nextPhysical = front.nextPhysical;
+    if (front.nextPhysical != kInvalidNode)
+        m_nodes[front.nextPhysical].prevPhysical = remainder;
+    if (m_lastPhysical == node)
+        m_lastPhysical = remainder;
+    front.nextPhysical = remainder;
+    front.size = size;
+}
+
+void TlsfAllocator::InsertFree(uint32_t node)
+{
+    uint32_t firstLevel, secondLevel;
+    MappingInsert(m_nodes[node].size, firstLevel, secondLevel);
+
+    uint32_t head = m_freeHeads[firstLevel][secondLevel];
+    m_nodes[node].isFree = true;
+    m_nodes[node].prevFree = kInvalidNode;
+    m_nodes[node].nextFree = head;
+    if (head != kInvalidNode)
+        m_nodes[head].prevFree = node;
+    m_freeHeads[firstLevel][secondLevel] = node;
+
+    m_firstLevelBitmap |= uint64_t(1) << firstLevel;
+    m_secondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+    m_freeRangeCount++;
+}
+
+void TlsfAllocator::RemoveFree(uint32_t node)
+{
+    uint32_t firstLevel, secondLevel;
+    MappingInsert(m_nodes[node].size, firstLevel, secondLevel);
+
+    Node& n = m_nodes[node];
+    if (n.prevFree != kInvalidNode)
+        m_nodes[n.prevFree].nextFree = n.nextFree;
+    if (n.nextFree != kInvalidNode)
+        m_nodes[n.nextFree].prevFree = n.prevFree;
+    if (m_freeHeads[firstLevel][secondLevel] == node) {
+        m_freeHeads[firstLevel][secondLevel] = n.nextFree;
+        if (n.nextFree == kInvalidNode) {
+            m_secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+            if (m_secondLevelBitmaps[firstLevel] == 0)
+                m_firstLevelBitmap &= ~(uint64_t(1) << firstLevel);
+        }
+    }
+    n.prevFree = kInvalidNode;
+    n.nextFree = kInvalidNode;
+    n.isFree = false;
+    m_freeRangeCount--;
+}
+
+uint32_t TlsfAllocator::NewNode()
+{
+    if (!m_unusedNodes.empty()) {
+        uint32_t node = m_unusedNodes.back();
+        m_unusedNodes.pop_back();
+        m_nodes[node] = Node {};
+        return node;
+    }
+    m_nodes.emplace_back();
+    return static_cast<uint32_t>(m_nodes.size() - 1);
+}
+
+void TlsfAllocator::ReleaseNode(uint32_t node)
+{
+    m_nodes[node] = Node {};
+    m_unusedNodes.push_back(node);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "pch.hpp"
+
+// Two-Level Segregated Fit allocator over an abstract [0, size) range ("TLSF: a New Dynamic Memory Allocator for Real-Time Systems", Masmano et al. 2004).
+// It only hands out offsets, the caller owns the memory behind them (a VkDeviceMemory block, a region of a mega-buffer, ...).
+// Allocation and free are O(1): free ranges are binned by size class, a two-level bitmap finds a fitting bin, neighbours are merged on free.
+// Not thread safe.
+class TlsfAllocator {
+public:
+    static constexpr uint32_t kInvalidNode = UINT32_MAX;
+
+    struct Allocation {
+        uint64_t offset = 0;
+        uint64_t size = 0;
+        uint32_t node = kInvalidNode;
+
+        bool IsValid() const { return node != kInvalidNode; }
+    };
+
+    TlsfAllocator() = default;
+    explicit TlsfAllocator(uint64_t size) { Init(size); }
+
+    void Init(uint64_t size);
+    // Extends the managed range to newSize, existing allocations keep their offsets
+    void Grow(uint64_t newSize);
+
+    std::optional<Allocation> Allocate(uint64_t size, uint64_t alignment = 1);
+    void Free(const Allocation& allocation);
+
+    uint64_t GetSize() const { return m_size; }
+    uint64_t GetUsedSize() const { return m_usedSize; }
+    uint64_t GetFreeSize() const { return m_size - m_usedSize; }
+    uint32_t GetAllocationCount() const { return m_allocationCount; }
+    uint32_t GetFreeRangeCount() const { return m_freeRangeCount; }
+    uint64_t GetLargestFreeRange() const;
+    bool IsEmpty() const { return m_allocationCount == 0; }
+
+private:
+    static constexpr uint32_t kSecondLevelLog2 = 5;
+    static constexpr uint32_t kSecondLevelCount = 1u << kSecondLevelLog2;
+    static constexpr uint32_t kFirstLevelCount = 64;
+
+    struct Node {
+        uint64_t offset = 0;
+        uint64_t size = 0;
+        uint32_t prevPhysical = kInvalidNode;
+        uint32_t nextPhysical = kInvalidNode;
+        uint32_t prevFree = kInvalidNode;
+        uint32_t nextFree = kInvalidNode;
+        bool isFree = false;
+    };
+
+    static void MappingInsert(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel);
+    static void MappingSearch(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel);
+
+    uint32_t NewNode();
+    void ReleaseNode(uint32_t node);
+    void InsertFree(uint32_t node);
+    void RemoveFree(uint32_t node);
+    uint32_t FindFree(uint64_t size);
+    // Splits size bytes off the front of a free node, the remainder becomes a new free node
+    void SplitFront(uint32_t node, uint64_t size);
+
+private:
+    uint64_t m_size = 0;
+    uint64_t m_usedSize = 0;
+    uint32_t m_allocationCount = 0;
+    uint32_t m_freeRangeCount = 0;
+    uint32_t m_lastPhysical = kInvalidNode;
+
+    uint64_t m_firstLevelBitmap = 0;
+    std::array<uint32_t, kFirstLevelCount> m_secondLevelBitmaps {};
+    std::array<std::array<uint32_t, kSecondLevelCount>, kFirstLevelCount> m_freeHeads {};
+
+    std::vector<Node> m_nodes;
+    std::vector<uint32_t> m_unusedNodes;
+};
@@ -0,0 +1,434 @@
+#include "UploadManager.hpp"
+#include "Image.hpp"
+#include "VulkanCore.hpp"
+#include "VulkanInitializer.hpp"
+
+// Where the first read of a freshly uploaded buffer can happen, derived from what the buffer may be used for
+static std::pair<VkAccessFlags, VkPipelineStageFlags> getBufferConsumerAccessAndStage(VkBufferUsageFlags usage)
+{
+    VkAccessFlags access = 0;
+    VkPipelineStageFlags stages = 0;
+    if (usage & VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) {
+        access |= VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+        stages |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    }
+    if (usage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT) {
+        access |= VK_ACCESS_INDEX_READ_BIT;
+        stages |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    }
+    if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) {
+        access |= VK_ACCESS_UNIFORM_READ_BIT;
+        stages |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    }
+    if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) {
+        access |= VK_ACCESS_SHADER_READ_BIT;
+        stages |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    }
+    if (usage & VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT) {
+        access |= VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+        stages |= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+    }
+    if (usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) {
+        access |= VK_ACCESS_TRANSFER_READ_BIT;
+        stages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
+    if (stages == 0)
+        return { VK_ACCESS_MEMORY_READ_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
+    return { access, stages };
+}
+
+void UploadManager::Init(VulkanCore* pVulkanCore, uint32_t graphicsFamily, VkQueue graphicsQueue, std::optional<uint32_t> transferFamily, VkQueue transferQueue, VkDeviceSize stagingSize /*= kDefaultStagingSize*/)
+{
+    m_pVulkanCore = pVulkanCore;
+    m_device = pVulkanCore->GetDevice();
+
+    m_graphicsFamily = graphicsFamily;
+    m_graphicsQueue = graphicsQueue;
+    m_transferFamily = transferFamily.value_or(graphicsFamily);
+    m_transferQueue = transferFamily ? transferQueue : graphicsQueue;
+
+    VkCommandPoolCreateInfo poolInfo {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = m_graphicsFamily,
+    };
+    VK(vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_graphicsCommandPool));
+    poolInfo.queueFamilyIndex = m_transferFamily;
+    VK(vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_transferCommandPool));
+
+    VkSemaphoreTypeCreateInfo semaphoreTypeInfo {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = 0,
+    };
+    VkSemaphoreCreateInfo semaphoreInfo {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &semaphoreTypeInfo,
+    };
+    VK(vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &m_timelineSemaphore));
+    m_lastSubmittedValue = 0;
+
+    m_stagingSize = stagingSize;
+    m_stagingHead = 0;
+    m_stagingUsed = 0;
+    m_stagingRing.Init(pVulkanCore, stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, true);
+    m_pStagingData = static_cast<uint8_t*>(*m_stagingRing.m_pMappedData);
+
+#if VERBOSE
+    std::cout << "UploadManager: " << (stagingSize >> 20) << " MiB staging ring, " << (HasDedicatedTransferQueue() ? "dedicated transfer queue family " + std::to_string(m_transferFamily) : std::string("graphics queue")) << std::endl;
+#endif
+}
+
+void UploadManager::Shutdown()
+{
+    WaitIdle();
+    assert(m_inFlight.empty());
+
+    for (auto& batch : m_freeBatches) {
+        vkFreeCommandBuffers(m_device, m_transferCommandPool, 1, &batch.transferCommandBuffer);
+        vkFreeCommandBuffers(m_device, m_graphicsCommandPool, 1, &batch.graphicsCommandBuffer);
+    }
+    m_freeBatches.clear();
+    if (m_recording) {
+        vkFreeCommandBuffers(m_device, m_transferCommandPool, 1, &m_recording->transferCommandBuffer);
+        vkFreeCommandBuffers(m_device, m_graphicsCommandPool, 1, &m_recording->graphicsCommandBuffer);
+        m_recording.reset();
+    }
+
+    m_stagingRing.Destroy();
+    m_pStagingData = nullptr;
+
+    vkDestroySemaphore(m_device, m_timelineSemaphore, nullptr);
+    vkDestroyCommandPool(m_device, m_transferCommandPool, nullptr);
+    vkDestroyCommandPool(m_device, m_graphicsCommandPool, nullptr);
+    m_timelineSemaphore = VK_NULL_HANDLE;
+    m_transferCommandPool = VK_NULL_HANDLE;
+    m_graphicsCommandPool = VK_NULL_HANDLE;
+}
+
+void UploadManager::UploadToBuffer(Buffer& dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset /*= 0*/)
+{
+    if (size == 0)
+        return;
+
+    auto [srcBuffer, srcOffset] = Stage(data, size, 4);
+    Batch& batch = GetRecordingBatch();
+
+    VkBufferCopy copyRegion {
+        .srcOffset = srcOffset,
+        .dstOffset = dstOffset,
+        .size = size,
+    };
+    vkCmdCopyBuffer(batch.transferCommandBuffer, srcBuffer, dstBuffer.buffer, 1, &copyRegion);
+    batch.hasTransferWork = true;
+
+    auto [dstAccessMask, dstStage] = getBufferConsumerAccessAndStage(dstBuffer.m_bufferInfo.usage);
+    VkBufferMemoryBarrier barrier {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = dstAccessMask,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = dstBuffer.buffer,
+        .offset = dstOffset,
+        .size = size,
+    };
+
+    if (HasDedicatedTransferQueue()) {
+        // Queue family ownership transfer: release on the transfer queue, acquire on the graphics queue
+        barrier.srcQueueFamilyIndex = m_transferFamily;
+        barrier.dstQueueFamilyIndex = m_graphicsFamily;
+        barrier.dstAccessMask = 0;
+        vkCmdPipelineBarrier(batch.transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = dstAccessMask;
+        vkCmdPipelineBarrier(batch.graphicsCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+    } else {
+        vkCmdPipelineBarrier(batch.graphicsCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+    }
+    batch.hasGraphicsWork = true;
+}
+
+void UploadManager::UploadToImage(Image& dstImage, const void* data, VkDeviceSize size, uint32_t mipLevelCount /*= 1*/)
+{
+    if (size == 0)
+        return;
+
+    // Buffer offsets of image copies have to be a multiple of the texel size and of 4
+    auto [srcBuffer, srcOffset] = Stage(data, size, 16);
+    Batch& batch = GetRecordingBatch();
+
+    VkImageSubresourceRange range {
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .baseMipLevel = 0,
+        .levelCount = dstImage.m_imageInfo.mipLevels,
+        .baseArrayLayer = 0,
+        .layerCount = dstImage.m_imageInfo.arrayLayers,
+    };
+
+    // The old contents are overwritten, so the image is taken from UNDEFINED and does not need to be acquired from the graphics queue first
+    VkImageMemoryBarrier barrier {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = dstImage.image,
+        .subresourceRange = range,
+    };
+    vkCmdPipelineBarrier(batch.transferCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    // The texel size follows from the size of all levels, the offsets of the levels from it
+    std::vector<VkExtent3D> extents(mipLevelCount);
+    VkDeviceSize texelCount = 0;
+    for (uint32_t level = 0; level < mipLevelCount; level++) {
+        const VkExtent3D& extent = dstImage.m_imageInfo.extent;
+        extents[level] = { std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u), std::max(extent.depth >> level, 1u) };
+        texelCount += VkDeviceSize(extents[level].width) * extents[level].height * extents[level].depth * dstImage.m_imageInfo.arrayLayers;
+    }
+    VkDeviceSize texelSize = size / texelCount;
+
+    std::vector<VkBufferImageCopy> regions(mipLevelCount);
+    VkDeviceSize levelOffset = srcOffset;
+    for (uint32_t level = 0; level < mipLevelCount; level++) {
+        regions[level] = {
+            .bufferOffset = levelOffset,
+            .bufferRowLength = 0,
+            .bufferImageHeight = 0,
+            .imageSubresource {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .mipLevel = level,
+                .baseArrayLayer = 0,
+                .layerCount = dstImage.m_imageInfo.arrayLayers,
+            },
+            .imageOffset = { 0, 0, 0 },
+            .imageExtent = extents[level],
+        };
+        levelOffset += texelSize * extents[level].width * extents[level].height * extents[level].depth * dstImage.m_imageInfo.arrayLayers;
+    }
+    vkCmdCopyBufferToImage(batch.transferCommandBuffer, srcBuffer, dstImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevelCount, regions.data());
+    batch.hasTransferWork = true;
+
+    if (HasDedicatedTransferQueue()) {
+        // Hand the image over to the graphics queue without changing its layout, the layout transitions that follow are recorded there
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = m_transferFamily;
+        barrier.dstQueueFamilyIndex = m_graphicsFamily;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        vkCmdPipelineBarrier(batch.transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(batch.graphicsCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        batch.hasGraphicsWork = true;
+    }
+
+    dstImage.m_currentLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+}
+
+VkCommandBuffer UploadManager::GetGraphicsCommandBuffer()
+{
+    Batch& batch = GetRecordingBatch();
+    batch.hasGraphicsWork = true;
+    return batch.graphicsCommandBuffer;
+}
+
+uint64_t UploadManager::Flush()
+{
+    Reclaim();
+    if (!m_recording || !(m_recording->hasTransferWork || m_recording->hasGraphicsWork))
+        return m_lastSubmittedValue;
+
+    Batch batch = std::move(*m_recording);
+    m_recording.reset();
+    VK(vkEndCommandBuffer(batch.transferCommandBuffer));
+    VK(vkEndCommandBuffer(batch.graphicsCommandBuffer));
+
+    if (HasDedicatedTransferQueue()) {
+        uint64_t transferValue = 0;
+        if (batch.hasTransferWork) {
+            transferValue = ++m_lastSubmittedValue;
+            VkTimelineSemaphoreSubmitInfo timelineInfo {
+                .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+                .signalSemaphoreValueCount = 1,
+                .pSignalSemaphoreValues = &transferValue,
+            };
+            VkSubmitInfo submitInfo {
+                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                .pNext = &timelineInfo,
+                .commandBufferCount = 1,
+                .pCommandBuffers = &batch.transferCommandBuffer,
+                .signalSemaphoreCount = 1,
+                .pSignalSemaphores = &m_timelineSemaphore,
+            };
+            VK(vkQueueSubmit(m_transferQueue, 1, &submitInfo, VK_NULL_HANDLE));
+        }
+
+        uint64_t graphicsValue = ++m_lastSubmittedValue;
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        uint32_t waitCount = batch.hasTransferWork ? 1 : 0;
+        VkTimelineSemaphoreSubmitInfo timelineInfo {
+            .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+            .waitSemaphoreValueCount = waitCount,
+            .pWaitSemaphoreValues = &transferValue,
+            .signalSemaphoreValueCount = 1,
+            .pSignalSemaphoreValues = &graphicsValue,
+        };
+        VkSubmitInfo submitInfo {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .pNext = &timelineInfo,
+            .waitSemaphoreCount = waitCount,
+            .pWaitSemaphores = &m_timelineSemaphore,
+            .pWaitDstStageMask = &waitStage,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &batch.graphicsCommandBuffer,
+            .signalSemaphoreCount = 1,
+            .pSignalSemaphores = &m_timelineSemaphore,
+        };
+        VK(vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE));
+    } else {
+        // One queue, the barriers in the graphics command buffer order it after the copies
+        uint64_t signalValue = ++m_lastSubmittedValue;
+        std::array<VkCommandBuffer, 2> commandBuffers = { batch.transferCommandBuffer, batch.graphicsCommandBuffer };
+        VkTimelineSemaphoreSubmitInfo timelineInfo {
+            .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+            .signalSemaphoreValueCount = 1,
+            .pSignalSemaphoreValues = &signalValue,
+        };
+        VkSubmitInfo submitInfo {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .pNext = &timelineInfo,
+            .commandBufferCount = static_cast<uint32_t>(commandBuffers.size()),
+            .pCommandBuffers = commandBuffers.data(),
+            .signalSemaphoreCount = 1,
+            .pSignalSemaphores = &m_timelineSemaphore,
+        };
+        VK(vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE));
+    }
+
+    batch.timelineValue = m_lastSubmittedValue;
+    m_inFlight.push_back(std::move(batch));
+    return m_lastSubmittedValue;
+}
+
+void UploadManager::Wait(uint64_t timelineValue)
+{
+    if (timelineValue == 0)
+        return;
+
+    VkSemaphoreWaitInfo waitInfo {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &m_timelineSemaphore,
+        .pValues = &timelineValue,
+    };
+    VK(vkWaitSemaphores(m_device, &waitInfo, UINT64_MAX));
+    Reclaim();
+}
+
+UploadManager::Batch& UploadManager::GetRecordingBatch()
+{
+    if (m_recording)
+        return *m_recording;
+
+    Batch batch;
+    if (!m_freeBatches.empty()) {
+        batch = std::move(m_freeBatches.back());
+        m_freeBatches.pop_back();
+    } else {
+        createCommandBuffer(m_device, m_transferCommandPool, batch.transferCommandBuffer);
+        createCommandBuffer(m_device, m_graphicsCommandPool, batch.graphicsCommandBuffer);
+    }
+
+    VkCommandBufferBeginInfo beginInfo {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    VK(vkBeginCommandBuffer(batch.transferCommandBuffer, &beginInfo));
+    VK(vkBeginCommandBuffer(batch.graphicsCommandBuffer, &beginInfo));
+
+    m_recording = std::move(batch);
+    return *m_recording;
+}
+
+std::pair<VkBuffer, VkDeviceSize> UploadManager::Stage(const void* data, VkDeviceSize size, VkDeviceSize alignment)
+{
+    if (size > m_stagingSize) {
+        // Does not fit the ring at all, give it a staging buffer of its own that lives until the batch completes
+        Buffer stagingBuffer;
+        stagingBuffer.Init(m_pVulkanCore, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        memcpy(stagingBuffer.Map(), data, static_cast<size_t>(size));
+        GetRecordingBatch().oversizedStagingBuffers.push_back(stagingBuffer);
+        return { stagingBuffer.buffer, 0 };
+    }
+
+    std::optional<VkDeviceSize> offset = TryAllocateStaging(size, alignment);
+    while (!offset) {
+        // The ring is full, submit what has been recorded and wait for the oldest batch to give its space back
+        Flush();
+        if (m_inFlight.empty())
+            throw std::runtime_error("UploadManager: staging ring exhausted with no upload in flight!");
+        Wait(m_inFlight.front().timelineValue);
+        offset = TryAllocateStaging(size, alignment);
+    }
+
+    memcpy(m_pStagingData + *offset, data, static_cast<size_t>(size));
+    return { m_stagingRing.buffer, *offset };
+}
+
+std::optional<VkDeviceSize> UploadManager::TryAllocateStaging(VkDeviceSize size, VkDeviceSize alignment)
+{
+    if (m_stagingUsed == 0)
+        m_stagingHead = 0;
+
+    // The used part of the ring is one contiguous (wrapping) range ending at the head, so the free space is contiguous as well
+    VkDeviceSize offset = (m_stagingHead + alignment - 1) / alignment * alignment;
+    VkDeviceSize needed;
+    if (offset + size > m_stagingSize) {
+        // Skip the tail end of the ring and wrap around to the start
+        offset = 0;
+        needed = m_stagingSize - m_stagingHead + size;
+    } else {
+        needed = offset - m_stagingHead + size;
+    }
+
+    if (m_stagingUsed + needed > m_stagingSize)
+        return std::nullopt;
+
+    m_stagingUsed += needed;
+    m_stagingHead = offset + size;
+    GetRecordingBatch().stagingBytes += needed;
+    return offset;
+}
+
+void UploadManager::Reclaim()
+{
+    if (m_inFlight.empty())
+        return;
+
+    uint64_t completedValue = 0;
+    VK(vkGetSemaphoreCounterValue(m_device, m_timelineSemaphore, &completedValue));
+
+    while (!m_inFlight.empty() && m_inFlight.front().timelineValue <= completedValue) {
+        Batch batch = std::move(m_inFlight.front());
+        m_inFlight.pop_front();
+
+        m_stagingUsed -= batch.stagingBytes;
+        for (auto& stagingBuffer : batch.oversizedStagingBuffers) {
+            stagingBuffer.Destroy();
+        }
+        batch.oversizedStagingBuffers.clear();
+        batch.stagingBytes = 0;
+        batch.timelineValue = 0;
+        batch.hasTransferWork = false;
+        batch.hasGraphicsWork = false;
+
+        VK(vkResetCommandBuffer(batch.transferCommandBuffer, 0));
+        VK(vkResetCommandBuffer(batch.graphicsCommandBuffer, 0));
+        m_freeBatches.push_back(std::move(batch));
+    }
+}
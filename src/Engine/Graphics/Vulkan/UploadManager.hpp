@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Buffer.hpp"
+#include "pch.hpp"
+
+class Image;
+class VulkanCore;
+
+// Batches host -> device uploads into a few submissions.
+// Data is copied into a persistently mapped staging ring, copies are recorded on the dedicated transfer queue when the device has one,
+// and the work that has to run on the graphics queue (queue family acquire, layout transitions, mip generation) is recorded into a second
+// command buffer that waits for the copies on a timeline semaphore. Nothing blocks on vkQueueWaitIdle, space in the ring is reclaimed
+// as the timeline advances.
+// Used from the render thread only, not thread safe.
+class UploadManager {
+public:
+    static constexpr VkDeviceSize kDefaultStagingSize = 64ull * 1024 * 1024;
+
+    void Init(VulkanCore* pVulkanCore, uint32_t graphicsFamily, VkQueue graphicsQueue, std::optional<uint32_t> transferFamily, VkQueue transferQueue, VkDeviceSize stagingSize = kDefaultStagingSize);
+    void Shutdown();
+
+    void UploadToBuffer(Buffer& dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+    // Copies tightly packed texels into the first mipLevelCount levels of every layer, level after level, each with all its layers.
+    // The image is left in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL on the graphics queue.
+    void UploadToImage(Image& dstImage, const void* data, VkDeviceSize size, uint32_t mipLevelCount = 1);
+
+    // Graphics queue command buffer of the current batch, executed after all copies of the batch
+    VkCommandBuffer GetGraphicsCommandBuffer();
+
+    // Submits the current batch, returns the timeline value that signals its completion
+    uint64_t Flush();
+    void Wait(uint64_t timelineValue);
+    void WaitIdle() { Wait(Flush()); }
+
+    VkSemaphore GetTimelineSemaphore() const { return m_timelineSemaphore; }
+    uint64_t GetLastSubmittedValue() const { return m_lastSubmittedValue; }
+    bool HasDedicatedTransferQueue() const { return m_transferFamily != m_graphicsFamily; }
+
+private:
+    struct Batch {
+        VkCommandBuffer transferCommandBuffer = VK_NULL_HANDLE;
+        VkCommandBuffer graphicsCommandBuffer = VK_NULL_HANDLE;
+        VkDeviceSize stagingBytes = 0; // Ring bytes owned by this batch, including wrap-around padding
+        std::vector<Buffer> oversizedStagingBuffers; // Uploads larger than the ring
+        uint64_t timelineValue = 0;
+        bool hasTransferWork = false;
+        bool hasGraphicsWork = false;
+    };
+
+    Batch& GetRecordingBatch();
+    // Returns the buffer and offset to copy size bytes from, data is already written
+    std::pair<VkBuffer, VkDeviceSize> Stage(const void* data, VkDeviceSize size, VkDeviceSize alignment);
+    std::optional<VkDeviceSize> TryAllocateStaging(VkDeviceSize size, VkDeviceSize alignment);
+    void Reclaim();
+
+private:
+    VulkanCore* m_pVulkanCore = nullptr;
+    VkDevice m_device = VK_NULL_HANDLE;
+
+    uint32_t m_graphicsFamily = 0;
+    uint32_t m_transferFamily = 0;
+    VkQueue m_graphicsQueue = VK_NULL_HANDLE;
+    VkQueue m_transferQueue = VK_NULL_HANDLE;
+    VkCommandPool m_graphicsCommandPool = VK_NULL_HANDLE;
+    VkCommandPool m_transferCommandPool = VK_NULL_HANDLE;
+
+    VkSemaphore m_timelineSemaphore = VK_NULL_HANDLE;
+    uint64_t m_lastSubmittedValue = 0;
+
+    Buffer m_stagingRing;
+    uint8_t* m_pStagingData = nullptr;
+    VkDeviceSize m_stagingSize = 0;
+    VkDeviceSize m_stagingHead = 0; // Next free byte
+    VkDeviceSize m_stagingUsed = 0; // Bytes between the oldest in-flight batch and the head
+
+    std::optional<Batch> m_recording;
+    std::deque<Batch> m_inFlight;
+    std::vector<Batch> m_freeBatches; // Completed batches whose command buffers can be reused
+};
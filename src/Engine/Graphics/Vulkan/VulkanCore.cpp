@@ -9,7 +9,10 @@
 #include "Scene/Environment.hpp"
 #include "Scene/Material.hpp"
 #include "Scene/Mesh.hpp"
+#include "Scene/RenderSnapshot.hpp"
 #include "Scene/Scene.hpp"
+#include "Utilities/FrameProfiler.hpp"
+#include "Utilities/Trace.hpp"
 #include "VulkanInitializer.hpp"
 #include "../Main/main.hpp"
 
@@ -26,10 +29,19 @@ namespace glm = vkm;
 
 void VulkanCore::Init(EngineCore::IApp* pApp)
 {
+    TRACE_ZONE("VulkanCore::Init");
     if (!pApp) {
         throw std::runtime_error("no application!");
     }
     m_pApp = pApp;
+    m_framesInFlight = std::clamp(m_pApp->args.framesInFlight, 1u, MAX_FRAMES_IN_FLIGHT);
+
+    // One view per camera of -render-cameras, or a single unnamed one. Every frame renders all of them.
+    m_viewNames.clear();
+    for (auto& camera : CameraManager::GetInstance().GetRenderCameras())
+        m_viewNames.push_back(camera->getName());
+    if (m_viewNames.empty())
+        m_viewNames.push_back("");
 
 #if USE_GLM
     vkm::test_vkm_glm_compatibility();
@@ -41,29 +53,62 @@ void VulkanCore::Init(EngineCore::IApp* pApp)
     pickPhysicalDevice();
     createLogicalDevice();
 
+    m_memoryAllocator = std::make_unique<MemoryAllocator>();
+    m_memoryAllocator->Init(physicalDevice, device);
+
+    m_uploadManager = std::make_unique<UploadManager>();
+    m_uploadManager->Init(this, findQueueFamilies(physicalDevice, surface).graphicsFamily.value(), graphicsQueue, transferQueueFamily, transferQueue);
+
+    m_geometryPool = std::make_unique<GeometryPool>();
+    // The depth pre-pass reads the pool's packed position stream
+    m_depthPrepass = m_pApp->args.depthPrepass;
+    m_geometryPool->Init(this, sizeof(NewVertex), m_depthPrepass ? std::optional<uint32_t>(offsetof(NewVertex, position)) : std::nullopt);
+
     createSwapChain();
     createSwapchainImageViews();
 
     createCommandPool();
     createColorResources();
+    createViewTargets();
     createDepthResources();
 
     createDescriptorSetLayout();
+    createPipelineCache();
     createGraphicsPipeline();
 
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    VkDeviceSize uniformAlignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 1);
+    m_cameraUBOStride = static_cast<uint32_t>((sizeof(CameraUBO) + uniformAlignment - 1) / uniformAlignment * uniformAlignment);
+
     createDescriptorPool();
     createFrameData();
+    createGpuProfiler();
 
-    g_emptyTexture->uploadTextureToGPU(this);
+    m_captureFrames = IsHeadless() && !m_pApp->args.headlessIgnoreSaveFrame;
+    if (m_captureFrames) {
+        // Two more buffers than frames in flight so writers can lag behind a little before the renderer waits for them
+        m_frameReadback.Init(this, m_frameTimeline, m_framesInFlight + 2, m_viewNames);
+    }
 
     auto pMainApp = static_cast<MainApplication*>(m_pApp);
     pMainApp->GetScene()->environment->generateCubemaps(this);
+
+    uploadSceneResources(*pMainApp->GetScene());
+
+    for (uint32_t i = 0; i < m_framesInFlight; i++) {
+        updateDescriptorSet(i, *pMainApp->GetScene());
+    }
 }
 
 void VulkanCore::cleanupSwapChain()
 {
     colorImage.Destroy();
     depthImage.Destroy();
+    for (auto& viewTarget : m_viewTargets) {
+        viewTarget.Destroy();
+    }
+    m_viewTargets.clear();
 
     if (swapChain != VK_NULL_HANDLE) {
         for (auto swapChainImage : swapChainImages) {
@@ -85,25 +130,56 @@ void VulkanCore::WaitIdle()
 void VulkanCore::Shutdown()
 {
     WaitIdle();
+    m_gpuProfiler.CollectAll();
+    if (m_captureFrames) {
+        m_frameReadback.Destroy();
+    }
     cleanupSwapChain();
 
     mainDeletionStack.flush();
 
-    vkDestroyPipeline(device, graphicsPipeline, nullptr);
+    if (m_bindless) {
+        m_bindlessMaterials.Destroy();
+    }
+
+    for (auto graphicsPipeline : graphicsPipelines) {
+        vkDestroyPipeline(device, graphicsPipeline, nullptr);
+    }
+    if (depthPrepassPipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(device, depthPrepassPipeline, nullptr);
+    }
     vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 
+    m_pipelineCache.Save();
+    m_pipelineCache.Destroy();
+
+    m_gpuProfiler.Destroy();
+
     vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 
     for (auto descriptorSetLayout : descriptorSetLayouts) {
         vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
     }
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        frames[i].Destroy(device);
+    for (auto& frame : frames) {
+        frame.Destroy(device);
     }
+    vkDestroySemaphore(device, m_frameTimeline, nullptr);
 
     vkDestroyCommandPool(device, commandPool, nullptr);
 
+    m_geometryPool->Shutdown();
+    m_geometryPool.reset();
+
+    m_uploadManager->Shutdown();
+    m_uploadManager.reset();
+
+#if VERBOSE
+    m_memoryAllocator->PrintStatistics();
+#endif
+    m_memoryAllocator->Shutdown();
+    m_memoryAllocator.reset();
+
     vkDestroyDevice(device, nullptr);
     device = VK_NULL_HANDLE;
 
@@ -126,6 +202,7 @@ void VulkanCore::recreateSwapChain()
     createSwapChain();
     createSwapchainImageViews();
     createColorResources();
+    createViewTargets();
     createDepthResources();
 }
 
@@ -271,6 +348,10 @@ void VulkanCore::createLogicalDevice()
     QueueFamilyIndices indices = findQueueFamilies(physicalDevice, surface);
     std::set<uint32_t> uniqueQueueFamilies = indices.getUniqueIndices();
 
+    transferQueueFamily = findDedicatedTransferQueueFamily(physicalDevice);
+    if (transferQueueFamily)
+        uniqueQueueFamilies.insert(*transferQueueFamily);
+
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -283,12 +364,29 @@ void VulkanCore::createLogicalDevice()
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
+    // Pipeline statistics are only queried for -profile-output
+    m_pipelineStatistics = Utility::FrameProfiler::GetInstance().IsEnabled() && GpuProfiler::SupportsPipelineStatistics(physicalDevice);
     VkPhysicalDeviceFeatures deviceFeatures {
         .samplerAnisotropy = VK_TRUE,
+        .pipelineStatisticsQuery = m_pipelineStatistics ? VK_TRUE : VK_FALSE,
     };
 
-    constexpr VkPhysicalDeviceDynamicRenderingFeatures dynamic_rendering_feature {
+    m_bindless = m_pApp->args.bindless;
+    if (m_bindless && !BindlessMaterials::IsSupported(physicalDevice)) {
+        std::cerr << "Descriptor indexing is not supported by this device, falling back to per material descriptor sets" << std::endl;
+        m_bindless = false;
+    }
+    VkPhysicalDeviceDescriptorIndexingFeatures descriptor_indexing_feature = BindlessMaterials::GetRequiredFeatures();
+
+    VkPhysicalDeviceTimelineSemaphoreFeatures timeline_semaphore_feature {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+        .pNext = m_bindless ? &descriptor_indexing_feature : nullptr,
+        .timelineSemaphore = VK_TRUE,
+    };
+
+    VkPhysicalDeviceDynamicRenderingFeatures dynamic_rendering_feature {
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES,
+        .pNext = &timeline_semaphore_feature,
         .dynamicRendering = VK_TRUE,
     };
 
@@ -319,6 +417,9 @@ void VulkanCore::createLogicalDevice()
     if (indices.presentFamily) {
         vkGetDeviceQueue(device, *indices.presentFamily, 0, &presentQueue);
     }
+    if (transferQueueFamily) {
+        vkGetDeviceQueue(device, *transferQueueFamily, 0, &transferQueue);
+    }
 }
 
 void VulkanCore::createSwapChain()
@@ -332,8 +433,12 @@ void VulkanCore::createSwapChain()
             static_cast<uint32_t>(height)
         };
 
-        uint32_t imageCount = 3;
+        uint32_t imageCount = std::max(m_pApp->args.headlessImages, 1u);
         swapChainImages.resize(imageCount);
+        // Recreated after a vkDeviceWaitIdle, nothing is pending on the new images
+        imageTimelineValues.assign(imageCount, 0);
+        nextImageIndex = 0;
+        availableImageCount = std::min(availableImageCount, imageCount);
 
         for (auto& NewSwapChainImage : swapChainImages) {
             NewSwapChainImage.Init(this, extent, 1, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_B8G8R8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
@@ -421,7 +526,7 @@ void VulkanCore::createDescriptorSetLayout()
     // set = 0
     {
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
-			{ 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, nullptr }, // UBO
+			{ 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, nullptr }, // UBO, one camera per view
 			{ 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr },
 			{ 2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr },
 			{ 3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr },
@@ -439,7 +544,12 @@ void VulkanCore::createDescriptorSetLayout()
     }
 
     // set = 1
-    {
+    if (m_bindless) {
+        // One table for all materials
+        m_bindlessMaxTextures = BindlessMaterials::GetMaxTextureCount(physicalDevice, 5); // set 0 has 5 samplers
+        descriptorSetLayouts[1] = BindlessMaterials::CreateDescriptorSetLayout(device, m_bindlessMaxTextures);
+    } else {
+        // One set per material
         std::array<VkDescriptorSetLayoutBinding, 4> bindings;
 
         for (uint32_t i = 0; i < bindings.size(); ++i) {
@@ -462,8 +572,15 @@ void VulkanCore::createDescriptorSetLayout()
     }
 }
 
+void VulkanCore::createPipelineCache()
+{
+    std::filesystem::path shaderPath = std::filesystem::current_path() / "shader_build";
+    m_pipelineCache.Init(device, physicalDevice, m_pApp->args.pipelineCachePath, PipelineCache::HashShaderDirectory(shaderPath));
+}
+
 void VulkanCore::createGraphicsPipeline()
 {
+    TRACE_ZONE("VulkanCore::createGraphicsPipeline");
     // Shader vertexShader(device, "s72.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
     // Shader fragmentShader(device, "s72.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 
@@ -472,7 +589,7 @@ void VulkanCore::createGraphicsPipeline()
     std::filesystem::path cwd = std::filesystem::current_path();
     std::filesystem::path shaderPath = cwd / "shader_build";
     std::filesystem::path vertShaderPath = shaderPath / "s72.vert.spv";
-    std::filesystem::path fragShaderPath = shaderPath / "s72.frag.spv";
+    std::filesystem::path fragShaderPath = shaderPath / (m_bindless ? "s72_bindless.frag.spv" : "s72.frag.spv");
 
     auto vertShaderCode = readShaderFile(vertShaderPath);
     auto fragShaderCode = readShaderFile(fragShaderPath);
@@ -532,11 +649,12 @@ void VulkanCore::createGraphicsPipeline()
         .sampleShadingEnable = VK_FALSE,
     };
 
+    // After a depth pre-pass the depth buffer already holds the nearest surfaces, so only those are shaded
     VkPipelineDepthStencilStateCreateInfo depthStencil {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
         .depthTestEnable = VK_TRUE,
-        .depthWriteEnable = VK_TRUE,
-        .depthCompareOp = VK_COMPARE_OP_LESS,
+        .depthWriteEnable = m_depthPrepass ? VK_FALSE : VK_TRUE,
+        .depthCompareOp = m_depthPrepass ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS,
         .depthBoundsTestEnable = VK_FALSE,
         .stencilTestEnable = VK_FALSE,
         .front = {}, // Optional
@@ -612,8 +730,85 @@ void VulkanCore::createGraphicsPipeline()
         .basePipelineHandle = VK_NULL_HANDLE,
     };
 
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create graphics pipeline!");
+    // One pipeline per material type with the type as a specialization constant, or a single uber pipeline (MATERIAL_TYPE = -1)
+    // that reads the type per draw. The variants only differ in the fragment stage and are compiled in parallel.
+    uint32_t pipelineCount = m_pApp->args.uberShader ? 1 : static_cast<uint32_t>(EMaterialType::COUNT);
+    VkSpecializationMapEntry materialTypeEntry {
+        .constantID = 0,
+        .offset = 0,
+        .size = sizeof(int32_t),
+    };
+    std::vector<int32_t> materialTypes(pipelineCount);
+    std::vector<VkSpecializationInfo> specializationInfos(pipelineCount);
+    std::vector<std::array<VkPipelineShaderStageCreateInfo, 2>> variantStages(pipelineCount);
+    std::vector<VkGraphicsPipelineCreateInfo> pipelineInfos(pipelineCount, pipelineInfo);
+    for (uint32_t i = 0; i < pipelineCount; i++) {
+        materialTypes[i] = m_pApp->args.uberShader ? -1 : static_cast<int32_t>(i);
+        specializationInfos[i] = VkSpecializationInfo {
+            .mapEntryCount = 1,
+            .pMapEntries = &materialTypeEntry,
+            .dataSize = sizeof(int32_t),
+            .pData = &materialTypes[i],
+        };
+        variantStages[i] = { vertShaderStageInfo, fragShaderStageInfo };
+        variantStages[i][1].pSpecializationInfo = &specializationInfos[i];
+        pipelineInfos[i].pStages = variantStages[i].data();
+    }
+
+    graphicsPipelines.resize(pipelineCount);
+    m_pipelineCache.CreateGraphicsPipelines(pipelineInfos.data(), pipelineCount, graphicsPipelines.data());
+
+    if (m_depthPrepass) {
+        // Vertex stage only, fed by the 12 byte position stream. Same layout and attachments as the shading pipelines so both run
+        // in one rendering scope, color writes are masked off.
+        auto depthShaderCode = readShaderFile(shaderPath / "s72_depth.vert.spv");
+        VkShaderModule depthShaderModule = createShaderModule(depthShaderCode);
+        VkPipelineShaderStageCreateInfo depthShaderStageInfo {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = depthShaderModule,
+            .pName = "main",
+        };
+
+        VkVertexInputBindingDescription positionBinding {
+            .binding = 0,
+            .stride = GeometryPool::kPositionStride,
+            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+        };
+        VkVertexInputAttributeDescription positionAttribute {
+            .location = 0,
+            .binding = 0,
+            .format = VK_FORMAT_R32G32B32_SFLOAT,
+            .offset = 0,
+        };
+        VkPipelineVertexInputStateCreateInfo positionInputInfo {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+            .vertexBindingDescriptionCount = 1,
+            .pVertexBindingDescriptions = &positionBinding,
+            .vertexAttributeDescriptionCount = 1,
+            .pVertexAttributeDescriptions = &positionAttribute,
+        };
+
+        VkPipelineDepthStencilStateCreateInfo prepassDepthStencil = depthStencil;
+        prepassDepthStencil.depthWriteEnable = VK_TRUE;
+        prepassDepthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+
+        VkPipelineColorBlendAttachmentState noColorWrite {
+            .blendEnable = VK_FALSE,
+            .colorWriteMask = 0,
+        };
+        VkPipelineColorBlendStateCreateInfo prepassColorBlending = colorBlending;
+        prepassColorBlending.pAttachments = &noColorWrite;
+
+        VkGraphicsPipelineCreateInfo prepassInfo = pipelineInfo;
+        prepassInfo.stageCount = 1;
+        prepassInfo.pStages = &depthShaderStageInfo;
+        prepassInfo.pVertexInputState = &positionInputInfo;
+        prepassInfo.pDepthStencilState = &prepassDepthStencil;
+        prepassInfo.pColorBlendState = &prepassColorBlending;
+        m_pipelineCache.CreateGraphicsPipelines(&prepassInfo, 1, &depthPrepassPipeline);
+
+        vkDestroyShaderModule(device, depthShaderModule, nullptr);
     }
 
     vkDestroyShaderModule(device, fragShaderModule, nullptr);
@@ -644,6 +839,17 @@ void VulkanCore::createColorResources()
     colorImage.InitImageSampler(VK_SAMPLER_ADDRESS_MODE_REPEAT);
 }
 
+void VulkanCore::createViewTargets()
+{
+    // Resolve targets of the views after the first, which resolves into the swap chain image
+    VkFormat colorFormat = swapChainImages[0].m_imageInfo.format;
+    m_viewTargets.resize(m_viewNames.size() - 1);
+    for (auto& viewTarget : m_viewTargets) {
+        viewTarget.Init(this, swapChainImages[0].GetImageExtent(), 1, VK_SAMPLE_COUNT_1_BIT, colorFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        viewTarget.InitImageView(colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+    }
+}
+
 void VulkanCore::createDepthResources()
 {
     VkFormat depthFormat = findDepthFormat();
@@ -662,20 +868,24 @@ VkFormat VulkanCore::findDepthFormat()
 
 void VulkanCore::createDescriptorPool()
 {
-    std::array<VkDescriptorPoolSize, 2> poolSizes {
+    std::array<VkDescriptorPoolSize, 3> poolSizes {
         VkDescriptorPoolSize {
+            .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+            .descriptorCount = m_framesInFlight,
+        },
+        {
             .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-            .descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT + MAX_MATERIAL_TYPES * MAX_DESCRIPTORS_IN_MATERIAL),
+            .descriptorCount = m_framesInFlight + static_cast<uint32_t>(MAX_MATERIAL_TYPES * MAX_DESCRIPTORS_IN_MATERIAL),
         },
         {
             .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT + MAX_MATERIAL_TYPES * MAX_DESCRIPTORS_IN_MATERIAL),
+            .descriptorCount = m_framesInFlight + static_cast<uint32_t>(MAX_MATERIAL_TYPES * MAX_DESCRIPTORS_IN_MATERIAL),
         }
     };
 
     VkDescriptorPoolCreateInfo poolInfo {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-        .maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT + MAX_MATERIAL_TYPES),
+        .maxSets = m_framesInFlight + static_cast<uint32_t>(MAX_MATERIAL_TYPES),
         .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
         .pPoolSizes = poolSizes.data(),
     };
@@ -688,35 +898,65 @@ void VulkanCore::createDescriptorPool()
 // Initialize Frame related data
 void VulkanCore::createFrameData()
 {
-    frames = std::vector<FrameData>(MAX_FRAMES_IN_FLIGHT);
-    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        createCommandBuffer(device, commandPool, frames[i].commandBuffer);
-        createDescriptorSet(device, descriptorSetLayouts[0], descriptorPool, frames[i].descriptorSet);
-        createFrameSyncObjects(frames[i].imageAvailableSemaphore, frames[i].renderFinishedSemaphore, frames[i].swapchainImageFence);
-        createUniformBuffers(frames[i].uniformBuffer);
+    frames = std::vector<FrameData>(m_framesInFlight);
+    for (auto& frame : frames) {
+        createCommandBuffer(device, commandPool, frame.commandBuffer);
+        createDescriptorSet(device, descriptorSetLayouts[0], descriptorPool, frame.descriptorSet);
+        createFrameSyncObjects(frame.imageAvailableSemaphore, frame.renderFinishedSemaphore);
+        createUniformBuffers(frame.uniformBuffer);
     }
+
+    VkSemaphoreTypeCreateInfo semaphoreTypeInfo {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = 0,
+    };
+    VkSemaphoreCreateInfo semaphoreInfo {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &semaphoreTypeInfo,
+    };
+    VK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &m_frameTimeline));
+}
+
+void VulkanCore::createGpuProfiler()
+{
+    Utility::FrameProfiler& profiler = Utility::FrameProfiler::GetInstance();
+    if (!profiler.IsEnabled())
+        return;
+
+    m_gpuProfiler.Init(device, physicalDevice, findQueueFamilies(physicalDevice, surface).graphicsFamily.value(), static_cast<uint32_t>(frames.size()), m_pipelineStatistics);
+    // Without any query the CPU part of a frame is all there is, no need to hold records back
+    profiler.SetExpectGpuResults(m_gpuProfiler.IsEnabled());
 }
 
 void VulkanCore::createUniformBuffers(Buffer& uniformBuffer)
 {
-    VkDeviceSize bufferSize = sizeof(CameraUBO);
+    VkDeviceSize bufferSize = VkDeviceSize(m_cameraUBOStride) * m_viewNames.size();
     uniformBuffer.Init(this, bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, true);
 }
 
-void VulkanCore::createFrameSyncObjects(VkSemaphore& imageAvailableSemaphore, VkSemaphore& renderFinishedSemaphore, VkFence& swapchainImageFence)
+void VulkanCore::createFrameSyncObjects(VkSemaphore& imageAvailableSemaphore, VkSemaphore& renderFinishedSemaphore)
 {
     VkSemaphoreCreateInfo semaphoreInfo {
         .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
     };
 
-    VkFenceCreateInfo fenceInfo {
-        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-        .flags = VK_FENCE_CREATE_SIGNALED_BIT,
-    };
-
     VK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphore));
     VK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphore));
-    VK(vkCreateFence(device, &fenceInfo, nullptr, &swapchainImageFence));
+}
+
+void VulkanCore::waitFrameTimeline(uint64_t timelineValue)
+{
+    if (timelineValue == 0)
+        return;
+
+    VkSemaphoreWaitInfo waitInfo {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &m_frameTimeline,
+        .pValues = &timelineValue,
+    };
+    VK(vkWaitSemaphores(device, &waitInfo, UINT64_MAX));
 }
 
 VkCommandBuffer VulkanCore::beginSingleTimeCommands() const
@@ -744,18 +984,82 @@ void VulkanCore::endSingleTimeCommands(VkCommandBuffer commandBuffer) const
 {
     vkEndCommandBuffer(commandBuffer);
 
+    // Work batched before this command buffer was recorded has to execute first
+    m_uploadManager->Flush();
+
     VkSubmitInfo submitInfo {
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
         .commandBufferCount = 1,
         .pCommandBuffers = &commandBuffer,
     };
 
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue);
+    // Wait for this submission only, not for everything else on the queue
+    VkFenceCreateInfo fenceInfo {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+    };
+    VkFence fence;
+    VK(vkCreateFence(device, &fenceInfo, nullptr, &fence));
+    VK(vkQueueSubmit(graphicsQueue, 1, &submitInfo, fence));
+    VK(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
+    vkDestroyFence(device, fence, nullptr);
 
     vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 }
 
+// Uploads every mesh, texture and material of the scene in a few batched submissions, so that nothing is uploaded while frames are recorded
+void VulkanCore::uploadSceneResources(Scene& scene)
+{
+    TRACE_ZONE("VulkanCore::uploadSceneResources");
+    g_emptyTexture->uploadTextureToGPU(this); // Material descriptor sets fall back to it
+
+    // Size the geometry pool once for the whole scene instead of growing it mesh by mesh
+    uint64_t totalVertexCount = 0, totalIndexCount = 0;
+    for (auto& [index, mesh] : scene.meshes) {
+        if (!mesh->meshData || mesh->meshData->IsOnGPU())
+            continue;
+        totalVertexCount += mesh->meshData->vertices.size();
+        if (mesh->meshData->indices)
+            totalIndexCount += mesh->meshData->indices->size();
+    }
+    m_geometryPool->Reserve(static_cast<uint32_t>(totalVertexCount), static_cast<uint32_t>(totalIndexCount));
+
+    if (m_bindless)
+        m_bindlessMaterials.Init(this, descriptorSetLayouts[1], m_bindlessMaxTextures);
+
+    for (auto& [index, mesh] : scene.meshes) {
+        if (mesh->meshData)
+            mesh->meshData->uploadModelToGPU(this);
+        if (auto pMaterial = mesh->GetMaterial()) {
+            if (m_bindless)
+                m_bindlessMaterials.AddMaterial(*pMaterial);
+            else
+                pMaterial->InitDescriptorSet(this);
+        }
+    }
+
+    if (m_bindless)
+        m_bindlessMaterials.Finalize();
+
+    m_lambertianSH.reset();
+    if (scene.environment) {
+        scene.environment->radiance.uploadTextureToGPU(this);
+        scene.environment->lambertian.uploadTextureToGPU(this);
+        scene.environment->irradiance.uploadTextureToGPU(this);
+        scene.environment->preFilteredEnv.uploadTextureToGPU(this);
+        scene.environment->lutBrdf.uploadTextureToGPU(this);
+
+        if (scene.environment->lambertianSH) {
+            m_lambertianSH.emplace();
+            for (size_t i = 0; i < m_lambertianSH->size(); i++) {
+                const vkm::vec3& coefficient = scene.environment->lambertianSH->coefficients[i];
+                (*m_lambertianSH)[i] = vkm::vec4(coefficient.r(), coefficient.g(), coefficient.b(), 0.0f);
+            }
+        }
+    }
+
+    m_uploadManager->Flush();
+}
+
 uint32_t VulkanCore::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
 {
     VkPhysicalDeviceMemoryProperties memProperties = getAllMemoryProperties(physicalDevice);
@@ -769,22 +1073,95 @@ uint32_t VulkanCore::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags p
     throw std::runtime_error("failed to find suitable memory type!");
 }
 
-void VulkanCore::recordCommandBuffer(VkCommandBuffer& commandBuffer, uint32_t imageIndex, Scene& scene)
+const std::vector<MeshInstance>& VulkanCore::cullMeshInstances(const RenderSnapshot& snapshot, uint32_t viewIndex, std::vector<MeshInstance>& culledMeshInstances)
 {
+    TRACE_ZONE("VulkanCore::cullMeshInstances");
+    Utility::ScopedCpuTimer cullTimer(Utility::ECpuPhase::Cull);
+
+#if VERBOSE
+    static size_t totalMeshCount = 0;
+    if (viewIndex == 0 && totalMeshCount != snapshot.meshInstances.size()) {
+        totalMeshCount = snapshot.meshInstances.size();
+        std::cout << "MeshInstances: " << totalMeshCount << std::endl;
+    }
+#endif
+    if (m_pApp->args.cullingType != "frustum")
+        return snapshot.meshInstances;
+
+    culledMeshInstances.clear();
+    for (auto& MeshInst : snapshot.meshInstances) {
+        // Frustum Culling
+        if (ICamera::FrustumCulling(snapshot.views[viewIndex].cullingViewProj, *MeshInst.pMesh, MeshInst.matWorld))
+            culledMeshInstances.push_back(MeshInst);
+    }
+
+#if VERBOSE
+    auto totalMeshCountAfterCulling = culledMeshInstances.size();
+    static size_t lastMeshInstanceCount = totalMeshCountAfterCulling;
+    if (viewIndex == 0 && lastMeshInstanceCount != totalMeshCountAfterCulling) {
+        lastMeshInstanceCount = totalMeshCountAfterCulling;
+        std::cout << "MeshInstances: " << totalMeshCountAfterCulling << "/" << totalMeshCount << std::endl;
+    }
+#endif
+    return culledMeshInstances;
+}
+
+void VulkanCore::recordCommandBuffer(VkCommandBuffer& commandBuffer, uint32_t imageIndex, const std::vector<const std::vector<MeshInstance>*>& viewMeshInstances)
+{
+    TRACE_ZONE("VulkanCore::recordCommandBuffer");
+    Utility::ScopedCpuTimer recordTimer(Utility::ECpuPhase::Record);
+
     VkCommandBufferBeginInfo beginInfo {};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
     VK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
 
+    m_gpuProfiler.BeginFrame(commandBuffer, currentFrameInFlight, m_frameIndex);
+    m_gpuProfiler.BeginScope(commandBuffer, Utility::EGpuScope::Frame);
+
+    // The first view is resolved into the swap chain image, the other cameras of -render-cameras into their own targets
+    std::vector<Image*> viewTargets { &swapChainImages[imageIndex] };
+    for (auto& viewTarget : m_viewTargets)
+        viewTargets.push_back(&viewTarget);
+    assert(viewMeshInstances.size() <= viewTargets.size());
+
+    m_gpuProfiler.BeginScope(commandBuffer, Utility::EGpuScope::MainPass);
+    for (uint32_t viewIndex = 0; viewIndex < viewMeshInstances.size(); viewIndex++) {
+        if (viewIndex > 0) {
+            // The views share the multisampled color and depth attachments, which the next view clears again
+            VkMemoryBarrier attachmentBarrier {
+                .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            };
+            VkPipelineStageFlags attachmentStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+            vkCmdPipelineBarrier(commandBuffer, attachmentStages, attachmentStages, 0, 1, &attachmentBarrier, 0, nullptr, 0, nullptr);
+        }
+        recordView(commandBuffer, *viewTargets[viewIndex], viewIndex, *viewMeshInstances[viewIndex]);
+    }
+    m_gpuProfiler.EndScope(commandBuffer, Utility::EGpuScope::MainPass);
+
+    if (m_captureFrames)
+        m_frameReadback.RecordCopy(commandBuffer, viewTargets, m_frameIndex);
+
     if (!IsHeadless())
-        swapChainImages[imageIndex].TransitionLayout(commandBuffer, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        swapChainImages[imageIndex].TransitionLayout(commandBuffer, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+    m_gpuProfiler.EndScope(commandBuffer, Utility::EGpuScope::Frame);
+    VK(vkEndCommandBuffer(commandBuffer));
+}
+
+void VulkanCore::recordView(VkCommandBuffer& commandBuffer, Image& target, uint32_t viewIndex, const std::vector<MeshInstance>& meshInstances)
+{
+    // Headless images and view targets stay in the attachment layout after their first frame, this is a no-op then
+    target.TransitionLayout(commandBuffer, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 
     const VkRenderingAttachmentInfo color_attachment_info {
         .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
         .imageView = colorImage.imageView,
         .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
         .resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT,
-        .resolveImageView = swapChainImages[imageIndex].imageView,
+        .resolveImageView = target.imageView,
         .resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
         .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
         .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
@@ -817,8 +1194,6 @@ void VulkanCore::recordCommandBuffer(VkCommandBuffer& commandBuffer, uint32_t im
 
     BeginRendering(commandBuffer, render_info);
 
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-
     VkViewport viewport {
         .x = 0.0f,
         .y = 0.0f,
@@ -839,74 +1214,105 @@ void VulkanCore::recordCommandBuffer(VkCommandBuffer& commandBuffer, uint32_t im
 
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &frames[currentFrameInFlight].descriptorSet, 0, nullptr);
-
-    // TODO: Add environment map support
+    // The view's camera in the frame's dynamic uniform buffer
+    uint32_t cameraOffset = viewIndex * m_cameraUBOStride;
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &frames[currentFrameInFlight].descriptorSet, 1, &cameraOffset);
 
-    std::vector<MeshInstance> meshInstances;
-    scene.Traverse(meshInstances);
-#if VERBOSE
-    static size_t totalMeshCount = 0;
-    if (totalMeshCount != meshInstances.size()) {
-        totalMeshCount = meshInstances.size();
-        std::cout << "MeshInstances: " << totalMeshCount << std::endl;
-    }
-#endif
-    if (m_pApp->args.cullingType == "frustum") {
-        std::vector<MeshInstance> meshInstancesCulled;
-        for (auto& MeshInst : meshInstances) {
-            // Frustum Culling
-            if (CameraManager::GetInstance().GetActiveCamera()->FrustumCulling(MeshInst.pMesh, MeshInst.matWorld))
-                meshInstancesCulled.push_back(MeshInst);
-        }
-        meshInstances = std::move(meshInstancesCulled);
+    if (m_bindless) {
+        VkDescriptorSet materialSet = m_bindlessMaterials.GetDescriptorSet();
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &materialSet, 0, nullptr);
     }
 
-#if VERBOSE
-    auto totalMeshCountAfterCulling = meshInstances.size();
-    static size_t lastMeshInstanceCount = totalMeshCountAfterCulling;
-    if (lastMeshInstanceCount != totalMeshCountAfterCulling) {
-        lastMeshInstanceCount = totalMeshCountAfterCulling;
-        std::cout << "MeshInstances: " << totalMeshCountAfterCulling << "/" << totalMeshCount << std::endl;
-    }
-#endif
+    // TODO: Add environment map support
 
+    struct DrawItem {
+        const MeshInstance* pMeshInstance;
+        Material* pMaterial;
+        uint32_t pipelineIndex;
+    };
+    std::vector<DrawItem> drawItems;
+    drawItems.reserve(meshInstances.size());
     for (auto& MeshInst : meshInstances) {
-        auto& meshData = MeshInst.pMesh->meshData;
-
-        // This is a lazy way to handle the case where the mesh data is not yet uploaded to the GPU
-        if (!meshData->uploadModelToGPU(this))
+        // Uploaded up front by uploadSceneResources()
+        if (!MeshInst.pMesh->meshData->IsOnGPU())
             continue;
 
         // mesh - material - texture & descriptor set
         auto pMaterial = MeshInst.pMesh->GetMaterial();
-        if (pMaterial == nullptr) {
-            std::cerr << "Material is nullptr" << std::endl;
+        if (pMaterial == nullptr || (m_bindless ? pMaterial->bindlessIndex == UINT32_MAX : pMaterial->descriptorSet == VK_NULL_HANDLE)) {
+            std::cerr << "Material is nullptr or not initialized" << std::endl;
             continue;
         }
-        pMaterial->InitDescriptorSet(this);
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &pMaterial->descriptorSet, 0, nullptr);
+        uint32_t pipelineIndex = graphicsPipelines.size() > 1 ? static_cast<uint32_t>(pMaterial->type) : 0;
+        drawItems.push_back({ &MeshInst, pMaterial.get(), pipelineIndex });
+    }
+    // Group draws by pipeline so that every variant is bound once. Stable, so the order within a pipeline stays deterministic.
+    std::stable_sort(drawItems.begin(), drawItems.end(), [](const DrawItem& a, const DrawItem& b) { return a.pipelineIndex < b.pipelineIndex; });
+
+    // The pre-pass timestamps and the statistics query exist once per frame, they cover the first view
+    bool isProfiledView = viewIndex == 0;
+
+    if (m_depthPrepass) {
+        // Lay down depth for every draw first, with positions only. Nothing is shaded here, the shading draws then run the
+        // fragment shader once per visible sample instead of once per overlapping surface.
+        if (isProfiledView)
+            m_gpuProfiler.BeginScope(commandBuffer, Utility::EGpuScope::DepthPrepass);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPrepassPipeline);
+        m_geometryPool->BindPositions(commandBuffer);
+        for (auto& drawItem : drawItems) {
+            // The depth shader only reads matWorld, the push still has to cover the stages of the whole range
+            SPushConstant pushConstant = {
+                .matWorld = drawItem.pMeshInstance->matWorld,
+            };
+            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(vkm::mat4), &pushConstant.matWorld);
+            drawItem.pMeshInstance->pMesh->meshData->draw(commandBuffer);
+        }
+        if (isProfiledView)
+            m_gpuProfiler.EndScope(commandBuffer, Utility::EGpuScope::DepthPrepass);
+    }
+
+    // All meshes live in the shared geometry pool, draws below only pass their offsets
+    m_geometryPool->Bind(commandBuffer);
+
+    // Statistics cover the shading draws only, so fs_invocations counts shaded fragments with or without the pre-pass
+    if (isProfiledView)
+        m_gpuProfiler.BeginStatistics(commandBuffer);
+
+    uint32_t boundPipelineIndex = UINT32_MAX;
+    const Material* pBoundMaterial = nullptr;
+    for (auto& drawItem : drawItems) {
+        const MeshInstance& MeshInst = *drawItem.pMeshInstance;
+        auto& meshData = MeshInst.pMesh->meshData;
+        Material* pMaterial = drawItem.pMaterial;
+
+        if (drawItem.pipelineIndex != boundPipelineIndex) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipelines[drawItem.pipelineIndex]);
+            boundPipelineIndex = drawItem.pipelineIndex;
+        }
+        if (!m_bindless && pMaterial != pBoundMaterial) {
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &pMaterial->descriptorSet, 0, nullptr);
+            pBoundMaterial = pMaterial;
+        }
 
         SPushConstant pushConstant = {
             .matWorld = MeshInst.matWorld,
             .matNormal = vkm::transpose(vkm::inverse(MeshInst.matWorld))
         };
 
-        pushConstant.matNormal[3][3] = static_cast<float>(MeshInst.pMesh->GetMaterialType()); // A temp hack to pass material type to shader
+        // The uber shader without a material table still reads the type from the otherwise unused corner of matNormal
+        if (graphicsPipelines.size() == 1 && !m_bindless)
+            pushConstant.matNormal[3][3] = static_cast<float>(pMaterial->type);
 
         // upload the matrix to the GPU via push constants
         vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SPushConstant), &pushConstant);
 
-        meshData->draw(commandBuffer);
+        // The bindless shader reads the material index from gl_InstanceIndex
+        meshData->draw(commandBuffer, m_bindless ? pMaterial->bindlessIndex : 0);
     }
+    if (isProfiledView)
+        m_gpuProfiler.EndStatistics(commandBuffer);
 
     EndRendering(commandBuffer);
-
-
-    if (!IsHeadless())
-        swapChainImages[imageIndex].TransitionLayout(commandBuffer, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
-
-    VK(vkEndCommandBuffer(commandBuffer));
 }
 
 void VulkanCore::BeginRendering(VkCommandBuffer& commandBuffer, const VkRenderingInfo render_info)
@@ -935,25 +1341,25 @@ void VulkanCore::EndRendering(VkCommandBuffer& commandBuffer)
 #endif
 }
 
-void VulkanCore::updateUniformBuffer(uint32_t currentImage)
+void VulkanCore::updateUniformBuffer(uint32_t currentImage, const RenderSnapshot& snapshot)
 {
-    auto camera = CameraManager::GetInstance().GetActiveCamera();
-
-#ifndef NDEBUG
-    if (CameraManager::GetInstance().IsDebugModeActive())
-        camera = CameraManager::GetInstance().GetDebugCamera();
-#endif
-
-    vkm::vec3 cameraPos = camera->getPosition();
-    CameraUBO ubo {
-        .view = camera->getViewMatrix(),
-        .proj = camera->getProjectionMatrix(),
-        .viewproj = camera->getProjectionMatrix() * camera->getViewMatrix(),
-        .position = vkm::vec4(cameraPos.r(), cameraPos.g(), cameraPos.b(), 1.0f),
-    };
-
+    TRACE_ZONE("VulkanCore::updateUniformBuffer");
     assert(frames[currentFrameInFlight].uniformBuffer.m_pMappedData);
-    memcpy(*frames[currentFrameInFlight].uniformBuffer.m_pMappedData, &ubo, sizeof(ubo));
+    uint8_t* pMappedData = static_cast<uint8_t*>(*frames[currentFrameInFlight].uniformBuffer.m_pMappedData);
+
+    size_t viewCount = std::min(snapshot.views.size(), m_viewNames.size());
+    for (size_t i = 0; i < viewCount; i++) {
+        const CameraSnapshot& camera = snapshot.views[i].camera;
+        CameraUBO ubo {
+            .view = camera.view,
+            .proj = camera.proj,
+            .viewproj = camera.proj * camera.view,
+            .position = vkm::vec4(camera.position.r(), camera.position.g(), camera.position.b(), 1.0f),
+            .lambertianSH = m_lambertianSH.value_or(std::array<vkm::vec4, 9> {}),
+            .useLambertianSH = m_lambertianSH.has_value(),
+        };
+        memcpy(pMappedData + i * m_cameraUBOStride, &ubo, sizeof(ubo));
+    }
 }
 
 void VulkanCore::updateDescriptorSet(uint32_t currentFrameInFlight, Scene& scene)
@@ -964,11 +1370,6 @@ void VulkanCore::updateDescriptorSet(uint32_t currentFrameInFlight, Scene& scene
         .range = sizeof(CameraUBO),
     };
 
-    scene.environment->radiance.uploadTextureToGPU(this);
-	scene.environment->lambertian.uploadTextureToGPU(this);
-	scene.environment->irradiance.uploadTextureToGPU(this);
-	scene.environment->preFilteredEnv.uploadTextureToGPU(this);
-	scene.environment->lutBrdf.uploadTextureToGPU(this);
     VkDescriptorImageInfo radianceImageInfo = scene.environment->radiance.textureImage.GetDescriptorImageInfo();
 	VkDescriptorImageInfo lambertianImageInfo = scene.environment->lambertian.textureImage.GetDescriptorImageInfo();
 	VkDescriptorImageInfo irradianceImageInfo = scene.environment->irradiance.textureImage.GetDescriptorImageInfo();
@@ -982,7 +1383,7 @@ void VulkanCore::updateDescriptorSet(uint32_t currentFrameInFlight, Scene& scene
             .dstBinding = 0,
             .dstArrayElement = 0,
             .descriptorCount = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .pBufferInfo = &bufferInfo,
         },
         {
@@ -1033,88 +1434,144 @@ void VulkanCore::updateDescriptorSet(uint32_t currentFrameInFlight, Scene& scene
     vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 }
 
-void VulkanCore::drawFrame(Scene& scene)
+void VulkanCore::drawFrame(const RenderSnapshot& snapshot)
 {
+    TRACE_ZONE("VulkanCore::drawFrame");
     bool isHeadless = IsHeadless();
-    if (isHeadless) {
-        if (!m_pApp->args.limitFPS)
-            readyForNextImage = true;
-        if (!readyForNextImage)
-            return;
-    }
+    // Without -limitfps headless frames render back to back, AVAILABLE events only add up to the image count
+    if (isHeadless && m_pApp->args.limitFPS && availableImageCount == 0)
+        return;
 
-    currentFrameInFlight = (currentFrameInFlight + 1) % MAX_FRAMES_IN_FLIGHT;
-    // wait for the frame needed to use to be finished (if still in flight)
-    vkWaitForFences(device, 1, &frames[currentFrameInFlight].swapchainImageFence, VK_TRUE, UINT64_MAX);
-    vkResetFences(device, 1, &frames[currentFrameInFlight].swapchainImageFence);
+    currentFrameInFlight = static_cast<uint32_t>(m_frameIndex % m_framesInFlight);
+    // wait for the frame that last used this FrameData, m_framesInFlight frames ago, to be finished (if still in flight)
+    {
+        TRACE_ZONE("WaitFrameTimeline");
+        Utility::ScopedCpuTimer fenceWaitTimer(Utility::ECpuPhase::FenceWait);
+        if (m_frameIndex >= m_framesInFlight)
+            waitFrameTimeline(m_frameIndex - m_framesInFlight + 1);
+    }
     frames[currentFrameInFlight].deletionStack.flush(); // delete all temporary data
 
     uint32_t imageIndex = std::numeric_limits<uint32_t>::max(); // index of the swap chain image that will be used for the current frame
 
-    if (isHeadless) {
-        imageIndex = AcquireNextImageIndex();
-    } else {
-        VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, frames[currentFrameInFlight].imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
-        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-            recreateSwapChain();
-            return;
-        } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-            throw std::runtime_error("failed to acquire swap chain image!");
+    {
+        TRACE_ZONE("AcquireImage");
+        if (isHeadless) {
+            Utility::ScopedCpuTimer fenceWaitTimer(Utility::ECpuPhase::FenceWait);
+            imageIndex = AcquireNextImageIndex();
+        } else {
+            VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, frames[currentFrameInFlight].imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+            if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+                recreateSwapChain();
+                return;
+            } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+                throw std::runtime_error("failed to acquire swap chain image!");
+            }
         }
     }
 
-    updateDescriptorSet(currentFrameInFlight, scene);
-
-    updateUniformBuffer(currentFrameInFlight);
+    updateUniformBuffer(currentFrameInFlight, snapshot);
     vkResetCommandBuffer(frames[currentFrameInFlight].commandBuffer, /*VkCommandBufferResetFlagBits*/ 0);
-    recordCommandBuffer(frames[currentFrameInFlight].commandBuffer, imageIndex, scene);
+    // Animation and traversal are shared, culling runs per view
+    size_t viewCount = std::min(snapshot.views.size(), m_viewNames.size());
+    std::vector<std::vector<MeshInstance>> culledMeshInstances(viewCount);
+    std::vector<const std::vector<MeshInstance>*> viewMeshInstances(viewCount);
+    for (uint32_t i = 0; i < viewCount; i++)
+        viewMeshInstances[i] = &cullMeshInstances(snapshot, i, culledMeshInstances[i]);
+    recordCommandBuffer(frames[currentFrameInFlight].commandBuffer, imageIndex, viewMeshInstances);
+
+    std::array<VkSemaphore, 2> waitSemaphores;
+    std::array<VkPipelineStageFlags, 2> waitStages;
+    std::array<uint64_t, 2> waitValues; // Only read for timeline semaphores
+    uint32_t waitSemaphoreCount = 0;
+    if (!isHeadless) {
+        waitSemaphores[waitSemaphoreCount] = frames[currentFrameInFlight].imageAvailableSemaphore;
+        waitStages[waitSemaphoreCount] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        waitValues[waitSemaphoreCount++] = 0;
+    }
+    // Uploads submitted since the last frame have to complete before this frame reads them
+    uint64_t uploadValue = m_uploadManager->Flush();
+    if (uploadValue > lastWaitedUploadValue) {
+        waitSemaphores[waitSemaphoreCount] = m_uploadManager->GetTimelineSemaphore();
+        waitStages[waitSemaphoreCount] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        waitValues[waitSemaphoreCount++] = uploadValue;
+        lastWaitedUploadValue = uploadValue;
+    }
+    // The frame timeline tells the readback writers (and anyone else off the render thread) when this frame is done
+    std::array<VkSemaphore, 2> signalSemaphores;
+    std::array<uint64_t, 2> signalValues; // Only read for timeline semaphores
+    uint32_t signalSemaphoreCount = 0;
+    if (!isHeadless) {
+        signalSemaphores[signalSemaphoreCount] = frames[currentFrameInFlight].renderFinishedSemaphore;
+        signalValues[signalSemaphoreCount++] = 0;
+    }
+    signalSemaphores[signalSemaphoreCount] = m_frameTimeline;
+    signalValues[signalSemaphoreCount++] = m_frameIndex + 1;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .waitSemaphoreValueCount = waitSemaphoreCount,
+        .pWaitSemaphoreValues = waitValues.data(),
+        .signalSemaphoreValueCount = signalSemaphoreCount,
+        .pSignalSemaphoreValues = signalValues.data(),
+    };
 
-    VkSemaphore waitSemaphores[] = { frames[currentFrameInFlight].imageAvailableSemaphore };
-    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-    VkSemaphore signalSemaphores[] = { frames[currentFrameInFlight].renderFinishedSemaphore };
     VkSubmitInfo submitInfo {
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .waitSemaphoreCount = isHeadless ? uint32_t(0) : 1,
-        .pWaitSemaphores = isHeadless ? nullptr : waitSemaphores, // will wait on these semaphores before the command buffer starts executing
-        .pWaitDstStageMask = waitStages,
+        .pNext = &timelineInfo,
+        .waitSemaphoreCount = waitSemaphoreCount,
+        .pWaitSemaphores = waitSemaphores.data(), // will wait on these semaphores before the command buffer starts executing
+        .pWaitDstStageMask = waitStages.data(),
         .commandBufferCount = 1,
         .pCommandBuffers = &frames[currentFrameInFlight].commandBuffer,
-        .signalSemaphoreCount = isHeadless ? uint32_t(0) : 1,
-        .pSignalSemaphores = isHeadless ? nullptr : signalSemaphores, // will signal these semaphores after the command buffer has finished execution
+        .signalSemaphoreCount = signalSemaphoreCount,
+        .pSignalSemaphores = signalSemaphores.data(), // will signal these semaphores after the command buffer has finished execution
     };
 
-    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, frames[currentFrameInFlight].swapchainImageFence) != VK_SUCCESS) {
-        throw std::runtime_error("failed to submit draw command buffer!");
+    {
+        TRACE_ZONE("QueueSubmit");
+        Utility::ScopedCpuTimer submitTimer(Utility::ECpuPhase::Submit);
+        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit draw command buffer!");
+        }
     }
 
     VkSwapchainKHR swapChains[] = { swapChain };
     VkPresentInfoKHR presentInfo {
         .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
         .waitSemaphoreCount = 1,
-        .pWaitSemaphores = signalSemaphores, // will wait on these semaphores before the image is presented
+        .pWaitSemaphores = &frames[currentFrameInFlight].renderFinishedSemaphore, // will wait on these semaphores before the image is presented
         .swapchainCount = 1,
         .pSwapchains = swapChains,
         .pImageIndices = &imageIndex,
     };
 
-    if (isHeadless) {
-        if (m_pApp->events.windowResized) {
-            m_pApp->events.windowResized = false;
-            recreateSwapChain();
-        }
-        readyForNextImage = false;
-    } else {
-        VkResult result = vkQueuePresentKHR(presentQueue, &presentInfo);
+    {
+        TRACE_ZONE("Present");
+        Utility::ScopedCpuTimer presentTimer(Utility::ECpuPhase::Present);
+        if (isHeadless) {
+            if (m_pApp->events.windowResized) {
+                m_pApp->events.windowResized = false;
+                recreateSwapChain();
+            } else {
+                imageTimelineValues[imageIndex] = m_frameIndex + 1;
+            }
+            if (availableImageCount > 0)
+                availableImageCount--;
+        } else {
+            VkResult result = vkQueuePresentKHR(presentQueue, &presentInfo);
 
-        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_pApp->events.windowResized) {
-            m_pApp->events.windowResized = false;
-            recreateSwapChain();
-        } else if (result != VK_SUCCESS) {
-            throw std::runtime_error("failed to present swap chain image!");
+            if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_pApp->events.windowResized) {
+                m_pApp->events.windowResized = false;
+                recreateSwapChain();
+            } else if (result != VK_SUCCESS) {
+                throw std::runtime_error("failed to present swap chain image!");
+            }
         }
     }
 
-    return;
+    Utility::FrameProfiler::GetInstance().EndFrame(m_frameIndex);
+    m_frameIndex++;
 }
 
 VkShaderModule VulkanCore::createShaderModule(const std::vector<char>& code)
@@ -1233,43 +1690,29 @@ bool VulkanCore::checkValidationLayerSupport()
 void VulkanCore::PresentImage()
 {
     // make the least-recently-available image in the swap chain available to be rendered to (after waiting for any rendering pending on this image to complete). This, effectively, starts a frame rendering.
-    nextImageIndex = (nextImageIndex + 1) % swapChainImages.size();
-    readyForNextImage = true;
+    // The wait happens in AcquireNextImageIndex, so several AVAILABLE events can queue up to one frame per image.
+    availableImageCount = std::min(availableImageCount + 1, static_cast<uint32_t>(swapChainImages.size()));
 }
 
 void VulkanCore::SaveFrame(const std::string& savePath)
 {
-    vkWaitForFences(device, 1, &frames[currentFrameInFlight].swapchainImageFence, VK_TRUE, UINT64_MAX);
-
-    uint32_t texWidth = static_cast<uint32_t>(m_pApp->args.windowSize.first);
-    uint32_t texHeight = static_cast<uint32_t>(m_pApp->args.windowSize.second);
-
-    auto bufferData = swapChainImages[currentFrameInFlight].copyToMemory();
-
-    // Open the file in binary mode
-    std::ofstream file(savePath, std::ios::out | std::ios::binary);
-    if (!file) {
-        throw std::runtime_error("Failed to open file for writing: " + savePath);
-    }
-
-    // Write the PPM header
-    file << "P6\n"
-         << texWidth << " " << texHeight << "\n255\n";
-
-    // Write the pixel data
-    // PPM format expects pixels in binary RGB format, so we only need to write the RGB parts of each BGRA pixel
-    for (uint32_t i = 0; i < texWidth * texHeight; ++i) {
-        char* pixel = reinterpret_cast<char*>(bufferData.get() + i * 4);
-        std::swap(pixel[0], pixel[2]); // Vulkan has BGRA format, PPM has RGB
-        file.write(pixel, 3);
+    if (!m_captureFrames) {
+        std::cerr << "SaveFrame: frames are only captured in headless mode" << std::endl;
+        return;
     }
-
-    file.close();
+    // The copy of the last frame is already recorded into its command buffer, a writer job picks it up once the frame completes
+    TRACE_ZONE("VulkanCore::SaveFrame");
+    Utility::ScopedCpuTimer readbackTimer(Utility::ECpuPhase::Readback);
+    m_frameReadback.RequestSave(savePath);
 }
 
 uint32_t VulkanCore::AcquireNextImageIndex()
 {
-    return nextImageIndex;
+    uint32_t imageIndex = nextImageIndex;
+    nextImageIndex = (nextImageIndex + 1) % swapChainImages.size();
+    // Only waits when there are more frames in flight than headless images
+    waitFrameTimeline(imageTimelineValues[imageIndex]);
+    return imageIndex;
 }
 
 void FrameData::Destroy(const VkDevice& device)
@@ -1280,6 +1723,5 @@ void FrameData::Destroy(const VkDevice& device)
 
     vkDestroySemaphore(device, imageAvailableSemaphore, nullptr);
     vkDestroySemaphore(device, renderFinishedSemaphore, nullptr);
-    vkDestroyFence(device, swapchainImageFence, nullptr);
     uniformBuffer.Destroy();
 }
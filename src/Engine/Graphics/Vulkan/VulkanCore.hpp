@@ -1,19 +1,28 @@
 #pragma once
 
+#include "BindlessMaterials.hpp"
 #include "Buffer.hpp"
+#include "FrameReadback.hpp"
+#include "GeometryPool.hpp"
+#include "GpuProfiler.hpp"
 #include "Image.hpp"
+#include "MemoryAllocator.hpp"
+#include "PipelineCache.hpp"
+#include "UploadManager.hpp"
 #include "VulkanHelper.hpp"
 #include "Window/IWindow.hpp"
 #include "pch.hpp"
 
 class Scene;
+struct MeshInstance;
+struct RenderSnapshot;
 namespace EngineCore {
 class IApp;
 }
 
 class Image;
 
-const int MAX_FRAMES_IN_FLIGHT = 2;
+const uint32_t MAX_FRAMES_IN_FLIGHT = 8; // Upper bound of -frames-in-flight
 const int MAX_MATERIAL_TYPES = 1024;
 const int MAX_DESCRIPTORS_IN_MATERIAL = 4;
 
@@ -46,6 +55,8 @@ struct CameraUBO {
     alignas(16) vkm::mat4 proj;
     alignas(16) vkm::mat4 viewproj;
     alignas(4) vkm::vec4 position;
+    alignas(16) std::array<vkm::vec4, 9> lambertianSH; // LambertianSH::coefficients in rgb
+    alignas(4) uint32_t useLambertianSH; // 0 samples the LAMBERTIAN cube map instead
 };
 
 struct FrameData {
@@ -53,7 +64,6 @@ struct FrameData {
     VkDescriptorSet descriptorSet;
     VkSemaphore imageAvailableSemaphore;
     VkSemaphore renderFinishedSemaphore;
-    VkFence swapchainImageFence;
     DeletionStack deletionStack;
     Buffer uniformBuffer;
 
@@ -64,7 +74,7 @@ class VulkanCore {
 public:
     void Init(EngineCore::IApp* pApp);
     void Shutdown();
-    void drawFrame(Scene& scene);
+    void drawFrame(const RenderSnapshot& snapshot);
 
 private:
     EngineCore::IApp* m_pApp = nullptr;
@@ -88,6 +98,8 @@ public: // High level
 
     VkQueue graphicsQueue;
     VkQueue presentQueue;
+    std::optional<uint32_t> transferQueueFamily; // Only set when the device has a dedicated transfer queue family
+    VkQueue transferQueue = VK_NULL_HANDLE;
     DeletionStack mainDeletionStack;
 
 private: // Swapchain
@@ -101,10 +113,20 @@ private: // Swapchain
 
 private: // Frame
     void createFrameData();
-    void createFrameSyncObjects(VkSemaphore& imageAvailableSemaphore, VkSemaphore& renderFinishedSemaphore, VkFence& swapchainImageFence);
+    void createFrameSyncObjects(VkSemaphore& imageAvailableSemaphore, VkSemaphore& renderFinishedSemaphore);
+    // Blocks until the frame timeline reached timelineValue, 0 returns right away
+    void waitFrameTimeline(uint64_t timelineValue);
 
-    std::vector<FrameData> frames;
+    std::vector<FrameData> frames; // One per frame in flight, frame N uses frames[N % m_framesInFlight]
+    uint32_t m_framesInFlight = 2;
     uint32_t currentFrameInFlight = 0;
+    uint64_t m_frameIndex = 0; // Frames recorded so far, identifies a frame in the profiler output
+    // Signaled with m_frameIndex + 1 by each frame's submission. Paces the frames in flight: a FrameData is reused once the frame
+    // that last used it completed.
+    VkSemaphore m_frameTimeline = VK_NULL_HANDLE;
+
+    bool m_captureFrames = false; // Headless runs copy every frame into the readback ring for SAVE events
+    FrameReadback m_frameReadback;
 
 public:
     std::array<VkDescriptorSetLayout, 2> descriptorSetLayouts; // TEMP public, [1] is for material
@@ -112,17 +134,33 @@ public:
 
 private:
     VkPipelineLayout pipelineLayout;
-    VkPipeline graphicsPipeline;
+    std::vector<VkPipeline> graphicsPipelines; // Indexed by EMaterialType, a single entry with --uber-shader
+    bool m_depthPrepass = false; // --depth-prepass, the pipelines above then test EQUAL against the pre-pass depth
+    VkPipeline depthPrepassPipeline = VK_NULL_HANDLE;
+    PipelineCache m_pipelineCache;
+
+    bool m_bindless = false; // Material textures in one descriptor array, see BindlessMaterials
+    uint32_t m_bindlessMaxTextures = 0;
+    BindlessMaterials m_bindlessMaterials;
+
+    bool m_pipelineStatistics = false; // pipelineStatisticsQuery enabled on the device
+    GpuProfiler m_gpuProfiler; // Only initialized with -profile-output
 
     VkCommandPool commandPool;
 
     Image depthImage;
     Image colorImage;
 
+    std::vector<std::string> m_viewNames; // One per rendered view, see RenderSnapshot::views
+    std::vector<Image> m_viewTargets; // Resolve targets of the views after the first
+    uint32_t m_cameraUBOStride = 0; // CameraUBO rounded up to minUniformBufferOffsetAlignment, the dynamic offset of a view
+    std::optional<std::array<vkm::vec4, 9>> m_lambertianSH; // Of the scene environment, copied into every CameraUBO
+
 private:
     void createDescriptorSetLayout();
     void createDescriptorPool();
 
+    void createPipelineCache();
     void createGraphicsPipeline();
 
     void createCommandPool();
@@ -131,17 +169,30 @@ private:
 
     void createDepthResources();
 
-    void recordCommandBuffer(VkCommandBuffer& commandBuffer, uint32_t imageIndex, Scene& scene);
+    // One resolve target per view after the first, sized like the swap chain
+    void createViewTargets();
+
+    void createGpuProfiler();
+
+    // Returns either the snapshot's instances or the ones that passed the view's culling, stored in culledMeshInstances
+    const std::vector<MeshInstance>& cullMeshInstances(const RenderSnapshot& snapshot, uint32_t viewIndex, std::vector<MeshInstance>& culledMeshInstances);
+    // All views of the frame in one command buffer, viewMeshInstances holds the culled instances of each view
+    void recordCommandBuffer(VkCommandBuffer& commandBuffer, uint32_t imageIndex, const std::vector<const std::vector<MeshInstance>*>& viewMeshInstances);
+    void recordView(VkCommandBuffer& commandBuffer, Image& target, uint32_t viewIndex, const std::vector<MeshInstance>& meshInstances);
 
     void BeginRendering(VkCommandBuffer& commandBuffer, const VkRenderingInfo render_info);
 	void EndRendering(VkCommandBuffer& commandBuffer);
 
     void createUniformBuffers(Buffer& uniformBuffer);
 
-    void updateUniformBuffer(uint32_t currentImage);
+    void updateUniformBuffer(uint32_t currentImage, const RenderSnapshot& snapshot);
 
+    // Writes the global set of a frame, the environment never changes so this runs once per frame set at init
     void updateDescriptorSet(uint32_t currentFrameInFlight, Scene& scene);
 
+    void uploadSceneResources(Scene& scene);
+    uint64_t lastWaitedUploadValue = 0;
+
 public: // Helper
     struct SPushConstant {
         vkm::mat4 matWorld;
@@ -174,14 +225,26 @@ public:
     VkDevice GetDevice() const { return device; }
     VkPhysicalDevice GetPhysicalDevice() const { return physicalDevice; }
     VkInstance GetInstance() const { return instance; }
+    MemoryAllocator& GetMemoryAllocator() const { return *m_memoryAllocator; }
+    UploadManager& GetUploadManager() const { return *m_uploadManager; }
+    GeometryPool& GetGeometryPool() const { return *m_geometryPool; }
+
+private:
+    std::unique_ptr<MemoryAllocator> m_memoryAllocator;
+    std::unique_ptr<UploadManager> m_uploadManager;
+    std::unique_ptr<GeometryPool> m_geometryPool;
 
 public:
     bool IsHeadless() const { return (m_pApp && m_pApp->info.window->IsHeadless()); }
     void PresentImage();
     void SaveFrame(const std::string& savePath);
-    bool readyForNextImage = false;
+    // Headless with -limitfps, whether an AVAILABLE event left an image to render into
+    bool IsReadyForNextImage() const { return availableImageCount > 0; }
 
 private:
+    // Headless, the least recently used image, once the frame that last rendered into it completed
     uint32_t AcquireNextImageIndex();
     uint32_t nextImageIndex = 0;
+    uint32_t availableImageCount = 0; // AVAILABLE events not rendered yet, at most one per image
+    std::vector<uint64_t> imageTimelineValues; // Frame timeline value of the last frame that rendered into each headless image
 };
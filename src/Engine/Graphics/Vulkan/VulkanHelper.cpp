@@ -121,6 +121,29 @@ QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, std::optional<VkSu
     return indices;
 }
 
+// A queue family that can copy but not draw, usually backed by the DMA engines. Only families that copy images at texel granularity qualify,
+// so that textures of any size can be uploaded on it. Pure transfer families are preferred over async compute ones.
+std::optional<uint32_t> findDedicatedTransferQueueFamily(VkPhysicalDevice device)
+{
+    std::vector<VkQueueFamilyProperties> queueFamilies = getAllQueueFamilies(device);
+    std::optional<uint32_t> transferFamily;
+
+    for (uint32_t i = 0; i < queueFamilies.size(); i++) {
+        const auto& queueFamily = queueFamilies[i];
+        if (!(queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) || (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT))
+            continue;
+        const VkExtent3D& granularity = queueFamily.minImageTransferGranularity;
+        if (granularity.width != 1 || granularity.height != 1 || granularity.depth != 1)
+            continue;
+
+        if (!(queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT))
+            return i;
+        if (!transferFamily)
+            transferFamily = i;
+    }
+    return transferFamily;
+}
+
 bool isDeviceSuitable(VkPhysicalDevice device, std::optional<VkSurfaceKHR> surface)
 {
     QueueFamilyIndices indices = findQueueFamilies(device, surface);
@@ -85,6 +85,7 @@ std::vector<VkExtensionProperties> getAllAvailableDeviceExtensions(VkPhysicalDev
 std::vector<VkPhysicalDevice> getAllPhysicalDevices(VkInstance instance);
 SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface);
 QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, std::optional<VkSurfaceKHR> surface);
+std::optional<uint32_t> findDedicatedTransferQueueFamily(VkPhysicalDevice device);
 bool isDeviceSuitable(VkPhysicalDevice device, std::optional<VkSurfaceKHR> surface);
 bool checkDeviceExtensionSupport(VkPhysicalDevice device, bool isHeadless);
 std::vector<VkQueueFamilyProperties> getAllQueueFamilies(VkPhysicalDevice device);
@@ -69,21 +69,23 @@ vkm::vec3 SceneCamera::getPosition() const
 
 bool ICamera::FrustumCulling(std::shared_ptr<Mesh> pMesh, vkm::mat4& worldTransform)
 {
-    vkm::mat4 viewMatrix = getViewMatrix();
-    vkm::mat4 projMatrix = getProjectionMatrix();
+    return FrustumCulling(getProjectionMatrix() * getViewMatrix(), *pMesh, worldTransform);
+}
 
-    vkm::mat4 mvp = projMatrix * viewMatrix * worldTransform;
+bool ICamera::FrustumCulling(const vkm::mat4& viewProj, const Mesh& mesh, const vkm::mat4& worldTransform)
+{
+    vkm::mat4 mvp = viewProj * worldTransform;
 
     // Define the 8 corners of the AABB
-    std::vector<vkm::vec3> corners = {
-        { pMesh->min.x(), pMesh->min.y(), pMesh->min.z() },
-        { pMesh->max.x(), pMesh->min.y(), pMesh->min.z() },
-        { pMesh->min.x(), pMesh->max.y(), pMesh->min.z() },
-        { pMesh->max.x(), pMesh->max.y(), pMesh->min.z() },
-        { pMesh->min.x(), pMesh->min.y(), pMesh->max.z() },
-        { pMesh->max.x(), pMesh->min.y(), pMesh->max.z() },
-        { pMesh->min.x(), pMesh->max.y(), pMesh->max.z() },
-        { pMesh->max.x(), pMesh->max.y(), pMesh->max.z() }
+    const std::array<vkm::vec3, 8> corners = {
+        vkm::vec3 { mesh.min.x(), mesh.min.y(), mesh.min.z() },
+        vkm::vec3 { mesh.max.x(), mesh.min.y(), mesh.min.z() },
+        vkm::vec3 { mesh.min.x(), mesh.max.y(), mesh.min.z() },
+        vkm::vec3 { mesh.max.x(), mesh.max.y(), mesh.min.z() },
+        vkm::vec3 { mesh.min.x(), mesh.min.y(), mesh.max.z() },
+        vkm::vec3 { mesh.max.x(), mesh.min.y(), mesh.max.z() },
+        vkm::vec3 { mesh.min.x(), mesh.max.y(), mesh.max.z() },
+        vkm::vec3 { mesh.max.x(), mesh.max.y(), mesh.max.z() }
     };
 
     // Transform each corner to clip space and perform culling check
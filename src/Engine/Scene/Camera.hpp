@@ -20,6 +20,9 @@ public:
     virtual vkm::mat4 getProjectionMatrix() const = 0;
     virtual vkm::vec3 getPosition() const = 0;
     virtual bool FrustumCulling(std::shared_ptr<Mesh> pMesh, vkm::mat4& worldTransform);
+
+    // Same test against explicit matrices, usable without touching the (possibly updating) camera
+    static bool FrustumCulling(const vkm::mat4& viewProj, const Mesh& mesh, const vkm::mat4& worldTransform);
 };
 
 struct Perspective {
@@ -23,6 +23,28 @@ void CameraManager::Init(EngineCore::IApp* pApp)
         CameraManager::GetInstance().SetActiveCamera(userCamera->name);
     }
 
+    if (pApp->args.renderCameras) {
+        for (auto& name : pApp->args.renderCameras.value()) {
+            if (name == "all") {
+                // Scene cameras only, sorted so that the output order does not depend on hashing
+                std::vector<std::shared_ptr<ICamera>> sceneCameras;
+                for (auto& [cameraName, camera] : cameras) {
+                    if (camera->getType() == ECameraType::EScene)
+                        sceneCameras.push_back(camera);
+                }
+                std::sort(sceneCameras.begin(), sceneCameras.end(), [](const auto& a, const auto& b) { return a->getName() < b->getName(); });
+                renderCameras.insert(renderCameras.end(), sceneCameras.begin(), sceneCameras.end());
+            } else {
+                auto it = cameras.find(name);
+                if (it == cameras.end())
+                    throw std::runtime_error("-render-cameras: no camera named " + name);
+                renderCameras.push_back(it->second);
+            }
+        }
+        if (renderCameras.empty())
+            throw std::runtime_error("-render-cameras: the scene has no cameras to render");
+    }
+
     // Register event handlers
     // #TODO: Support allocating different keys
 
@@ -53,6 +53,12 @@ public:
         return activeCamera;
     }
 
+    // -render-cameras, every frame is rendered from each of these in order. Empty renders the active camera only.
+    const std::vector<std::shared_ptr<ICamera>>& GetRenderCameras() const
+    {
+        return renderCameras;
+    }
+
     void SwitchToNextCamera()
     {
         if (cameras.size() > 1) {
@@ -89,6 +95,7 @@ private:
 
     std::unordered_map<std::string, std::shared_ptr<ICamera>> cameras;
     std::shared_ptr<ICamera> activeCamera;
+    std::vector<std::shared_ptr<ICamera>> renderCameras;
 
 #ifndef NDEBUG
     std::shared_ptr<UserCamera> debugCamera;
@@ -1,6 +1,9 @@
 #include "Environment.hpp"
 #include "Graphics/Vulkan/Shader.hpp"
 #include "Scene/Mesh.hpp"
+#include "Threading/JobSystem.hpp"
+#include "Utilities/AssetCache.hpp"
+#include "Utilities/Trace.hpp"
 #include "Utilities/lambertian/blur_cube.h"
 #include <random>
 
@@ -9,18 +12,22 @@ Environment::Environment(std::weak_ptr<Scene> pScene, size_t index, const Utilit
 {
     name = jsonObj["name"].getString();
 
-    radiance = Texture(jsonObj["radiance"], pScene.lock()->src, VK_FORMAT_R8G8B8A8_SRGB);
+    auto pSceneLocked = pScene.lock();
+    radiance = Texture(jsonObj["radiance"], pSceneLocked->src, VK_FORMAT_R8G8B8A8_SRGB);
 
-    lambertian = GenerateLambertian2(radiance);
-	// lambertian = GenerateLambertian(radiance); // currently not producing the same result as GenerateLambertian2
+    const EnvironmentOptions& options = pSceneLocked->environmentOptions;
+    Utility::AssetCache cache(options.cacheDirectory, { options.assetDirectories.begin(), options.assetDirectories.end() });
+    generateLambertian(options.lambertianMode, cache);
+    // lambertian = GenerateLambertian(radiance); // currently not producing the same result as GenerateLambertian2
+    generatePrefilteredEnv(cache);
 
-    GetBRDFLut();
+    GetBRDFLut(cache);
 }
 
 void Environment::generateCubemaps(VulkanCore* pVulkanCore)
 {
+    // preFilteredEnv is generated on the CPU with the scene, see generatePrefilteredEnv
     irradiance = radiance;
-    preFilteredEnv = radiance;
     return;
 
     enum Target { IRRADIANCE = 0,
@@ -360,6 +367,7 @@ void Environment::generateCubemaps(VulkanCore* pVulkanCore)
 
                 auto box = Scene::defaultScene()->meshes.begin()->second->meshData;
                 box->uploadModelToGPU(pVulkanCore);
+                pVulkanCore->GetGeometryPool().Bind(cmdBuf);
                 box->draw(cmdBuf);
 				vkCmdEndRenderPass(cmdBuf);
 
@@ -413,12 +421,17 @@ void Environment::generateCubemaps(VulkanCore* pVulkanCore)
     }
 }
 
-void Environment::GetBRDFLut()
+void Environment::GetBRDFLut(const Utility::AssetCache& cache)
 {
-	auto in_file = radiance.src;
-	// outfilename = in_file's folder + brdflut.png
-	std::filesystem::path p(in_file);
-	std::string out_file = p.parent_path().string() + "/brdflut.png";
+	// The asset directories and the cache first, then next to the radiance
+	std::string out_file;
+	if (auto cachedPath = cache.Find("brdflut.png")) {
+		out_file = cachedPath->string();
+	} else {
+		// outfilename = in_file's folder + brdflut.png
+		std::filesystem::path p(radiance.src);
+		out_file = p.parent_path().string() + "/brdflut.png";
+	}
 
 	lutBrdf = Texture();
 	lutBrdf.src = out_file;
@@ -643,24 +656,537 @@ Texture GenerateLambertian(Texture radiance, int lambertian_texWidth /*= 16*/)
     return lambertian;
 }
 
+// blur_cube parameters of GenerateLambertian2, part of the cache key of its output
+constexpr int32_t kLambertianBlurSize = 16;
+constexpr int32_t kLambertianBlurSamples = 1024;
+constexpr int32_t kLambertianBlurBrightest = 10000;
+
+static void BlurLambertian(std::string in_file, const std::string& out_file)
+{
+    glm::ivec2 out_size = glm::ivec2(kLambertianBlurSize, kLambertianBlurSize * 6);
+    int32_t samples = kLambertianBlurSamples;
+    blur_cube("diffuse", out_size, samples, in_file, kLambertianBlurBrightest, out_file);
+}
+
+static Texture LoadLambertian(const std::string& path, const Texture& radiance)
+{
+    Texture lambertian = Texture();
+    lambertian.src = path;
+    lambertian.type = radiance.type;
+    lambertian.format = radiance.format;
+    lambertian.textureImageFormat = radiance.textureImageFormat;
+    lambertian.LoadTextureData();
+    return lambertian;
+}
+
 Texture GenerateLambertian2(Texture radiance)
 {
-    glm::ivec2 out_size = glm::ivec2(16, 16 * 6);
-    int32_t samples = 1024;
-    int32_t brightest = 10000;
+    TRACE_ZONE("GenerateLambertian2");
     std::string in_file = radiance.src;
 
     // outfilename = in_file's filename + "_lambertian" + in_file's extension
     std::string out_file = in_file.substr(0, in_file.find_last_of('.')) + "_lambertian" + in_file.substr(in_file.find_last_of('.'));
 
-    blur_cube("diffuse", out_size, samples, in_file, brightest, out_file);
+    BlurLambertian(in_file, out_file);
+    return LoadLambertian(out_file, radiance);
+}
 
+// See OpenGL 4.4 Core Profile specification, Table 8.18, the same convention the cube map textures are sampled with
+static void GetCubeMapFaceAxes(CubeMapFace face, vkm::vec3& sc, vkm::vec3& tc, vkm::vec3& ma)
+{
+    switch (face) {
+    case CubeMapFace::PositiveX:
+        sc = vkm::vec3(0.0f, 0.0f, -1.0f);
+        tc = vkm::vec3(0.0f, -1.0f, 0.0f);
+        ma = vkm::vec3(1.0f, 0.0f, 0.0f);
+        break;
+    case CubeMapFace::NegativeX:
+        sc = vkm::vec3(0.0f, 0.0f, 1.0f);
+        tc = vkm::vec3(0.0f, -1.0f, 0.0f);
+        ma = vkm::vec3(-1.0f, 0.0f, 0.0f);
+        break;
+    case CubeMapFace::PositiveY:
+        sc = vkm::vec3(1.0f, 0.0f, 0.0f);
+        tc = vkm::vec3(0.0f, 0.0f, 1.0f);
+        ma = vkm::vec3(0.0f, 1.0f, 0.0f);
+        break;
+    case CubeMapFace::NegativeY:
+        sc = vkm::vec3(1.0f, 0.0f, 0.0f);
+        tc = vkm::vec3(0.0f, 0.0f, -1.0f);
+        ma = vkm::vec3(0.0f, -1.0f, 0.0f);
+        break;
+    case CubeMapFace::PositiveZ:
+        sc = vkm::vec3(1.0f, 0.0f, 0.0f);
+        tc = vkm::vec3(0.0f, -1.0f, 0.0f);
+        ma = vkm::vec3(0.0f, 0.0f, 1.0f);
+        break;
+    case CubeMapFace::NegativeZ:
+        sc = vkm::vec3(-1.0f, 0.0f, 0.0f);
+        tc = vkm::vec3(0.0f, -1.0f, 0.0f);
+        ma = vkm::vec3(0.0f, 0.0f, -1.0f);
+        break;
+    }
+}
+
+// Real spherical harmonics up to band 2, n normalized
+static std::array<float, 9> EvaluateSHBasis(const vkm::vec3& n)
+{
+    float x = n.x(), y = n.y(), z = n.z();
+    return {
+        0.282095f,
+        0.488603f * y,
+        0.488603f * z,
+        0.488603f * x,
+        1.092548f * x * y,
+        1.092548f * y * z,
+        0.315392f * (3.0f * z * z - 1.0f),
+        1.092548f * x * z,
+        0.546274f * (x * x - y * y),
+    };
+}
+
+vkm::vec3 LambertianSH::Evaluate(const vkm::vec3& n) const
+{
+    std::array<float, 9> basis = EvaluateSHBasis(n);
+    vkm::vec3 result = vkm::vec3(0.0f);
+    for (size_t i = 0; i < coefficients.size(); i++)
+        result += coefficients[i] * basis[i];
+    // Ringing of very bright, small light sources can take the truncated series below zero
+    return vkm::vec3(std::max(result.r(), 0.0f), std::max(result.g(), 0.0f), std::max(result.b(), 0.0f));
+}
+
+LambertianSH ProjectLambertianSH(const Texture& radiance)
+{
+    TRACE_ZONE("ProjectLambertianSH");
+    const int size = radiance.texWidth;
+    const uint32_t rows = 6 * size;
+    const stbi_uc* pData = radiance.textureData.get();
+
+    // Every row of texels is summed on its own and the rows in order, the result does not depend on the thread count
+    std::vector<std::array<vkm::vec3, 9>> rowSums(rows);
+    std::vector<float> rowWeights(rows, 0.0f);
+    EngineCore::JobSystem::GetInstance().ParallelFor("ProjectLambertianSH", rows, 8, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t row = begin; row < end; row++) {
+            vkm::vec3 sc, tc, ma;
+            GetCubeMapFaceAxes(static_cast<CubeMapFace>(row / size), sc, tc, ma);
+            float v = 2.0f * (row % size + 0.5f) / size - 1.0f;
+
+            std::array<vkm::vec3, 9> sums;
+            float weights = 0.0f;
+            for (int s = 0; s < size; s++) {
+                float u = 2.0f * (s + 0.5f) / size - 1.0f;
+                // Solid angle of the texel, up to the constant texel area: dA / (1 + u^2 + v^2)^(3/2)
+                float lengthSquared = 1.0f + u * u + v * v;
+                float weight = 1.0f / (lengthSquared * std::sqrt(lengthSquared));
+                vkm::vec3 dir = ma + u * sc + v * tc;
+                dir = dir * (1.0f / std::sqrt(lengthSquared));
+
+                const stbi_uc* pTexel = pData + 4 * (size_t(row) * size + s);
+                vkm::vec3 light = rgbe_to_float(vkm::u8vec4(pTexel[0], pTexel[1], pTexel[2], pTexel[3])) * weight;
+                std::array<float, 9> basis = EvaluateSHBasis(dir);
+                for (size_t i = 0; i < basis.size(); i++)
+                    sums[i] += light * basis[i];
+                weights += weight;
+            }
+            rowSums[row] = sums;
+            rowWeights[row] = weights;
+        }
+    });
+
+    LambertianSH sh;
+    float totalWeight = 0.0f;
+    for (uint32_t row = 0; row < rows; row++) {
+        for (size_t i = 0; i < sh.coefficients.size(); i++)
+            sh.coefficients[i] += rowSums[row][i];
+        totalWeight += rowWeights[row];
+    }
+
+    // The weights sum to 4 pi, which also takes out the texel area. Convolving with the clamped cosine scales the bands by
+    // pi, 2 pi / 3 and pi / 4, the division by pi turns irradiance into the radiance of a white surface.
+    constexpr std::array<float, 9> BandScales = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+    float normalization = 4.0f * float(M_PI) / totalWeight;
+    for (size_t i = 0; i < sh.coefficients.size(); i++)
+        sh.coefficients[i] *= normalization * BandScales[i];
+    return sh;
+}
+
+// Same layout as the cube map GenerateLambertian2 loads, for the shaders that still sample LAMBERTIAN
+Texture GenerateLambertianFromSH(const LambertianSH& sh, const Texture& radiance, int lambertian_texWidth /*= 16*/)
+{
+    TRACE_ZONE("GenerateLambertianFromSH");
     Texture lambertian = Texture();
-    lambertian.src = out_file;
     lambertian.type = radiance.type;
     lambertian.format = radiance.format;
     lambertian.textureImageFormat = radiance.textureImageFormat;
-    lambertian.LoadTextureData();
 
-    return std::move(lambertian);
+    lambertian.texWidth = lambertian_texWidth;
+    lambertian.texHeight = lambertian_texWidth;
+    lambertian.texChannels = 4;
+    lambertian.mipLevels = 1;
+
+    stbi_uc* rawData = new stbi_uc[4 * lambertian_texWidth * lambertian_texWidth * 6];
+    lambertian.textureData = std::shared_ptr<stbi_uc>(rawData, [](stbi_uc* p) { delete[] p; });
+
+    for (int face = 0; face < 6; face++) {
+        vkm::vec3 sc, tc, ma;
+        GetCubeMapFaceAxes(static_cast<CubeMapFace>(face), sc, tc, ma);
+        for (int t = 0; t < lambertian_texWidth; t++) {
+            for (int s = 0; s < lambertian_texWidth; s++) {
+                vkm::vec3 N = (ma
+                    + (2.0f * (s + 0.5f) / lambertian_texWidth - 1.0f) * sc
+                    + (2.0f * (t + 0.5f) / lambertian_texWidth - 1.0f) * tc);
+                N = vkm::normalize(N);
+
+                vkm::u8vec4 rgbe = float_to_rgbe(sh.Evaluate(N));
+                int index = 4 * ((face * lambertian_texWidth + t) * lambertian_texWidth + s);
+                for (int c = 0; c < 4; c++)
+                    rawData[index + c] = rgbe[c];
+            }
+        }
+    }
+    return lambertian;
+}
+
+// Inverse of GetCubeMapFaceAxes: the face dir points at and the position on it, both coordinates in [0, 1]
+static CubeMapFace GetCubeMapFaceCoords(const vkm::vec3& dir, float& s, float& t)
+{
+    float ax = std::abs(dir.x()), ay = std::abs(dir.y()), az = std::abs(dir.z());
+    CubeMapFace face;
+    if (ax >= ay && ax >= az)
+        face = dir.x() >= 0.0f ? CubeMapFace::PositiveX : CubeMapFace::NegativeX;
+    else if (ay >= az)
+        face = dir.y() >= 0.0f ? CubeMapFace::PositiveY : CubeMapFace::NegativeY;
+    else
+        face = dir.z() >= 0.0f ? CubeMapFace::PositiveZ : CubeMapFace::NegativeZ;
+
+    vkm::vec3 sc, tc, ma;
+    GetCubeMapFaceAxes(face, sc, tc, ma);
+    float invMa = 1.0f / vkm::dot(dir, ma);
+    s = 0.5f * (vkm::dot(dir, sc) * invMa + 1.0f);
+    t = 0.5f * (vkm::dot(dir, tc) * invMa + 1.0f);
+    return face;
+}
+
+// Linear radiance of a cube map with its box filtered mip chain, sampled trilinearly. Faces are filtered on their own, clamped at the edges.
+class LinearCubeMap {
+public:
+    explicit LinearCubeMap(const Texture& cubeMap)
+    {
+        int size = cubeMap.texWidth;
+        std::vector<vkm::vec3> level(size_t(6) * size * size);
+        for (size_t i = 0; i < level.size(); i++) {
+            const stbi_uc* pTexel = cubeMap.textureData.get() + 4 * i;
+            level[i] = rgbe_to_float(vkm::u8vec4(pTexel[0], pTexel[1], pTexel[2], pTexel[3]));
+        }
+        m_sizes.push_back(size);
+        m_levels.push_back(std::move(level));
+
+        while (size > 1) {
+            int parentSize = size;
+            const std::vector<vkm::vec3>& parent = m_levels.back();
+            size = std::max(size / 2, 1);
+            level.assign(size_t(6) * size * size, vkm::vec3(0.0f));
+            for (int face = 0; face < 6; face++) {
+                for (int t = 0; t < size; t++) {
+                    for (int s = 0; s < size; s++) {
+                        vkm::vec3 sum = vkm::vec3(0.0f);
+                        for (int i = 0; i < 4; i++) {
+                            int ps = std::min(2 * s + (i & 1), parentSize - 1);
+                            int pt = std::min(2 * t + (i >> 1), parentSize - 1);
+                            sum += parent[(size_t(face) * parentSize + pt) * parentSize + ps];
+                        }
+                        level[(size_t(face) * size + t) * size + s] = sum * 0.25f;
+                    }
+                }
+            }
+            m_sizes.push_back(size);
+            m_levels.push_back(std::move(level));
+        }
+    }
+
+    int GetSize() const { return m_sizes[0]; }
+    int GetLevelCount() const { return int(m_levels.size()); }
+
+    vkm::vec3 Sample(const vkm::vec3& dir, float lod) const
+    {
+        float s, t;
+        CubeMapFace face = GetCubeMapFaceCoords(dir, s, t);
+        lod = std::clamp(lod, 0.0f, float(GetLevelCount() - 1));
+        int level = std::min(int(lod), GetLevelCount() - 2);
+        if (level < 0)
+            return SampleLevel(0, face, s, t);
+        float fraction = lod - level;
+        vkm::vec3 result = SampleLevel(level, face, s, t) * (1.0f - fraction);
+        result += SampleLevel(level + 1, face, s, t) * fraction;
+        return result;
+    }
+
+private:
+    vkm::vec3 SampleLevel(int level, CubeMapFace face, float s, float t) const
+    {
+        int size = m_sizes[level];
+        const vkm::vec3* pFace = m_levels[level].data() + size_t(face) * size * size;
+        float x = s * size - 0.5f, y = t * size - 0.5f;
+        int x0 = int(std::floor(x)), y0 = int(std::floor(y));
+        float fx = x - x0, fy = y - y0;
+        int x1 = std::clamp(x0 + 1, 0, size - 1), y1 = std::clamp(y0 + 1, 0, size - 1);
+        x0 = std::clamp(x0, 0, size - 1);
+        y0 = std::clamp(y0, 0, size - 1);
+
+        vkm::vec3 result = pFace[y0 * size + x0] * ((1.0f - fx) * (1.0f - fy));
+        result += pFace[y0 * size + x1] * (fx * (1.0f - fy));
+        result += pFace[y1 * size + x0] * ((1.0f - fx) * fy);
+        result += pFace[y1 * size + x1] * (fx * fy);
+        return result;
+    }
+
+    std::vector<int> m_sizes;
+    std::vector<std::vector<vkm::vec3>> m_levels;
+};
+
+// Bytes of the RGBE texels of all mip levels of a cube map
+static size_t GetMipChainSize(const Texture& cubeMap)
+{
+    size_t size = 0;
+    for (int level = 0; level < cubeMap.mipLevels; level++)
+        size += size_t(4) * 6 * std::max(cubeMap.texWidth >> level, 1) * std::max(cubeMap.texWidth >> level, 1);
+    return size;
+}
+
+static vkm::vec2 Hammersley(uint32_t i, uint32_t count)
+{
+    uint32_t bits = (i << 16u) | (i >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    return vkm::vec2(float(i) / float(count), float(bits) * 2.3283064365386963e-10f);
+}
+
+// Parameters of preFilteredEnv, part of the cache key
+constexpr int kPrefilteredSize = 128;
+constexpr int kPrefilteredMipLevels = 6;
+constexpr uint32_t kPrefilteredSamples = 64;
+
+// Cube map with room for the whole mip chain, of at most the size of the radiance
+static Texture CreatePrefilteredTexture(const Texture& radiance, int texWidth, int mipLevels)
+{
+    texWidth = std::min(texWidth, radiance.texWidth);
+    mipLevels = std::clamp(mipLevels, 1, static_cast<int>(std::floor(std::log2(texWidth))) + 1);
+
+    Texture preFiltered = Texture();
+    preFiltered.type = radiance.type;
+    preFiltered.format = radiance.format;
+    preFiltered.textureImageFormat = radiance.textureImageFormat;
+    preFiltered.texWidth = texWidth;
+    preFiltered.texHeight = texWidth;
+    preFiltered.texChannels = 4;
+    preFiltered.mipLevels = mipLevels;
+    preFiltered.hasMipChain = true;
+
+    stbi_uc* rawData = new stbi_uc[GetMipChainSize(preFiltered)];
+    preFiltered.textureData = std::shared_ptr<stbi_uc>(rawData, [](stbi_uc* p) { delete[] p; });
+    return preFiltered;
+}
+
+// CPU version of prefilterenvmap.frag: GGX importance sampling with N = V = R, see "Real Shading in Unreal Engine 4", and the source
+// mip of every sample picked from its pdf, see GPU Gems 3, chapter 20 "GPU-Based Importance Sampling". Mip i of the result is filtered
+// with perceptual roughness i / (mipLevels - 1), the mapping s72_shading.glsl samples it with.
+Texture GeneratePrefilteredGGX(const Texture& radiance, int texWidth /*= 128*/, int mipLevels /*= 6*/, uint32_t samples /*= 64*/)
+{
+    TRACE_ZONE("GeneratePrefilteredGGX");
+    LinearCubeMap source(radiance);
+    Texture preFiltered = CreatePrefilteredTexture(radiance, texWidth, mipLevels);
+    texWidth = preFiltered.texWidth;
+    mipLevels = preFiltered.mipLevels;
+
+    // Solid angle of a source texel, at the center of a face
+    const float texelSolidAngle = 4.0f * float(M_PI) / (6.0f * source.GetSize() * source.GetSize());
+
+    struct Sample {
+        vkm::vec3 L; // Tangent space, N = (0, 0, 1)
+        float weight; // N dot L
+        float lod;
+    };
+    std::vector<Sample> levelSamples;
+
+    stbi_uc* pLevel = preFiltered.textureData.get();
+    for (int level = 0; level < mipLevels; level++) {
+        const int size = texWidth >> level;
+        const float roughness = mipLevels > 1 ? float(level) / float(mipLevels - 1) : 0.0f;
+
+        if (level == 0 && size == source.GetSize()) {
+            // Perfect mirror at the size of the radiance
+            std::copy_n(radiance.textureData.get(), size_t(4) * 6 * size * size, pLevel);
+            pLevel += size_t(4) * 6 * size * size;
+            continue;
+        }
+
+        // With N = V every texel uses the same samples, only rotated
+        levelSamples.clear();
+        if (level == 0) {
+            // Perfect mirror, resampled to the output size
+            levelSamples.push_back({ vkm::vec3(0.0f, 0.0f, 1.0f), 1.0f, std::log2(float(source.GetSize()) / size) });
+        } else {
+            float alpha = roughness * roughness;
+            float alpha2 = alpha * alpha;
+            for (uint32_t i = 0; i < samples; i++) {
+                vkm::vec2 xi = Hammersley(i, samples);
+                float phi = 2.0f * float(M_PI) * xi.x();
+                float cosTheta = std::sqrt((1.0f - xi.y()) / (1.0f + (alpha2 - 1.0f) * xi.y()));
+                float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+                vkm::vec3 H = vkm::vec3(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+                vkm::vec3 L = vkm::vec3(2.0f * cosTheta * H.x(), 2.0f * cosTheta * H.y(), 2.0f * cosTheta * cosTheta - 1.0f);
+                if (L.z() <= 0.0f)
+                    continue;
+
+                // pdf of L is D(H) (N dot H) / (4 V dot H) = D(H) / 4
+                float denominator = cosTheta * cosTheta * (alpha2 - 1.0f) + 1.0f;
+                float pdf = alpha2 / (float(M_PI) * denominator * denominator) / 4.0f;
+                float sampleSolidAngle = 1.0f / (float(samples) * pdf + 0.0001f);
+                // Unlike prefilterenvmap.frag not biased by one more level, which visibly dims small bright lights
+                float lod = std::max(0.5f * std::log2(sampleSolidAngle / texelSolidAngle), 0.0f);
+                levelSamples.push_back({ L, L.z(), lod });
+            }
+        }
+
+        EngineCore::JobSystem::GetInstance().ParallelFor("GeneratePrefilteredGGX", 6 * size, 4, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t row = begin; row < end; row++) {
+                vkm::vec3 sc, tc, ma;
+                GetCubeMapFaceAxes(static_cast<CubeMapFace>(row / size), sc, tc, ma);
+                float v = 2.0f * (row % size + 0.5f) / size - 1.0f;
+                for (int s = 0; s < size; s++) {
+                    float u = 2.0f * (s + 0.5f) / size - 1.0f;
+                    vkm::vec3 N = ma + u * sc + v * tc;
+                    N = vkm::normalize(N);
+                    vkm::vec3 up = std::abs(N.z()) < 0.999f ? vkm::vec3(0.0f, 0.0f, 1.0f) : vkm::vec3(1.0f, 0.0f, 0.0f);
+                    vkm::vec3 TX = vkm::normalize(vkm::cross(up, N));
+                    vkm::vec3 TY = vkm::cross(N, TX);
+
+                    vkm::vec3 color = vkm::vec3(0.0f);
+                    float totalWeight = 0.0f;
+                    for (const Sample& sample : levelSamples) {
+                        vkm::vec3 L = sample.L.x() * TX + sample.L.y() * TY + sample.L.z() * N;
+                        color += source.Sample(L, sample.lod) * sample.weight;
+                        totalWeight += sample.weight;
+                    }
+                    color *= 1.0f / totalWeight;
+
+                    vkm::u8vec4 rgbe = float_to_rgbe(color);
+                    stbi_uc* pTexel = pLevel + 4 * (size_t(row) * size + s);
+                    for (int c = 0; c < 4; c++)
+                        pTexel[c] = rgbe[c];
+                }
+            }
+        });
+        pLevel += size_t(4) * 6 * size * size;
+    }
+    return preFiltered;
+}
+
+// Cache key of everything generated from the radiance: its size and pixels
+static uint64_t HashRadiance(const Texture& radiance)
+{
+    uint64_t hash = Utility::AssetCache::Hash(&radiance.texWidth, sizeof(radiance.texWidth));
+    return Utility::AssetCache::Hash(radiance.textureData.get(), size_t(4) * radiance.texWidth * radiance.texWidth * 6, hash);
+}
+
+static std::optional<LambertianSH> ReadLambertianSH(const std::filesystem::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::array<float, 27> values;
+    if (!file.read(reinterpret_cast<char*>(values.data()), sizeof(values)))
+        return std::nullopt;
+
+    LambertianSH sh;
+    for (size_t i = 0; i < sh.coefficients.size(); i++)
+        sh.coefficients[i] = vkm::vec3(values[3 * i], values[3 * i + 1], values[3 * i + 2]);
+    return sh;
+}
+
+static void WriteLambertianSH(const std::filesystem::path& path, const LambertianSH& sh)
+{
+    std::array<float, 27> values;
+    for (size_t i = 0; i < sh.coefficients.size(); i++) {
+        for (size_t c = 0; c < 3; c++)
+            values[3 * i + c] = sh.coefficients[i][c];
+    }
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.write(reinterpret_cast<const char*>(values.data()), sizeof(values)))
+        throw std::runtime_error("failed to write " + path.string());
+}
+
+void Environment::generateLambertian(ELambertianMode mode, const Utility::AssetCache& cache)
+{
+    // Generator and its parameters on top of the radiance, a change of either misses the cache
+    std::string generator = mode == ELambertianMode::SPHERICAL_HARMONICS
+        ? "sh9 v1"
+        : "blur_cube diffuse " + std::to_string(kLambertianBlurSize) + " " + std::to_string(kLambertianBlurSamples) + " " + std::to_string(kLambertianBlurBrightest) + " v3";
+    uint64_t hash = Utility::AssetCache::Hash(generator.data(), generator.size(), HashRadiance(radiance));
+
+    if (mode == ELambertianMode::SPHERICAL_HARMONICS) {
+        std::string cacheName = Utility::AssetCache::MakeName("lambertian_sh", hash, ".bin");
+        if (auto cachedPath = cache.Find(cacheName))
+            lambertianSH = ReadLambertianSH(*cachedPath);
+        if (!lambertianSH) {
+            lambertianSH = ProjectLambertianSH(radiance);
+            cache.Store(cacheName, [this](const std::filesystem::path& path) { WriteLambertianSH(path, *lambertianSH); });
+        }
+        lambertian = GenerateLambertianFromSH(*lambertianSH, radiance);
+        return;
+    }
+
+    std::string cacheName = Utility::AssetCache::MakeName("lambertian", hash, ".png");
+    if (auto cachedPath = cache.Find(cacheName)) {
+        lambertian = LoadLambertian(cachedPath->string(), radiance);
+        return;
+    }
+    if (!cache.IsStoringEnabled()) {
+        // Cache turned off, the blur is written next to the radiance as before
+        lambertian = GenerateLambertian2(radiance);
+        return;
+    }
+
+    // Loaded while the file is in place, so a failed store keeps the result and the blur runs once
+    std::optional<Texture> generated;
+    auto blur = [this, &generated](const std::filesystem::path& path) {
+        TRACE_ZONE("GenerateLambertian2");
+        BlurLambertian(radiance.src, path.string());
+        generated = LoadLambertian(path.string(), radiance);
+    };
+    if (auto storedPath = cache.Store(cacheName, blur)) {
+        generated->src = storedPath->string();
+    } else if (!generated) {
+        // The cache directory is unusable, go through a file of this process only
+        std::error_code error;
+        std::filesystem::path tempPath = Utility::AssetCache::MakeTemporaryPath(std::filesystem::temp_directory_path(error), cacheName);
+        blur(tempPath);
+        std::filesystem::remove(tempPath, error);
+    }
+    lambertian = std::move(*generated);
+}
+
+void Environment::generatePrefilteredEnv(const Utility::AssetCache& cache)
+{
+    std::string generator = "ggx " + std::to_string(kPrefilteredSize) + " " + std::to_string(kPrefilteredMipLevels) + " " + std::to_string(kPrefilteredSamples) + " v1";
+    uint64_t hash = Utility::AssetCache::Hash(generator.data(), generator.size(), HashRadiance(radiance));
+    std::string cacheName = Utility::AssetCache::MakeName("prefiltered_ggx", hash, ".bin");
+
+    if (auto cachedPath = cache.Find(cacheName)) {
+        preFilteredEnv = CreatePrefilteredTexture(radiance, kPrefilteredSize, kPrefilteredMipLevels);
+        size_t size = GetMipChainSize(preFilteredEnv);
+        std::ifstream file(*cachedPath, std::ios::binary | std::ios::ate);
+        if (file && size_t(file.tellg()) == size) {
+            file.seekg(0);
+            if (file.read(reinterpret_cast<char*>(preFilteredEnv.textureData.get()), size))
+                return;
+        }
+    }
+
+    preFilteredEnv = GeneratePrefilteredGGX(radiance, kPrefilteredSize, kPrefilteredMipLevels, kPrefilteredSamples);
+    cache.Store(cacheName, [this](const std::filesystem::path& path) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file.write(reinterpret_cast<const char*>(preFilteredEnv.textureData.get()), GetMipChainSize(preFilteredEnv)))
+            throw std::runtime_error("failed to write " + path.string());
+    });
 }
@@ -4,11 +4,24 @@
 #include "Texture.hpp"
 #include "pch.hpp"
 
+namespace Utility {
+class AssetCache;
+}
+
+// Irradiance / pi of an environment, the radiance leaving a white Lambertian surface, as L2 spherical harmonics:
+// E(n) / pi = sum_i coefficients[i] * Y_i(n). See Ramamoorthi and Hanrahan, "An Efficient Representation for Irradiance Environment Maps".
+struct LambertianSH {
+    std::array<vkm::vec3, 9> coefficients;
+
+    vkm::vec3 Evaluate(const vkm::vec3& n) const;
+};
+
 class Environment : public SceneObj {
 public:
     std::string name;
     Texture radiance;
     Texture lambertian;
+    std::optional<LambertianSH> lambertianSH; // Only with ELambertianMode::SPHERICAL_HARMONICS, lambertian is then rebuilt from it
 
     Environment(std::weak_ptr<Scene> pScene, size_t index, const Utility::json::JsonValue& jsonObj);
 
@@ -16,8 +29,17 @@ public:
     Texture irradiance;
 	Texture preFilteredEnv;
 	Texture lutBrdf;
-	void GetBRDFLut();
+	void GetBRDFLut(const Utility::AssetCache& cache);
 
+private:
+    // lambertian and lambertianSH, from the cache when it has them
+    void generateLambertian(ELambertianMode mode, const Utility::AssetCache& cache);
+    // preFilteredEnv, from the cache when it has it
+    void generatePrefilteredEnv(const Utility::AssetCache& cache);
 };
 Texture GenerateLambertian(Texture radiance, int lambertian_texWidth = 16);
 Texture GenerateLambertian2(Texture radiance);
+LambertianSH ProjectLambertianSH(const Texture& radiance);
+Texture GenerateLambertianFromSH(const LambertianSH& sh, const Texture& radiance, int lambertian_texWidth = 16);
+// GGX prefiltered radiance, mip i filtered for perceptual roughness i / (mipLevels - 1). Sizes are clamped to the radiance.
+Texture GeneratePrefilteredGGX(const Texture& radiance, int texWidth = 128, int mipLevels = 6, uint32_t samples = 64);
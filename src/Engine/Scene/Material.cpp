@@ -69,132 +69,38 @@ Material::Material(std::weak_ptr<Scene> pScene, size_t index, const Utility::jso
     }
 }
 
+std::array<Texture*, MAX_DESCRIPTORS_IN_MATERIAL> Material::GetTextures()
+{
+    if (pbr)
+        return { &pbr->albedoMap, &pbr->roughnessMap, &pbr->metalnessMap, &normalMap };
+    if (lambertian)
+        return { &lambertian->albedoMap, g_emptyTexture.get(), g_emptyTexture.get(), &normalMap };
+    return { g_emptyTexture.get(), g_emptyTexture.get(), g_emptyTexture.get(), &normalMap };
+}
+
 void Material::InitDescriptorSet(VulkanCore* pVulkanCore)
 {
     if (descriptorSet != VK_NULL_HANDLE)
         return;
     createDescriptorSet(pVulkanCore->GetDevice(), pVulkanCore->descriptorSetLayouts[1], pVulkanCore->descriptorPool, descriptorSet);
 
-    if (pbr) {
-        pbr->albedoMap.uploadTextureToGPU(pVulkanCore);
-        VkDescriptorImageInfo imageInfo = pbr->albedoMap.textureImage.GetDescriptorImageInfo();
-        VkWriteDescriptorSet descriptorWrite {
-            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .dstSet = descriptorSet,
-            .dstBinding = 0,
-            .dstArrayElement = 0,
-            .descriptorCount = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .pImageInfo = &imageInfo,
-        };
-        vkUpdateDescriptorSets(pVulkanCore->GetDevice(), 1, &descriptorWrite, 0, nullptr);
-
-        pbr->roughnessMap.uploadTextureToGPU(pVulkanCore);
-        imageInfo = pbr->roughnessMap.textureImage.GetDescriptorImageInfo();
-        descriptorWrite = {
-            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .dstSet = descriptorSet,
-            .dstBinding = 1,
-            .dstArrayElement = 0,
-            .descriptorCount = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .pImageInfo = &imageInfo,
-        };
-        vkUpdateDescriptorSets(pVulkanCore->GetDevice(), 1, &descriptorWrite, 0, nullptr);
-
-        pbr->metalnessMap.uploadTextureToGPU(pVulkanCore);
-        imageInfo = pbr->metalnessMap.textureImage.GetDescriptorImageInfo();
-        descriptorWrite = {
-            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .dstSet = descriptorSet,
-            .dstBinding = 2,
-            .dstArrayElement = 0,
-            .descriptorCount = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .pImageInfo = &imageInfo,
-        };
-        vkUpdateDescriptorSets(pVulkanCore->GetDevice(), 1, &descriptorWrite, 0, nullptr);
-
-    } else if (lambertian) {
-        lambertian->albedoMap.uploadTextureToGPU(pVulkanCore);
-        VkDescriptorImageInfo imageInfo = lambertian->albedoMap.textureImage.GetDescriptorImageInfo();
-        VkWriteDescriptorSet descriptorWrite {
-            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .dstSet = descriptorSet,
-            .dstBinding = 0,
-            .dstArrayElement = 0,
-            .descriptorCount = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .pImageInfo = &imageInfo,
-        };
-        vkUpdateDescriptorSets(pVulkanCore->GetDevice(), 1, &descriptorWrite, 0, nullptr);
-
-        imageInfo = g_emptyTexture->textureImage.GetDescriptorImageInfo();
-        descriptorWrite = {
-            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .dstSet = descriptorSet,
-            .dstBinding = 1,
-            .dstArrayElement = 0,
-            .descriptorCount = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .pImageInfo = &imageInfo,
-        };
-        vkUpdateDescriptorSets(pVulkanCore->GetDevice(), 1, &descriptorWrite, 0, nullptr);
-        descriptorWrite = {
-            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .dstSet = descriptorSet,
-            .dstBinding = 2,
-            .dstArrayElement = 0,
-            .descriptorCount = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .pImageInfo = &imageInfo,
-        };
-        vkUpdateDescriptorSets(pVulkanCore->GetDevice(), 1, &descriptorWrite, 0, nullptr);
-    } else {
-        VkDescriptorImageInfo imageInfo = g_emptyTexture->textureImage.GetDescriptorImageInfo();
-        VkWriteDescriptorSet descriptorWrite = {
-            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .dstSet = descriptorSet,
-            .dstBinding = 0,
-            .dstArrayElement = 0,
-            .descriptorCount = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .pImageInfo = &imageInfo,
-        };
-        vkUpdateDescriptorSets(pVulkanCore->GetDevice(), 1, &descriptorWrite, 0, nullptr);
-        descriptorWrite = {
-            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .dstSet = descriptorSet,
-            .dstBinding = 1,
-            .dstArrayElement = 0,
-            .descriptorCount = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .pImageInfo = &imageInfo,
-        };
-        vkUpdateDescriptorSets(pVulkanCore->GetDevice(), 1, &descriptorWrite, 0, nullptr);
-        descriptorWrite = {
+    auto textures = GetTextures();
+    std::array<VkDescriptorImageInfo, MAX_DESCRIPTORS_IN_MATERIAL> imageInfos;
+    std::array<VkWriteDescriptorSet, MAX_DESCRIPTORS_IN_MATERIAL> descriptorWrites;
+    for (uint32_t binding = 0; binding < textures.size(); binding++) {
+        textures[binding]->uploadTextureToGPU(pVulkanCore);
+        imageInfos[binding] = textures[binding]->textureImage.GetDescriptorImageInfo();
+        descriptorWrites[binding] = VkWriteDescriptorSet {
             .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
             .dstSet = descriptorSet,
-            .dstBinding = 2,
+            .dstBinding = binding,
             .dstArrayElement = 0,
             .descriptorCount = 1,
             .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .pImageInfo = &imageInfo,
+            .pImageInfo = &imageInfos[binding],
         };
-        vkUpdateDescriptorSets(pVulkanCore->GetDevice(), 1, &descriptorWrite, 0, nullptr);
     }
-    normalMap.uploadTextureToGPU(pVulkanCore);
-    VkDescriptorImageInfo imageInfo = normalMap.textureImage.GetDescriptorImageInfo();
-    VkWriteDescriptorSet descriptorWrite {
-        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-        .dstSet = descriptorSet,
-        .dstBinding = 3,
-        .dstArrayElement = 0,
-        .descriptorCount = 1,
-        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-        .pImageInfo = &imageInfo,
-    };
-    vkUpdateDescriptorSets(pVulkanCore->GetDevice(), 1, &descriptorWrite, 0, nullptr);
+    vkUpdateDescriptorSets(pVulkanCore->GetDevice(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 }
 
 std::shared_ptr<Material> g_SimpleMaterial = std::make_shared<Material>();
\ No newline at end of file
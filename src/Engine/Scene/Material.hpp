@@ -33,8 +33,13 @@ public:
     std::optional<Lambertian> lambertian;
 
 public:
+    // Albedo, roughness, metalness and normal map as the shader sees them, missing maps fall back to g_emptyTexture
+    std::array<Texture*, MAX_DESCRIPTORS_IN_MATERIAL> GetTextures();
+
     VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
     void InitDescriptorSet(VulkanCore* pVulkanCore);
+
+    uint32_t bindlessIndex = UINT32_MAX; // Entry in BindlessMaterials, used as firstInstance
 };
 
 extern std::shared_ptr<Material> g_SimpleMaterial;
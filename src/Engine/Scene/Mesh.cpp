@@ -1,5 +1,6 @@
 #include "Mesh.hpp"
 #include "Material.hpp"
+#include "Utilities/Trace.hpp"
 
 Mesh::Mesh(std::weak_ptr<Scene> pScene, size_t index, const Utility::json::JsonValue& jsonObj)
     : SceneObj(pScene, index, ESceneObjType::MESH)
@@ -26,6 +27,7 @@ Mesh::Mesh(std::weak_ptr<Scene> pScene, size_t index, const Utility::json::JsonV
 
 void Mesh::LoadMeshData()
 {
+    TRACE_ZONE("Mesh::LoadMeshData");
     meshData = std::make_shared<MeshData<NewVertex, uint32_t>>();
 
     // Load indices
@@ -16,58 +16,27 @@ public:
 public:
     bool uploadModelToGPU(VulkanCore* vulkanCore);
     bool releaseModelFromGPU();
+    bool IsOnGPU() const { return isOnGPU; }
 
-    Buffer vertexBuffer;
-    std::optional<Buffer> indexBuffer;
-    // #TODO: buffer's lifecycle is limited by vulkanCore.
-private:
-    void createVertexBuffer();
-    void createIndexBuffer();
+    // Geometry lives in the VulkanCore's shared geometry pool
+    GeometryPool::Handle m_geometryHandle = GeometryPool::kInvalidHandle;
 
 private:
     bool isOnGPU = false;
     VulkanCore* m_pVulkanCore = nullptr;
 
 public:
-    void draw(VkCommandBuffer commandBuffer);
+    void draw(VkCommandBuffer commandBuffer, uint32_t firstInstance = 0);
 };
 
 template <typename VertexType, typename IndexType /*= uint32_t*/>
-void MeshData<VertexType, IndexType>::draw(VkCommandBuffer commandBuffer)
+void MeshData<VertexType, IndexType>::draw(VkCommandBuffer commandBuffer, uint32_t firstInstance /*= 0*/)
 {
     if (!isOnGPU)
         throw std::runtime_error("MeshData is not on GPU. Call uploadModelToGPU() before drawing.");
 
-    VkDeviceSize offsets[] = { 0 };
-    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, offsets);
-
-    if (indexBuffer.has_value()) {
-        vkCmdBindIndexBuffer(commandBuffer, indexBuffer.value().buffer, 0, sizeof(IndexType) == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32);
-        vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indices.value().size()), 1, 0, 0, 0);
-    } else {
-        vkCmdDraw(commandBuffer, static_cast<uint32_t>(vertices.size()), 1, 0, 0);
-    }
-}
-
-template <typename VertexType, typename IndexType /*= uint32_t*/>
-void MeshData<VertexType, IndexType>::createIndexBuffer()
-{
-    if (!indices.has_value())
-        return;
-    VkDeviceSize bufferSize = sizeof(indices.value()[0]) * indices.value().size();
-
-    indexBuffer = Buffer();
-    indexBuffer->Init(m_pVulkanCore, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    indexBuffer->UploadData(indices.value().data(), (size_t)bufferSize);
-}
-
-template <typename VertexType, typename IndexType /*= uint32_t*/>
-void MeshData<VertexType, IndexType>::createVertexBuffer()
-{
-    VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-
-    vertexBuffer.Init(m_pVulkanCore, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    vertexBuffer.UploadData(vertices.data(), (size_t)bufferSize);
+    // The pool's buffers are bound once per frame by GeometryPool::Bind()
+    m_pVulkanCore->GetGeometryPool().Draw(commandBuffer, m_geometryHandle, 1, firstInstance);
 }
 
 template <typename VertexType, typename IndexType /*= uint32_t*/>
@@ -77,12 +46,9 @@ bool MeshData<VertexType, IndexType>::releaseModelFromGPU()
         return false;
     assert(m_pVulkanCore != nullptr);
 
-    auto device = m_pVulkanCore->GetDevice();
-    if (device != VK_NULL_HANDLE) {
-        if (indexBuffer)
-            indexBuffer->Destroy();
-        vertexBuffer.Destroy();
-    }
+    if (m_pVulkanCore->GetDevice() != VK_NULL_HANDLE)
+        m_pVulkanCore->GetGeometryPool().Remove(m_geometryHandle);
+    m_geometryHandle = GeometryPool::kInvalidHandle;
     isOnGPU = false;
     return true;
 }
@@ -92,11 +58,13 @@ bool MeshData<VertexType, IndexType>::uploadModelToGPU(VulkanCore* vulkanCore)
 {
     if (isOnGPU)
         return true;
+    static_assert(std::is_same_v<IndexType, uint32_t>, "The geometry pool stores 32 bit indices");
     m_pVulkanCore = vulkanCore;
-    createVertexBuffer();
 
-    if (indices.has_value())
-        createIndexBuffer();
+    GeometryPool& geometryPool = m_pVulkanCore->GetGeometryPool();
+    assert(sizeof(VertexType) == geometryPool.GetVertexStride());
+    m_geometryHandle = geometryPool.Add(vertices.data(), static_cast<uint32_t>(vertices.size()),
+        indices ? indices->data() : nullptr, indices ? static_cast<uint32_t>(indices->size()) : 0);
 
     m_pVulkanCore->mainDeletionStack.push([=]() {
         releaseModelFromGPU();
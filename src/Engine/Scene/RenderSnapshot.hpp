@@ -0,0 +1,31 @@
+#pragma once
+#include "Mesh.hpp"
+#include "pch.hpp"
+
+struct CameraSnapshot {
+    vkm::mat4 view;
+    vkm::mat4 proj;
+    vkm::vec3 position;
+};
+
+// One camera a frame is rendered from
+struct RenderView {
+    std::string name; // Camera name with -render-cameras (names the SAVE outputs), empty for the single default view
+    CameraSnapshot camera;
+    vkm::mat4 cullingViewProj;
+};
+
+// Everything the renderer needs from the simulation for one frame.
+// Filled by Scene::ExtractRenderSnapshot() after the update and never modified while being rendered,
+// which lets the simulation of the next frame run while this one is recorded.
+struct RenderSnapshot {
+    bool isValid = false;
+    uint64_t frameIndex = 0;
+
+    // Every view shares the mesh instances below and is culled on its own. The first one is presented; with -render-cameras there
+    // is one per listed camera, otherwise only the active camera's. Its culling always uses the active camera, so culling can be
+    // inspected from the debug camera.
+    std::vector<RenderView> views;
+
+    std::vector<MeshInstance> meshInstances;
+};
@@ -6,9 +6,12 @@
 #include "Environment.hpp"
 #include "Material.hpp"
 #include "Mesh.hpp"
+#include "RenderSnapshot.hpp"
+#include "Utilities/Trace.hpp"
 
 void Scene::Init(const Utility::json::JsonValue& jsonObj)
 {
+    TRACE_ZONE("Scene::Init");
     printf("Hello there!\n");
     if (!jsonObj.isArray())
         throw std::runtime_error("File Format Wrong!");
@@ -59,10 +62,12 @@ void Scene::Init(const Utility::json::JsonValue& jsonObj)
     }
 }
 
-std::shared_ptr<Scene> Scene::loadSceneFromFile(const std::string& path)
+std::shared_ptr<Scene> Scene::loadSceneFromFile(const std::string& path, const EnvironmentOptions& environmentOptions)
 {
+    TRACE_ZONE("Scene::loadSceneFromFile");
     auto pScene = std::make_shared<Scene>();
     pScene->src = path;
+    pScene->environmentOptions = environmentOptions;
     pScene->Init(Utility::json::JsonValue::parseJsonFromFile(path));
     return pScene;
 }
@@ -159,6 +164,46 @@ void Scene::Traverse(std::vector<MeshInstance>& meshInsts)
     }
 }
 
+void Scene::ExtractRenderSnapshot(RenderSnapshot& snapshot)
+{
+    snapshot.meshInstances.clear();
+    Traverse(snapshot.meshInstances);
+
+    auto& cameraManager = CameraManager::GetInstance();
+    snapshot.views.clear();
+
+    // Batch rendering, the traversal above is shared by all cameras
+    const auto& renderCameras = cameraManager.GetRenderCameras();
+    for (auto& camera : renderCameras) {
+        vkm::mat4 view = camera->getViewMatrix();
+        vkm::mat4 proj = camera->getProjectionMatrix();
+        snapshot.views.push_back(RenderView {
+            .name = camera->getName(),
+            .camera = { .view = view, .proj = proj, .position = camera->getPosition() },
+            .cullingViewProj = proj * view,
+        });
+    }
+
+    if (renderCameras.empty()) {
+        auto cullingCamera = cameraManager.GetActiveCamera();
+        auto viewCamera = cullingCamera;
+#ifndef NDEBUG
+        if (cameraManager.IsDebugModeActive())
+            viewCamera = cameraManager.GetDebugCamera();
+#endif
+        snapshot.views.push_back(RenderView {
+            .camera = {
+                .view = viewCamera->getViewMatrix(),
+                .proj = viewCamera->getProjectionMatrix(),
+                .position = viewCamera->getPosition(),
+            },
+            .cullingViewProj = cullingCamera->getProjectionMatrix() * cullingCamera->getViewMatrix(),
+        });
+    }
+
+    snapshot.isValid = true;
+}
+
 void Scene::SetPlaybackTimeAndRate(float playbackTime, float playbackRate)
 {
     m_elapsedTime = playbackTime;
@@ -7,6 +7,7 @@ class SceneCamera;
 class Node;
 class Mesh;
 struct MeshInstance;
+struct RenderSnapshot;
 class Driver;
 class Scene;
 class Material;
@@ -45,6 +46,13 @@ public:
     std::optional<std::vector<float>> GetValue(float time) const;
 };
 
+// How the environment lighting is precomputed when the scene loads
+struct EnvironmentOptions {
+    ELambertianMode lambertianMode = ELambertianMode::SPHERICAL_HARMONICS;
+    std::string cacheDirectory; // Generated assets are stored here, see Utility::AssetCache. Empty disables storing
+    std::vector<std::string> assetDirectories; // Read-only, searched for generated assets before the cache
+};
+
 class Scene : public std::enable_shared_from_this<Scene> {
 public:
     Scene() = default;
@@ -61,8 +69,9 @@ public:
     std::unordered_map<size_t, std::shared_ptr<Driver>> drivers;
     std::unordered_map<size_t, std::shared_ptr<Material>> materials;
     std::shared_ptr<Environment> environment;
+    EnvironmentOptions environmentOptions;
 
-    static std::shared_ptr<Scene> loadSceneFromFile(const std::string& path);
+    static std::shared_ptr<Scene> loadSceneFromFile(const std::string& path, const EnvironmentOptions& environmentOptions = {});
     void PrintStatistics() const;
     static std::shared_ptr<Scene> defaultScene();
 
@@ -74,6 +83,8 @@ public:
     void Update(float deltaTime);
     // #TODO: don't have to traverse and update all meshInstances every frame, only the ones that have changed, the rest can be cached
     void Traverse(std::vector<MeshInstance>& meshInsts);
+    // Copies the mesh instances and camera matrices of the current state into snapshot, reusing its storage
+    void ExtractRenderSnapshot(RenderSnapshot& snapshot);
     void SetPlaybackTimeAndRate(float playbackTime, float playbackRate);
 
 public:
@@ -37,4 +37,10 @@ enum class EMaterialType {
     MIRROR = 2,
     ENVIRONMENT = 3,
     SIMPLE = 4,
+    COUNT, // Number of material types, one pipeline variant each
+};
+
+enum class ELambertianMode {
+    SPHERICAL_HARMONICS, // Projection onto 9 coefficients, evaluated in the shader
+    MONTE_CARLO, // blur_cube into a cube map
 };
\ No newline at end of file
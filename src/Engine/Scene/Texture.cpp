@@ -1,4 +1,5 @@
 #include "Texture.hpp"
+#include "Utilities/Trace.hpp"
 
 Texture::Texture(const Utility::json::JsonValue& jsonObj, const std::string& scenePath, VkFormat imageFormat)
 {
@@ -38,6 +39,7 @@ Texture::Texture(const float& floatValue, VkFormat imageFormat)
 
 void Texture::LoadTextureData()
 {
+    TRACE_ZONE("Texture::LoadTextureData");
     stbi_uc* pixels = stbi_load(src.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha); // TODO: single channel image
     if (!pixels) {
         throw std::runtime_error("failed to load texture image!");
@@ -70,6 +72,7 @@ void Texture::LoadTextureData()
 
 bool Texture::uploadTextureToGPU(VulkanCore* vulkanCore)
 {
+    TRACE_ZONE("Texture::uploadTextureToGPU");
     if (isOnGPU)
         return true;
     m_pVulkanCore = vulkanCore;
@@ -111,8 +114,14 @@ void Texture::createImage()
         textureImage.Init(m_pVulkanCore, VkExtent2D { (uint32_t)texWidth, (uint32_t)texHeight }, mipLevels, VK_SAMPLE_COUNT_1_BIT, textureImageFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true);
         textureImage.InitImageView(textureImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, VK_IMAGE_VIEW_TYPE_CUBE);
         textureImage.InitImageSampler(VK_SAMPLER_ADDRESS_MODE_REPEAT);
-        textureImage.UploadData(textureData.get(), imageSize);
-		textureImage.GenerateMipmaps(std::nullopt, mipLevels);
+        if (hasMipChain) {
+            for (int level = 1; level < mipLevels; level++)
+                imageSize += VkDeviceSize(std::max(texWidth >> level, 1)) * std::max(texHeight >> level, 1) * texChannels * 6;
+            textureImage.UploadData(textureData.get(), imageSize, mipLevels);
+        } else {
+            textureImage.UploadData(textureData.get(), imageSize);
+            textureImage.GenerateMipmaps(std::nullopt, mipLevels);
+        }
 	}
 	else {
         throw std::runtime_error("Unsupported texture type");
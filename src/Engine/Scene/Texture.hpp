@@ -22,6 +22,7 @@ public:
     int texWidth, texHeight, texChannels;
     int mipLevels;
     std::shared_ptr<stbi_uc> textureData;
+    bool hasMipChain = false; // textureData holds all mipLevels one after the other, mip 0 first, instead of generating them on upload
 
     // Vulkan
 public:
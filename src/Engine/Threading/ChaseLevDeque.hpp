@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace EngineCore {
+
+// Fixed-capacity Chase-Lev work-stealing deque ("Correct and Efficient Work-Stealing for Weak Memory Models", Le et al. 2013).
+// The owning thread pushes and pops at the bottom, any other thread may steal from the top.
+// Push fails when the deque is full instead of growing; the caller decides where the item goes then.
+template <typename T>
+class ChaseLevDeque {
+public:
+    explicit ChaseLevDeque(size_t capacity = 4096)
+        : m_mask(static_cast<int64_t>(capacity) - 1)
+        , m_buffer(std::make_unique<std::atomic<T*>[]>(capacity))
+    {
+        assert(capacity > 0 && (capacity & (capacity - 1)) == 0 && "capacity must be a power of two");
+    }
+
+    ChaseLevDeque(const ChaseLevDeque&) = delete;
+    ChaseLevDeque& operator=(const ChaseLevDeque&) = delete;
+
+    // Owner thread only.
+    bool Push(T* item)
+    {
+        int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+        int64_t top = m_top.load(std::memory_order_acquire);
+        if (bottom - top > m_mask)
+            return false;
+
+        m_buffer[bottom & m_mask].store(item, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Owner thread only.
+    T* Pop()
+    {
+        int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+        m_bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = m_top.load(std::memory_order_relaxed);
+
+        if (top > bottom) {
+            // Empty
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        T* item = m_buffer[bottom & m_mask].load(std::memory_order_relaxed);
+        if (top == bottom) {
+            // Last item, race against thieves for it
+            if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                item = nullptr;
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    // Any thread.
+    T* Steal()
+    {
+        int64_t top = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = m_bottom.load(std::memory_order_acquire);
+
+        if (top >= bottom)
+            return nullptr;
+
+        T* item = m_buffer[top & m_mask].load(std::memory_order_relaxed);
+        if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+        return item;
+    }
+
+    bool EmptyApprox() const
+    {
+        return m_top.load(std::memory_order_relaxed) >= m_bottom.load(std::memory_order_relaxed);
+    }
+
+private:
+    // top and bottom live on separate cache lines, thieves hammer top while the owner works on bottom
+    alignas(64) std::atomic<int64_t> m_top { 0 };
+    alignas(64) std::atomic<int64_t> m_bottom { 0 };
+    int64_t m_mask;
+    std::unique_ptr<std::atomic<T*>[]> m_buffer;
+};
+
+} // namespace EngineCore
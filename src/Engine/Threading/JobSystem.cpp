@@ -0,0 +1,278 @@
+#include "JobSystem.hpp"
+
+#if defined(_WIN32)
+#include <Windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace EngineCore {
+
+static thread_local uint32_t s_threadIndex = UINT32_MAX;
+static thread_local uint32_t s_stealSeed = 0x9E3779B9u;
+
+// Spins before a worker goes to sleep, keeps latency low for bursts of short jobs
+static constexpr uint32_t kSpinCountBeforeSleep = 64;
+
+uint32_t JobSystem::GetThreadIndex()
+{
+    return s_threadIndex;
+}
+
+uint32_t JobSystem::DefaultWorkerCount()
+{
+    uint32_t hardwareThreads = std::thread::hardware_concurrency();
+    return hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+}
+
+void JobSystem::Init(uint32_t workerCount, bool pinThreads)
+{
+    if (m_initialized)
+        return;
+
+    m_quit = false;
+    m_queues.clear();
+    for (uint32_t i = 0; i < workerCount + 1; ++i) {
+        m_queues.push_back(std::make_unique<ChaseLevDeque<Job>>());
+    }
+
+    s_threadIndex = 0;
+    if (pinThreads)
+        PinCurrentThread(0);
+
+    m_workers.reserve(workerCount);
+    for (uint32_t i = 1; i <= workerCount; ++i) {
+        m_workers.emplace_back([this, i, pinThreads]() {
+            s_threadIndex = i;
+            s_stealSeed = 0x9E3779B9u * (i + 1);
+            if (pinThreads)
+                PinCurrentThread(i);
+            WorkerLoop(i);
+        });
+    }
+
+    m_initialized = true;
+#if VERBOSE
+    std::cout << "JobSystem: " << workerCount << " worker threads" << (pinThreads ? " (pinned)" : "") << std::endl;
+#endif
+}
+
+void JobSystem::Shutdown()
+{
+    if (!m_initialized)
+        return;
+
+    // Drain whatever is left so nobody waits forever on a counter
+    while (Job* job = FindJob(0)) {
+        Execute(job, 0);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_quit = true;
+    }
+    m_sleepCondition.notify_all();
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+    m_workers.clear();
+    m_queues.clear();
+    m_initialized = false;
+}
+
+void JobSystem::Run(const char* name, std::function<void()> function, JobCounter* counter, JobCounter* dependency)
+{
+    if (counter)
+        counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+
+    Job* job = new Job { std::move(function), counter, name };
+
+    if (dependency && !dependency->IsDone()) {
+        std::lock_guard<std::mutex> lock(dependency->m_mutex);
+        // Re-check under the lock, Finish() takes the same lock after the counter hits zero
+        if (!dependency->IsDone()) {
+            dependency->m_continuations.push_back(job);
+            return;
+        }
+    }
+
+    Submit(job);
+}
+
+void JobSystem::Submit(Job* job)
+{
+    if (!m_initialized) {
+        // No threads to hand the work to, run it right away
+        Execute(job, 0);
+        return;
+    }
+
+    m_queuedJobs.fetch_add(1, std::memory_order_seq_cst);
+
+    uint32_t threadIndex = s_threadIndex;
+    if (threadIndex >= m_queues.size() || !m_queues[threadIndex]->Push(job)) {
+        std::lock_guard<std::mutex> lock(m_sharedQueueMutex);
+        m_sharedQueue.push_back(job);
+    }
+
+    if (m_sleepingWorkers.load(std::memory_order_seq_cst) > 0) {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_sleepCondition.notify_one();
+    }
+}
+
+Job* JobSystem::FindJob(uint32_t threadIndex)
+{
+    Job* job = nullptr;
+
+    if (threadIndex < m_queues.size())
+        job = m_queues[threadIndex]->Pop();
+
+    if (!job) {
+        std::lock_guard<std::mutex> lock(m_sharedQueueMutex);
+        if (!m_sharedQueue.empty()) {
+            job = m_sharedQueue.front();
+            m_sharedQueue.pop_front();
+        }
+    }
+
+    if (!job && !m_queues.empty()) {
+        // xorshift so that thieves don't all start with the same victim
+        s_stealSeed ^= s_stealSeed << 13;
+        s_stealSeed ^= s_stealSeed >> 17;
+        s_stealSeed ^= s_stealSeed << 5;
+        uint32_t queueCount = static_cast<uint32_t>(m_queues.size());
+        uint32_t offset = s_stealSeed % queueCount;
+        for (uint32_t i = 0; i < queueCount && !job; ++i) {
+            uint32_t victim = (offset + i) % queueCount;
+            if (victim != threadIndex)
+                job = m_queues[victim]->Steal();
+        }
+    }
+
+    if (job)
+        m_queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+    return job;
+}
+
+void JobSystem::Execute(Job* job, uint32_t threadIndex)
+{
+    if (m_instrumentationHook) {
+        auto start = std::chrono::steady_clock::now();
+        job->function();
+        auto end = std::chrono::steady_clock::now();
+        m_instrumentationHook(JobTiming { job->name, threadIndex, start, end });
+    } else {
+        job->function();
+    }
+
+    JobCounter* counter = job->counter;
+    delete job;
+    if (counter)
+        Finish(counter);
+}
+
+void JobSystem::Finish(JobCounter* counter)
+{
+    // Jobs that do not finish the counter only decrement it
+    uint32_t pending = counter->m_pending.load(std::memory_order_relaxed);
+    while (pending > 1) {
+        if (counter->m_pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+            return;
+    }
+
+    // The last one reaches zero under the lock: Wait() takes the lock once it sees zero, so the counter, which may live on the
+    // waiter's stack, is not touched after that
+    std::vector<Job*> continuations;
+    {
+        std::lock_guard<std::mutex> lock(counter->m_mutex);
+        // Run() may have added to the counter since
+        if (counter->m_pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+        continuations.swap(counter->m_continuations);
+    }
+    for (Job* job : continuations) {
+        Submit(job);
+    }
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+    uint32_t threadIndex = s_threadIndex;
+    while (!counter.IsDone()) {
+        if (Job* job = FindJob(threadIndex)) {
+            Execute(job, threadIndex);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    // Until the job that reached zero has left Finish()
+    std::lock_guard<std::mutex> lock(counter.m_mutex);
+}
+
+void JobSystem::ParallelFor(const char* name, uint32_t count, uint32_t grainSize, const std::function<void(uint32_t begin, uint32_t end)>& function)
+{
+    if (count == 0)
+        return;
+    grainSize = std::max(grainSize, 1u);
+
+    if (!m_initialized || m_workers.empty() || count <= grainSize) {
+        function(0, count);
+        return;
+    }
+
+    JobCounter counter;
+    for (uint32_t begin = 0; begin < count; begin += grainSize) {
+        uint32_t end = std::min(begin + grainSize, count);
+        Run(name, [&function, begin, end]() { function(begin, end); }, &counter);
+    }
+    Wait(counter);
+}
+
+void JobSystem::WorkerLoop(uint32_t threadIndex)
+{
+    uint32_t idleSpins = 0;
+    while (!m_quit.load(std::memory_order_relaxed)) {
+        if (Job* job = FindJob(threadIndex)) {
+            Execute(job, threadIndex);
+            idleSpins = 0;
+            continue;
+        }
+
+        if (++idleSpins < kSpinCountBeforeSleep) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_sleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+        m_sleepCondition.wait(lock, [this]() {
+            return m_quit.load(std::memory_order_relaxed) || m_queuedJobs.load(std::memory_order_seq_cst) > 0;
+        });
+        m_sleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+        idleSpins = 0;
+    }
+}
+
+void JobSystem::PinCurrentThread(uint32_t core)
+{
+    uint32_t hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    core %= hardwareThreads;
+#if defined(_WIN32)
+    if (core < 64)
+        SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << core);
+#elif defined(__linux__)
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(core, &cpuSet);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet) != 0) {
+        std::cerr << "JobSystem: failed to pin thread to core " << core << std::endl;
+    }
+#else
+    // Thread affinity is only a hint on other platforms (e.g. macOS), not supported
+    (void)core;
+#endif
+}
+
+} // namespace EngineCore
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "ChaseLevDeque.hpp"
+#include "pch.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace EngineCore {
+
+struct Job;
+
+// Counts outstanding jobs. A counter can be waited on, or used as a dependency for other jobs.
+// A counter can be reused once it has been waited on.
+class JobCounter {
+public:
+    JobCounter() = default;
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    bool IsDone() const { return m_pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+
+    std::atomic<uint32_t> m_pending { 0 };
+    std::mutex m_mutex;
+    std::vector<Job*> m_continuations; // Jobs waiting for this counter to reach zero
+};
+
+struct JobTiming {
+    const char* name;
+    uint32_t threadIndex;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point end;
+};
+
+using JobInstrumentationHook = std::function<void(const JobTiming&)>;
+
+struct Job {
+    std::function<void()> function;
+    JobCounter* counter = nullptr;
+    const char* name = nullptr;
+};
+
+// Work-stealing job system. Every worker owns a Chase-Lev deque; idle workers steal from the others.
+// The thread calling Init() becomes thread 0 and takes part in the work whenever it waits on a counter.
+// Threads that are not part of the system may still submit jobs, these go through a shared queue.
+class JobSystem {
+public:
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    static JobSystem& GetInstance()
+    {
+        static JobSystem instance;
+        return instance;
+    }
+
+    // workerCount does not include the calling thread. 0 runs every job on the waiting thread.
+    void Init(uint32_t workerCount, bool pinThreads = false);
+    void Shutdown();
+
+    bool IsInitialized() const { return m_initialized; }
+    uint32_t GetWorkerCount() const { return static_cast<uint32_t>(m_workers.size()); }
+    // Worker threads plus the main thread
+    uint32_t GetThreadCount() const { return GetWorkerCount() + 1; }
+    // 0 for the main thread, 1..N for workers, UINT32_MAX for threads outside the system
+    static uint32_t GetThreadIndex();
+
+    static uint32_t DefaultWorkerCount();
+
+    // Submits a job. If counter is given it is incremented now and decremented once the job finished.
+    // If dependency is given the job is only queued once the dependency counter reaches zero.
+    void Run(const char* name, std::function<void()> function, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+
+    // Blocks until the counter reaches zero, executing queued jobs in the meantime.
+    void Wait(JobCounter& counter);
+
+    // Splits [0, count) into chunks of grainSize and runs function(begin, end) on each, blocks until all chunks are done.
+    void ParallelFor(const char* name, uint32_t count, uint32_t grainSize, const std::function<void(uint32_t begin, uint32_t end)>& function);
+
+    // Called after every job with its timing, from the thread that executed it. Set before submitting work.
+    void SetInstrumentationHook(JobInstrumentationHook hook) { m_instrumentationHook = std::move(hook); }
+
+private:
+    JobSystem() = default;
+
+    void WorkerLoop(uint32_t threadIndex);
+    void Submit(Job* job);
+    Job* FindJob(uint32_t threadIndex);
+    void Execute(Job* job, uint32_t threadIndex);
+    void Finish(JobCounter* counter);
+    static void PinCurrentThread(uint32_t core);
+
+private:
+    bool m_initialized = false;
+    std::vector<std::thread> m_workers;
+    // One deque per thread, index 0 belongs to the main thread
+    std::vector<std::unique_ptr<ChaseLevDeque<Job>>> m_queues;
+
+    // Overflow queue for full deques and for threads outside the system
+    std::mutex m_sharedQueueMutex;
+    std::deque<Job*> m_sharedQueue;
+
+    std::atomic<int64_t> m_queuedJobs { 0 };
+    std::atomic<uint32_t> m_sleepingWorkers { 0 };
+    std::atomic<bool> m_quit { false };
+    std::mutex m_sleepMutex;
+    std::condition_variable m_sleepCondition;
+
+    JobInstrumentationHook m_instrumentationHook;
+};
+
+} // namespace EngineCore
@@ -34,6 +34,8 @@ ArgsParser::ArgsParser(int argc, const char** argv)
     }
     std::cout << std::endl;
 #endif
+    if (argc > 0)
+        m_ProgramPath = argv[0];
     std::string currentKey;
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
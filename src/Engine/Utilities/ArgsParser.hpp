@@ -24,8 +24,12 @@ public:
     void PrintArgs();
 
     std::optional<std::vector<std::string>> GetArg(const std::string& argName) const;
+    const std::unordered_map<std::string, std::vector<std::string>>& GetAllArgs() const { return m_Args; }
+    // argv[0]
+    const std::string& GetProgramPath() const { return m_ProgramPath; }
 
 private:
     std::unordered_map<std::string, std::vector<std::string>> m_Args;
+    std::string m_ProgramPath;
 };
 } // namespace Utility
\ No newline at end of file
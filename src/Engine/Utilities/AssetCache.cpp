@@ -0,0 +1,82 @@
+#include "AssetCache.hpp"
+
+#include <iomanip>
+#include <random>
+
+using namespace Utility;
+
+AssetCache::AssetCache(std::filesystem::path cacheDirectory, std::vector<std::filesystem::path> assetDirectories)
+    : m_cacheDirectory(std::move(cacheDirectory))
+    , m_assetDirectories(std::move(assetDirectories))
+{
+}
+
+uint64_t AssetCache::Hash(const void* data, size_t size, uint64_t seed /*= 0xcbf29ce484222325ull*/)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+std::string AssetCache::MakeName(const std::string& prefix, uint64_t hash, const std::string& extension)
+{
+    std::ostringstream name;
+    name << prefix << "-" << std::hex << std::setw(16) << std::setfill('0') << hash << extension;
+    return name.str();
+}
+
+std::filesystem::path AssetCache::MakeTemporaryPath(const std::filesystem::path& directory, const std::string& name)
+{
+    return directory / (".tmp-" + std::to_string(std::random_device {}()) + "-" + name);
+}
+
+std::optional<std::filesystem::path> AssetCache::Find(const std::string& name) const
+{
+    std::error_code error;
+    for (const auto& directory : m_assetDirectories) {
+        if (std::filesystem::is_regular_file(directory / name, error))
+            return directory / name;
+    }
+    if (!m_cacheDirectory.empty() && std::filesystem::is_regular_file(m_cacheDirectory / name, error))
+        return m_cacheDirectory / name;
+    return std::nullopt;
+}
+
+std::optional<std::filesystem::path> AssetCache::Store(const std::string& name, const std::function<void(const std::filesystem::path&)>& write) const
+{
+    if (m_cacheDirectory.empty())
+        return std::nullopt;
+
+    std::error_code error;
+    std::filesystem::create_directories(m_cacheDirectory, error);
+    if (error) {
+        std::cerr << "AssetCache: failed to create " << m_cacheDirectory.string() << ": " << error.message() << std::endl;
+        return std::nullopt;
+    }
+
+    // Unique per writer, other processes may be writing the same name right now
+    std::filesystem::path finalPath = m_cacheDirectory / name;
+    std::filesystem::path tempPath = MakeTemporaryPath(m_cacheDirectory, name);
+    try {
+        write(tempPath);
+    } catch (...) {
+        std::filesystem::remove(tempPath, error);
+        throw;
+    }
+
+    std::filesystem::rename(tempPath, finalPath, error);
+    if (error) {
+        std::error_code removeError;
+        std::filesystem::remove(tempPath, removeError);
+        // Rename does not replace an existing file everywhere, another writer got there first with the same content
+        if (std::filesystem::is_regular_file(finalPath, removeError))
+            return finalPath;
+        std::cerr << "AssetCache: failed to store " << finalPath.string() << ": " << error.message() << std::endl;
+        return std::nullopt;
+    }
+    return finalPath;
+}
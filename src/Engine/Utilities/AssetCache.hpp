@@ -0,0 +1,36 @@
+#pragma once
+
+#include "pch.hpp"
+
+namespace Utility {
+
+// Content addressed store for generated assets. Names carry a hash of everything the asset was generated from (see Hash), so a
+// hit can be used as is and a changed input or generator simply misses. Lookups go through the read-only asset directories first,
+// e.g. a shared prebuilt set, then the cache directory; only the cache directory is written. Writes go to a file unique to the
+// writer and are renamed into place, so any number of processes can share one directory: readers never see a partial file and
+// writers racing on the same key produce the same bytes.
+class AssetCache {
+public:
+    // An empty cacheDirectory disables storing
+    AssetCache(std::filesystem::path cacheDirectory, std::vector<std::filesystem::path> assetDirectories);
+
+    // 64 bit FNV-1a, chain calls through seed
+    static uint64_t Hash(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull);
+    // "<prefix>-<16 hex digits of hash><extension>"
+    static std::string MakeName(const std::string& prefix, uint64_t hash, const std::string& extension);
+    // A path in directory for a file on its way to name, unique to the writer. Keeps the extension, writers pick the format by it.
+    static std::filesystem::path MakeTemporaryPath(const std::filesystem::path& directory, const std::string& name);
+
+    bool IsStoringEnabled() const { return !m_cacheDirectory.empty(); }
+
+    std::optional<std::filesystem::path> Find(const std::string& name) const;
+    // Calls write with a temporary path in the cache directory and moves the file it wrote to name. Returns the final path, nullopt
+    // when storing is disabled or failed; exceptions of write are passed on after the temporary file is removed.
+    std::optional<std::filesystem::path> Store(const std::string& name, const std::function<void(const std::filesystem::path&)>& write) const;
+
+private:
+    std::filesystem::path m_cacheDirectory;
+    std::vector<std::filesystem::path> m_assetDirectories;
+};
+
+} // namespace Utility
@@ -0,0 +1,45 @@
+#include "FramePacer.hpp"
+
+#include <thread>
+
+using namespace Utility;
+
+void FramePacer::WaitUntil(Clock::time_point deadline)
+{
+    auto now = Clock::now();
+    if (deadline <= now)
+        return;
+    m_waitCount++;
+
+    if (deadline - now > m_spinMargin) {
+        auto requested = deadline - now - m_spinMargin;
+        std::this_thread::sleep_for(requested);
+        auto woke = Clock::now();
+        m_slept += woke - now;
+
+        double latenessUs = std::chrono::duration<double, std::micro>(woke - now - requested).count();
+        m_sleepLatenessUs += (std::max(latenessUs, 0.0) - m_sleepLatenessUs) * 0.125;
+        auto margin = std::chrono::microseconds(static_cast<long long>(2.0 * m_sleepLatenessUs));
+        m_spinMargin = std::clamp(margin, kMinSpinMargin, kMaxSpinMargin);
+        now = woke;
+    }
+
+    auto spinStart = now;
+    while (now < deadline) {
+        std::this_thread::yield();
+        now = Clock::now();
+    }
+    m_spun += now - spinStart;
+    m_overshoot += now - deadline;
+}
+
+void FramePacer::PrintStatistics() const
+{
+    if (m_waitCount == 0)
+        return;
+
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+    std::cout << "Idle: " << m_waitCount << " waits, slept " << Milliseconds(m_slept).count() << " ms, spun "
+              << Milliseconds(m_spun).count() << " ms, " << std::chrono::duration<double, std::micro>(m_overshoot).count() / m_waitCount
+              << " us past the deadline on average" << std::endl;
+}
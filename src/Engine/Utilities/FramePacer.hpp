@@ -0,0 +1,32 @@
+#pragma once
+
+#include "pch.hpp"
+
+namespace Utility {
+
+// Waits for a deadline without burning a core: the bulk of the wait is slept, the last stretch, which a sleep cannot hit
+// precisely, is spun while yielding. The spin margin follows how late sleeps actually wake up on this machine.
+// Keeps how long the main loop slept and spun, see PrintStatistics().
+class FramePacer {
+public:
+    using Clock = std::chrono::high_resolution_clock;
+
+    // Returns right away when the deadline has passed
+    void WaitUntil(Clock::time_point deadline);
+    // Prints nothing when it never waited
+    void PrintStatistics() const;
+
+private:
+    static constexpr std::chrono::microseconds kMinSpinMargin { 200 };
+    static constexpr std::chrono::microseconds kMaxSpinMargin { 20000 }; // Coarse timers, e.g. the 15.6 ms Windows default
+
+    std::chrono::microseconds m_spinMargin { 1000 };
+    double m_sleepLatenessUs = 0.0; // Moving average of how much later than requested sleeps return
+
+    uint64_t m_waitCount = 0;
+    Clock::duration m_slept {};
+    Clock::duration m_spun {};
+    Clock::duration m_overshoot {}; // Past the deadlines, summed
+};
+
+} // namespace Utility
@@ -0,0 +1,186 @@
+#include "FrameProfiler.hpp"
+#include "Metrics.hpp"
+
+using namespace Utility;
+
+static constexpr const char* kCpuPhaseNames[] = { "update", "traverse", "cull", "record", "submit", "present", "readback", "fence_wait", "idle" };
+static constexpr const char* kGpuScopeNames[] = { "gpu_frame", "gpu_main_pass", "gpu_depth_prepass" };
+static constexpr const char* kPipelineStatisticNames[] = { "ia_vertices", "ia_primitives", "vs_invocations", "clipping_primitives", "fs_invocations" };
+static_assert(std::size(kCpuPhaseNames) == size_t(ECpuPhase::COUNT));
+static_assert(std::size(kGpuScopeNames) == size_t(EGpuScope::COUNT));
+static_assert(std::size(kPipelineStatisticNames) == size_t(EPipelineStatistic::COUNT));
+
+const char* Utility::GetCpuPhaseName(ECpuPhase phase)
+{
+    return kCpuPhaseNames[size_t(phase)];
+}
+
+bool Utility::IsCpuTimingEnabled()
+{
+    return FrameProfiler::GetInstance().IsEnabled() || FrameMetrics::GetInstance().IsEnabled();
+}
+
+void Utility::RecordCpuTime(ECpuPhase phase, std::chrono::steady_clock::duration duration)
+{
+    FrameProfiler& profiler = FrameProfiler::GetInstance();
+    if (profiler.IsEnabled())
+        profiler.AddCpuTime(phase, duration);
+    FrameMetrics::GetInstance().RecordCpuTime(phase, duration);
+}
+
+void FrameProfiler::Init(const std::filesystem::path& outputPath)
+{
+    m_output.open(outputPath, std::ios::trunc);
+    if (!m_output) {
+        std::cerr << "FrameProfiler: failed to open " << outputPath.string() << ", profiling is disabled" << std::endl;
+        return;
+    }
+
+    m_isJson = outputPath.extension() == ".json";
+    m_isFirstRecord = true;
+    if (m_isJson) {
+        m_output << "[";
+    } else {
+        m_output << "frame";
+        for (auto name : kCpuPhaseNames)
+            m_output << "," << name << "_ms";
+        for (auto name : kGpuScopeNames)
+            m_output << "," << name << "_ms";
+        for (auto name : kPipelineStatisticNames)
+            m_output << "," << name;
+        m_output << "\n";
+    }
+
+    for (auto& nanoseconds : m_cpuNanoseconds)
+        nanoseconds.store(0, std::memory_order_relaxed);
+    m_statisticsSums = {};
+    m_statisticsFrameCount = 0;
+    m_enabled = true;
+    std::cout << "FrameProfiler: writing per frame records to " << outputPath.string() << std::endl;
+}
+
+void FrameProfiler::Shutdown()
+{
+    if (!m_enabled)
+        return;
+
+    while (!m_pendingRecords.empty()) {
+        WriteRecord(m_pendingRecords.front());
+        m_pendingRecords.pop_front();
+    }
+    if (m_isJson)
+        m_output << "\n]\n";
+    m_output.close();
+    m_enabled = false;
+
+    if (m_statisticsFrameCount > 0) {
+        std::cout << "FrameProfiler: mean pipeline statistics of " << m_statisticsFrameCount << " frames:";
+        for (size_t i = 0; i < size_t(EPipelineStatistic::COUNT); i++)
+            std::cout << " " << kPipelineStatisticNames[i] << " " << m_statisticsSums[i] / m_statisticsFrameCount;
+        std::cout << std::endl;
+    }
+}
+
+void FrameProfiler::AddCpuTime(ECpuPhase phase, std::chrono::steady_clock::duration duration)
+{
+    int64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    m_cpuNanoseconds[size_t(phase)].fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+void FrameProfiler::EndFrame(uint64_t frameIndex)
+{
+    if (!m_enabled)
+        return;
+
+    FrameRecord record { .frameIndex = frameIndex };
+    for (size_t i = 0; i < record.cpuMilliseconds.size(); i++)
+        record.cpuMilliseconds[i] = m_cpuNanoseconds[i].exchange(0, std::memory_order_relaxed) * 1e-6;
+    m_pendingRecords.push_back(record);
+
+    if (!m_expectGpuResults) {
+        WriteReadyRecords(frameIndex);
+        return;
+    }
+    while (m_pendingRecords.size() > kMaxPendingFrames) {
+        WriteRecord(m_pendingRecords.front());
+        m_pendingRecords.pop_front();
+    }
+}
+
+void FrameProfiler::SetGpuResults(uint64_t frameIndex, const GpuFrameResults& results)
+{
+    if (!m_enabled)
+        return;
+
+    if (results.pipelineStatistics) {
+        for (size_t i = 0; i < m_statisticsSums.size(); i++)
+            m_statisticsSums[i] += (*results.pipelineStatistics)[i];
+        m_statisticsFrameCount++;
+    }
+
+    for (auto& record : m_pendingRecords) {
+        if (record.frameIndex == frameIndex) {
+            record.gpu = results;
+            break;
+        }
+    }
+    WriteReadyRecords(frameIndex);
+}
+
+void FrameProfiler::WriteReadyRecords(uint64_t completedFrameIndex)
+{
+    // Frames older than the completed one will not get GPU results any more
+    while (!m_pendingRecords.empty() && (m_pendingRecords.front().gpu || m_pendingRecords.front().frameIndex <= completedFrameIndex)) {
+        WriteRecord(m_pendingRecords.front());
+        m_pendingRecords.pop_front();
+    }
+}
+
+void FrameProfiler::WriteRecord(const FrameRecord& record)
+{
+    std::array<std::optional<double>, size_t(EGpuScope::COUNT)> scopeMilliseconds {};
+    std::optional<std::array<uint64_t, size_t(EPipelineStatistic::COUNT)>> pipelineStatistics;
+    if (record.gpu) {
+        scopeMilliseconds = record.gpu->scopeMilliseconds;
+        pipelineStatistics = record.gpu->pipelineStatistics;
+    }
+
+    if (m_isJson) {
+        // Unavailable values are null
+        m_output << (m_isFirstRecord ? "\n" : ",\n") << "{\"frame\":" << record.frameIndex;
+        for (size_t i = 0; i < record.cpuMilliseconds.size(); i++)
+            m_output << ",\"" << kCpuPhaseNames[i] << "_ms\":" << record.cpuMilliseconds[i];
+        for (size_t i = 0; i < scopeMilliseconds.size(); i++) {
+            m_output << ",\"" << kGpuScopeNames[i] << "_ms\":";
+            if (scopeMilliseconds[i])
+                m_output << *scopeMilliseconds[i];
+            else
+                m_output << "null";
+        }
+        for (size_t i = 0; i < size_t(EPipelineStatistic::COUNT); i++) {
+            m_output << ",\"" << kPipelineStatisticNames[i] << "\":";
+            if (pipelineStatistics)
+                m_output << (*pipelineStatistics)[i];
+            else
+                m_output << "null";
+        }
+        m_output << "}";
+    } else {
+        // Unavailable values are empty cells
+        m_output << record.frameIndex;
+        for (double milliseconds : record.cpuMilliseconds)
+            m_output << "," << milliseconds;
+        for (const auto& milliseconds : scopeMilliseconds) {
+            m_output << ",";
+            if (milliseconds)
+                m_output << *milliseconds;
+        }
+        for (size_t i = 0; i < size_t(EPipelineStatistic::COUNT); i++) {
+            m_output << ",";
+            if (pipelineStatistics)
+                m_output << (*pipelineStatistics)[i];
+        }
+        m_output << "\n";
+    }
+    m_isFirstRecord = false;
+}
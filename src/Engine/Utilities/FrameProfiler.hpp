@@ -0,0 +1,135 @@
+#pragma once
+
+#include "pch.hpp"
+
+#include <atomic>
+
+namespace Utility {
+
+enum class ECpuPhase : uint32_t {
+    Update,
+    Traverse, // Render snapshot extraction
+    Cull,
+    Record,
+    Submit, // Queue submit
+    Present, // Present, or handing the image over in headless mode
+    Readback, // Queueing SAVE frames
+    FenceWait,
+    Idle, // Main loop sleeping until the next headless event
+    COUNT,
+};
+
+enum class EGpuScope : uint32_t {
+    Frame, // The whole frame command buffer
+    MainPass, // Includes the depth pre-pass
+    DepthPrepass, // --depth-prepass only
+    COUNT,
+};
+
+// Order of the VkQueryPipelineStatisticFlagBits the GPU profiler requests, which is also the order results come back in
+enum class EPipelineStatistic : uint32_t {
+    InputAssemblyVertices,
+    InputAssemblyPrimitives,
+    VertexShaderInvocations,
+    ClippingPrimitives,
+    FragmentShaderInvocations,
+    COUNT,
+};
+
+const char* GetCpuPhaseName(ECpuPhase phase);
+
+struct GpuFrameResults {
+    std::array<std::optional<double>, size_t(EGpuScope::COUNT)> scopeMilliseconds;
+    std::optional<std::array<uint64_t, size_t(EPipelineStatistic::COUNT)>> pipelineStatistics;
+};
+
+// Per frame CPU phase timings and GPU query results, written as one record per frame to a .csv or .json file (-profile-output).
+// GPU results arrive a few frames late (they are read back without stalling once the frame completed), so records are held
+// until their GPU part is known and always written in frame order. Shutdown also prints the mean pipeline statistics of the run,
+// e.g. to compare the shaded fragments (fs_invocations) with and without --depth-prepass.
+class FrameProfiler {
+public:
+    FrameProfiler(const FrameProfiler&) = delete;
+    FrameProfiler& operator=(const FrameProfiler&) = delete;
+
+    static FrameProfiler& GetInstance()
+    {
+        static FrameProfiler instance;
+        return instance;
+    }
+
+    // The format follows the extension, .json or anything else for CSV
+    void Init(const std::filesystem::path& outputPath);
+    // Writes the frames still waiting for GPU results without them, prints the pipeline statistics summary
+    void Shutdown();
+
+    bool IsEnabled() const { return m_enabled; }
+    // Set by the renderer once it knows whether the device can time anything, frames are written right away otherwise
+    void SetExpectGpuResults(bool expectGpuResults) { m_expectGpuResults = expectGpuResults; }
+
+    // Thread safe, update and traversal run on a job thread in pipelined mode. Accumulates into the frame currently being rendered.
+    void AddCpuTime(ECpuPhase phase, std::chrono::steady_clock::duration duration);
+    // Closes the CPU part of the frame, render thread only
+    void EndFrame(uint64_t frameIndex);
+    // Render thread only
+    void SetGpuResults(uint64_t frameIndex, const GpuFrameResults& results);
+
+private:
+    FrameProfiler() = default;
+
+    struct FrameRecord {
+        uint64_t frameIndex;
+        std::array<double, size_t(ECpuPhase::COUNT)> cpuMilliseconds;
+        std::optional<GpuFrameResults> gpu;
+    };
+
+    // Frames whose GPU results never came in are dropped from the wait list after this many newer frames
+    static constexpr size_t kMaxPendingFrames = 16;
+
+    void WriteReadyRecords(uint64_t completedFrameIndex);
+    void WriteRecord(const FrameRecord& record);
+
+private:
+    bool m_enabled = false;
+    bool m_expectGpuResults = false;
+    bool m_isJson = false;
+    bool m_isFirstRecord = true;
+    std::ofstream m_output;
+
+    std::array<std::atomic<int64_t>, size_t(ECpuPhase::COUNT)> m_cpuNanoseconds {};
+    std::deque<FrameRecord> m_pendingRecords;
+
+    std::array<uint64_t, size_t(EPipelineStatistic::COUNT)> m_statisticsSums {};
+    uint64_t m_statisticsFrameCount = 0;
+};
+
+// Whether the frame profiler or the frame metrics (see Metrics.hpp) take CPU phase timings
+bool IsCpuTimingEnabled();
+// Hands a phase timing to whichever of them is enabled, thread safe
+void RecordCpuTime(ECpuPhase phase, std::chrono::steady_clock::duration duration);
+
+// Adds the lifetime of the object to a CPU phase of the current frame, costs nothing when profiling is off
+class ScopedCpuTimer {
+public:
+    explicit ScopedCpuTimer(ECpuPhase phase)
+        : m_phase(phase)
+        , m_enabled(IsCpuTimingEnabled())
+    {
+        if (m_enabled)
+            m_start = std::chrono::steady_clock::now();
+    }
+    ~ScopedCpuTimer()
+    {
+        if (m_enabled)
+            RecordCpuTime(m_phase, std::chrono::steady_clock::now() - m_start);
+    }
+    ScopedCpuTimer(const ScopedCpuTimer&) = delete;
+    ScopedCpuTimer& operator=(const ScopedCpuTimer&) = delete;
+
+private:
+    ECpuPhase m_phase;
+    bool m_enabled;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+} // namespace Utility
@@ -0,0 +1,263 @@
+#include "FrameSinks.hpp"
+#include "Utilities/lambertian/load_save_png.hpp"
+
+#if defined(__SSSE3__) || defined(__AVX__)
+#include <tmmintrin.h>
+#define FRAME_SINKS_SSSE3 1
+#endif
+
+using namespace Utility;
+
+void Utility::SwizzleBGRAToRGB(const uint8_t* pSrc, uint8_t* pDst, size_t pixelCount)
+{
+    size_t i = 0;
+#if FRAME_SINKS_SSSE3
+    // 4 pixels per iteration. The 16 byte store writes 4 bytes past the 12 RGB bytes, which the next iteration overwrites, so stop
+    // while at least 6 pixels are left to stay inside pDst.
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    for (; i + 6 <= pixelCount; i += 4) {
+        __m128i bgra = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i * 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i * 3), _mm_shuffle_epi8(bgra, shuffle));
+    }
+#endif
+    for (; i < pixelCount; i++) {
+        pDst[i * 3 + 0] = pSrc[i * 4 + 2];
+        pDst[i * 3 + 1] = pSrc[i * 4 + 1];
+        pDst[i * 3 + 2] = pSrc[i * 4 + 0];
+    }
+}
+
+void Utility::SwizzleBGRAToRGBA(const uint8_t* pSrc, uint8_t* pDst, size_t pixelCount)
+{
+    size_t i = 0;
+#if FRAME_SINKS_SSSE3
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    const __m128i opaque = _mm_set1_epi32(static_cast<int>(0xff000000u));
+    for (; i + 4 <= pixelCount; i += 4) {
+        __m128i bgra = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i * 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i * 4), _mm_or_si128(_mm_shuffle_epi8(bgra, shuffle), opaque));
+    }
+#endif
+    for (; i < pixelCount; i++) {
+        pDst[i * 4 + 0] = pSrc[i * 4 + 2];
+        pDst[i * 4 + 1] = pSrc[i * 4 + 1];
+        pDst[i * 4 + 2] = pSrc[i * 4 + 0];
+        pDst[i * 4 + 3] = 255;
+    }
+}
+
+// https://qoiformat.org/qoi-specification.pdf, 3 channels since the frames are opaque
+std::vector<uint8_t> Utility::EncodeQOI(const FrameView& frame)
+{
+    constexpr uint8_t QOI_OP_INDEX = 0x00;
+    constexpr uint8_t QOI_OP_DIFF = 0x40;
+    constexpr uint8_t QOI_OP_LUMA = 0x80;
+    constexpr uint8_t QOI_OP_RUN = 0xc0;
+    constexpr uint8_t QOI_OP_RGB = 0xfe;
+
+    struct Pixel {
+        uint8_t r, g, b, a;
+        bool operator==(const Pixel&) const = default;
+    };
+
+    size_t pixelCount = size_t(frame.width) * frame.height;
+    std::vector<uint8_t> bytes;
+    bytes.reserve(14 + pixelCount * 4 + 8); // Worst case is one QOI_OP_RGB per pixel
+
+    auto pushBigEndian = [&bytes](uint32_t value) {
+        for (int shift = 24; shift >= 0; shift -= 8)
+            bytes.push_back(static_cast<uint8_t>(value >> shift));
+    };
+    bytes.insert(bytes.end(), { 'q', 'o', 'i', 'f' });
+    pushBigEndian(frame.width);
+    pushBigEndian(frame.height);
+    bytes.push_back(3); // channels
+    bytes.push_back(0); // sRGB with linear alpha
+
+    std::array<Pixel, 64> index {};
+    Pixel previous { 0, 0, 0, 255 };
+    uint32_t run = 0;
+    for (size_t i = 0; i < pixelCount; i++) {
+        const uint8_t* pBGRA = frame.pBGRA + i * 4;
+        Pixel pixel { pBGRA[2], pBGRA[1], pBGRA[0], 255 };
+
+        if (pixel == previous) {
+            run++;
+            if (run == 62 || i + 1 == pixelCount) {
+                bytes.push_back(static_cast<uint8_t>(QOI_OP_RUN | (run - 1)));
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0) {
+            bytes.push_back(static_cast<uint8_t>(QOI_OP_RUN | (run - 1)));
+            run = 0;
+        }
+
+        uint32_t hash = (pixel.r * 3 + pixel.g * 5 + pixel.b * 7 + pixel.a * 11) % 64;
+        if (index[hash] == pixel) {
+            bytes.push_back(static_cast<uint8_t>(QOI_OP_INDEX | hash));
+        } else {
+            index[hash] = pixel;
+
+            int8_t dr = static_cast<int8_t>(pixel.r - previous.r);
+            int8_t dg = static_cast<int8_t>(pixel.g - previous.g);
+            int8_t db = static_cast<int8_t>(pixel.b - previous.b);
+            int8_t drg = static_cast<int8_t>(dr - dg);
+            int8_t dbg = static_cast<int8_t>(db - dg);
+
+            if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                bytes.push_back(static_cast<uint8_t>(QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+            } else if (drg >= -8 && drg <= 7 && dg >= -32 && dg <= 31 && dbg >= -8 && dbg <= 7) {
+                bytes.push_back(static_cast<uint8_t>(QOI_OP_LUMA | (dg + 32)));
+                bytes.push_back(static_cast<uint8_t>((drg + 8) << 4 | (dbg + 8)));
+            } else {
+                bytes.insert(bytes.end(), { QOI_OP_RGB, pixel.r, pixel.g, pixel.b });
+            }
+        }
+        previous = pixel;
+    }
+
+    bytes.insert(bytes.end(), { 0, 0, 0, 0, 0, 0, 0, 1 });
+    return bytes;
+}
+
+static void WriteFile(const std::filesystem::path& path, std::initializer_list<std::pair<const void*, size_t>> parts)
+{
+    std::ofstream file(path, std::ios::out | std::ios::binary);
+    if (!file) {
+        std::cerr << "FrameSinks: failed to open " << path.string() << " for writing" << std::endl;
+        return;
+    }
+    for (auto [pData, size] : parts)
+        file.write(static_cast<const char*>(pData), size);
+    if (!file)
+        std::cerr << "FrameSinks: failed to write " << path.string() << std::endl;
+}
+
+void ImageFrameSink::Write(uint64_t /*sequence*/, const FrameView& frame)
+{
+    size_t pixelCount = size_t(frame.width) * frame.height;
+    switch (m_format) {
+    case EImageFormat::PPM: {
+        std::vector<uint8_t> rgb(pixelCount * 3);
+        SwizzleBGRAToRGB(frame.pBGRA, rgb.data(), pixelCount);
+        std::string header = "P6\n" + std::to_string(frame.width) + " " + std::to_string(frame.height) + "\n255\n";
+        WriteFile(m_path, { { header.data(), header.size() }, { rgb.data(), rgb.size() } });
+        break;
+    }
+    case EImageFormat::QOI: {
+        std::vector<uint8_t> qoi = EncodeQOI(frame);
+        WriteFile(m_path, { { qoi.data(), qoi.size() } });
+        break;
+    }
+    case EImageFormat::PNG: {
+        std::vector<uint8_t> rgba(pixelCount * 4);
+        SwizzleBGRAToRGBA(frame.pBGRA, rgba.data(), pixelCount);
+        save_png(m_path.string(), glm::uvec2(frame.width, frame.height), reinterpret_cast<const glm::u8vec4*>(rgba.data()), UpperLeftOrigin);
+        break;
+    }
+    }
+}
+
+void StreamFrameSink::Write(uint64_t sequence, const FrameView& frame)
+{
+    // Convert outside the lock, frames of one stream are encoded in parallel
+    size_t pixelCount = size_t(frame.width) * frame.height;
+    std::vector<uint8_t> encodedFrame;
+    switch (m_format) {
+    case EStreamFormat::Y4M: {
+        static constexpr char kFrameHeader[] = "FRAME\n";
+        constexpr size_t headerSize = sizeof(kFrameHeader) - 1;
+        encodedFrame.resize(headerSize + pixelCount * 3);
+        std::memcpy(encodedFrame.data(), kFrameHeader, headerSize);
+        uint8_t* pY = encodedFrame.data() + headerSize;
+        uint8_t* pU = pY + pixelCount;
+        uint8_t* pV = pU + pixelCount;
+        // BT.601 limited range, the Y4M default
+        for (size_t i = 0; i < pixelCount; i++) {
+            int b = frame.pBGRA[i * 4 + 0];
+            int g = frame.pBGRA[i * 4 + 1];
+            int r = frame.pBGRA[i * 4 + 2];
+            pY[i] = static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+            pU[i] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            pV[i] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+        break;
+    }
+    case EStreamFormat::RGB:
+        encodedFrame.resize(pixelCount * 3);
+        SwizzleBGRAToRGB(frame.pBGRA, encodedFrame.data(), pixelCount);
+        break;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_width == 0) {
+        m_width = frame.width;
+        m_height = frame.height;
+    } else if (frame.width != m_width || frame.height != m_height) {
+        std::cerr << "FrameSinks: " << m_path.string() << " is " << m_width << "x" << m_height << ", dropping a " << frame.width << "x" << frame.height << " frame" << std::endl;
+        encodedFrame.clear(); // Still takes its place in the sequence
+    }
+    Place(sequence, std::move(encodedFrame));
+}
+
+void StreamFrameSink::Skip(uint64_t sequence)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Place(sequence, {});
+}
+
+void StreamFrameSink::Place(uint64_t sequence, std::vector<uint8_t> encodedFrame)
+{
+    if (sequence != m_nextSequence) {
+        m_outOfOrderFrames.emplace(sequence, std::move(encodedFrame));
+        return;
+    }
+    Append(encodedFrame);
+    m_nextSequence++;
+    for (auto it = m_outOfOrderFrames.begin(); it != m_outOfOrderFrames.end() && it->first == m_nextSequence; it = m_outOfOrderFrames.erase(it)) {
+        Append(it->second);
+        m_nextSequence++;
+    }
+}
+
+void StreamFrameSink::Append(const std::vector<uint8_t>& encodedFrame)
+{
+    if (encodedFrame.empty())
+        return;
+
+    if (!m_file.is_open()) {
+        m_file.open(m_path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!m_file) {
+            std::cerr << "FrameSinks: failed to open " << m_path.string() << " for writing" << std::endl;
+            return;
+        }
+        if (m_format == EStreamFormat::Y4M) {
+            // The frame rate is nominal, headless frames are captured at event times
+            m_file << "YUV4MPEG2 W" << m_width << " H" << m_height << " F60:1 Ip A1:1 C444\n";
+        }
+    }
+    m_file.write(reinterpret_cast<const char*>(encodedFrame.data()), encodedFrame.size());
+}
+
+FrameSinkTicket FrameSinks::Open(const std::string& savePath)
+{
+    std::filesystem::path path(savePath);
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    if (extension == ".y4m" || extension == ".rgb") {
+        auto& stream = m_streams[savePath];
+        if (!stream)
+            stream = std::make_shared<StreamFrameSink>(path, extension == ".y4m" ? EStreamFormat::Y4M : EStreamFormat::RGB);
+        return FrameSinkTicket { .sink = stream, .sequence = stream->ReserveSequence() };
+    }
+
+    EImageFormat format = EImageFormat::PPM;
+    if (extension == ".qoi")
+        format = EImageFormat::QOI;
+    else if (extension == ".png")
+        format = EImageFormat::PNG;
+    return FrameSinkTicket { .sink = std::make_shared<ImageFrameSink>(path, format) };
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "pch.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+namespace Utility {
+
+// A captured frame as it comes out of the readback ring: tightly packed BGRA rows, top row first
+struct FrameView {
+    const uint8_t* pBGRA;
+    uint32_t width;
+    uint32_t height;
+};
+
+// Destination of captured frames, picked by the extension of the SAVE path (see FrameSinks::Open).
+// Write() runs on writer jobs, several frames of the same sink may be written at the same time.
+class IFrameSink {
+public:
+    virtual ~IFrameSink() = default;
+
+    // sequence is the order the frame was requested in, sinks that append to one file write frames in that order
+    virtual void Write(uint64_t sequence, const FrameView& frame) = 0;
+    // The frame of sequence will never be written, e.g. its readback failed
+    virtual void Skip(uint64_t sequence) { }
+};
+
+// Single image per SAVE event
+enum class EImageFormat {
+    PPM,
+    QOI,
+    PNG,
+};
+
+class ImageFrameSink : public IFrameSink {
+public:
+    ImageFrameSink(std::filesystem::path path, EImageFormat format)
+        : m_path(std::move(path))
+        , m_format(format)
+    {
+    }
+    void Write(uint64_t sequence, const FrameView& frame) override;
+
+private:
+    std::filesystem::path m_path;
+    EImageFormat m_format;
+};
+
+// Every SAVE event with the same path appends a frame to one file
+enum class EStreamFormat {
+    Y4M, // YUV4MPEG2, 4:4:4 BT.601
+    RGB, // Headerless rgb24, e.g. ffmpeg -f rawvideo -pixel_format rgb24 -video_size WxH
+};
+
+class StreamFrameSink : public IFrameSink {
+public:
+    StreamFrameSink(std::filesystem::path path, EStreamFormat format)
+        : m_path(std::move(path))
+        , m_format(format)
+    {
+    }
+    void Write(uint64_t sequence, const FrameView& frame) override;
+    void Skip(uint64_t sequence) override;
+
+    // Main thread, the sequence of the next requested frame
+    uint64_t ReserveSequence() { return m_requestedFrames++; }
+
+private:
+    // Expects m_mutex to be held. Appends the frame, or keeps it until its predecessors are there; empty frames only take their place.
+    void Place(uint64_t sequence, std::vector<uint8_t> encodedFrame);
+    void Append(const std::vector<uint8_t>& encodedFrame);
+
+private:
+    std::filesystem::path m_path;
+    EStreamFormat m_format;
+    uint64_t m_requestedFrames = 0;
+
+    std::mutex m_mutex;
+    std::ofstream m_file;
+    uint32_t m_width = 0; // Of the first frame, later frames must match
+    uint32_t m_height = 0;
+    uint64_t m_nextSequence = 0;
+    std::map<uint64_t, std::vector<uint8_t>> m_outOfOrderFrames; // Encoded frames waiting for their predecessors
+};
+
+struct FrameSinkTicket {
+    std::shared_ptr<IFrameSink> sink;
+    uint64_t sequence = 0;
+};
+
+// Maps SAVE paths to sinks: .qoi and .png write one image each, .y4m and .rgb append to a stream, anything else is PPM
+class FrameSinks {
+public:
+    // Main thread
+    FrameSinkTicket Open(const std::string& savePath);
+    // Closes the streams, all writes must have finished
+    void CloseAll() { m_streams.clear(); }
+
+private:
+    std::unordered_map<std::string, std::shared_ptr<StreamFrameSink>> m_streams;
+};
+
+// Pixel conversions of captured frames, SSSE3 when the compiler targets it. RGBA output has an opaque alpha.
+void SwizzleBGRAToRGB(const uint8_t* pSrc, uint8_t* pDst, size_t pixelCount);
+void SwizzleBGRAToRGBA(const uint8_t* pSrc, uint8_t* pDst, size_t pixelCount);
+std::vector<uint8_t> EncodeQOI(const FrameView& frame);
+
+} // namespace Utility
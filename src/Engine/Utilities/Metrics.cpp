@@ -0,0 +1,247 @@
+#include "Metrics.hpp"
+
+#include <bit>
+#include <cmath>
+
+using namespace Utility;
+
+uint32_t LogHistogram::GetBucketIndex(uint64_t value)
+{
+    if (value < kSubBucketCount)
+        return static_cast<uint32_t>(value);
+    uint32_t shift = static_cast<uint32_t>(std::bit_width(value)) - 1 - kSubBucketBits;
+    return (shift + 1) * kSubBucketCount + static_cast<uint32_t>(value >> shift) - kSubBucketCount;
+}
+
+uint64_t LogHistogram::GetBucketValue(uint32_t index)
+{
+    if (index < kSubBucketCount)
+        return index;
+    uint32_t shift = index / kSubBucketCount - 1;
+    uint64_t lower = uint64_t(kSubBucketCount + index % kSubBucketCount) << shift;
+    return lower + ((uint64_t(1) << shift) >> 1);
+}
+
+void LogHistogram::Record(uint64_t value)
+{
+    m_counts[GetBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t min = m_min.load(std::memory_order_relaxed);
+    while (value < min && !m_min.compare_exchange_weak(min, value, std::memory_order_relaxed)) { }
+    uint64_t max = m_max.load(std::memory_order_relaxed);
+    while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed)) { }
+}
+
+void LogHistogram::Add(const LogHistogram& other)
+{
+    if (other.GetCount() == 0)
+        return;
+    for (uint32_t i = 0; i < kBucketCount; i++)
+        m_counts[i].fetch_add(other.m_counts[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_count.fetch_add(other.GetCount(), std::memory_order_relaxed);
+    m_sum.fetch_add(other.m_sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_min.store(std::min(m_min.load(std::memory_order_relaxed), other.m_min.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+    m_max.store(std::max(GetMax(), other.GetMax()), std::memory_order_relaxed);
+}
+
+void LogHistogram::Reset()
+{
+    for (auto& count : m_counts)
+        count.store(0, std::memory_order_relaxed);
+    m_count.store(0, std::memory_order_relaxed);
+    m_sum.store(0, std::memory_order_relaxed);
+    m_min.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+double LogHistogram::GetMean() const
+{
+    uint64_t count = GetCount();
+    return count ? double(m_sum.load(std::memory_order_relaxed)) / count : 0.0;
+}
+
+double LogHistogram::GetStdDev() const
+{
+    uint64_t count = GetCount();
+    if (count == 0)
+        return 0.0;
+    double mean = GetMean();
+    double sumOfSquaredDifferences = 0.0;
+    for (uint32_t i = 0; i < kBucketCount; i++) {
+        uint64_t bucketCount = m_counts[i].load(std::memory_order_relaxed);
+        if (bucketCount == 0)
+            continue;
+        double difference = double(GetBucketValue(i)) - mean;
+        sumOfSquaredDifferences += bucketCount * difference * difference;
+    }
+    return std::sqrt(sumOfSquaredDifferences / count);
+}
+
+uint64_t LogHistogram::GetPercentile(double percentile) const
+{
+    uint64_t count = GetCount();
+    if (count == 0)
+        return 0;
+    uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(percentile / 100.0 * count)));
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < kBucketCount; i++) {
+        seen += m_counts[i].load(std::memory_order_relaxed);
+        if (seen >= target)
+            return std::clamp(GetBucketValue(i), GetMin(), GetMax());
+    }
+    return GetMax();
+}
+
+void FrameMetrics::Histograms::Add(const Histograms& other)
+{
+    frame.Add(other.frame);
+    for (size_t i = 0; i < phases.size(); i++)
+        phases[i].Add(other.phases[i]);
+}
+
+void FrameMetrics::Histograms::Reset()
+{
+    frame.Reset();
+    for (auto& phase : phases)
+        phase.Reset();
+}
+
+// Segment names come from MARK events
+static std::string EscapeJson(const std::string& text)
+{
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            escaped += ' ';
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+static std::string EscapeCsv(const std::string& text)
+{
+    if (text.find_first_of(",\"\n") == std::string::npos)
+        return text;
+    std::string escaped = "\"";
+    for (char c : text) {
+        if (c == '"')
+            escaped += '"';
+        escaped += c;
+    }
+    return escaped + "\"";
+}
+
+void FrameMetrics::Init(const std::filesystem::path& outputPath)
+{
+    m_output.open(outputPath, std::ios::trunc);
+    if (!m_output) {
+        std::cerr << "FrameMetrics: failed to open " << outputPath.string() << ", metrics are disabled" << std::endl;
+        return;
+    }
+
+    m_isJson = outputPath.extension() == ".json";
+    m_isFirstSegment = true;
+    if (m_isJson) {
+        m_output << "{\"segments\":[";
+    } else {
+        m_output << "segment,frames,fps,frame_mean_us,frame_p50_us,frame_p90_us,frame_p95_us,frame_p99_us,frame_max_us,frame_std_dev_us";
+        for (size_t i = 0; i < size_t(ECpuPhase::COUNT); i++) {
+            const char* name = GetCpuPhaseName(ECpuPhase(i));
+            m_output << "," << name << "_count," << name << "_mean_us," << name << "_p99_us";
+        }
+        m_output << "\n";
+    }
+
+    m_segmentName = "start";
+    m_segment = std::make_unique<Histograms>();
+    m_total = std::make_unique<Histograms>();
+    m_enabled = true;
+    std::cout << "FrameMetrics: writing frame statistics to " << outputPath.string() << std::endl;
+}
+
+void FrameMetrics::Shutdown()
+{
+    if (!m_enabled)
+        return;
+
+    if (m_segment->frame.GetCount() > 0)
+        WriteSegment(m_segmentName, *m_segment);
+    m_total->Add(*m_segment);
+
+    if (m_isJson) {
+        m_output << "\n],\"total\":";
+        m_isFirstSegment = true;
+        WriteSegment("total", *m_total);
+        m_output << "}\n";
+    } else {
+        WriteSegment("total", *m_total);
+    }
+    m_output.close();
+    m_enabled = false;
+    m_segment.reset();
+    m_total.reset();
+}
+
+void FrameMetrics::RecordFrame(std::chrono::steady_clock::duration frameTime)
+{
+    if (m_enabled)
+        m_segment->frame.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(frameTime).count());
+}
+
+void FrameMetrics::RecordCpuTime(ECpuPhase phase, std::chrono::steady_clock::duration duration)
+{
+    if (m_enabled)
+        m_segment->phases[size_t(phase)].Record(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+}
+
+void FrameMetrics::BeginSegment(const std::string& name)
+{
+    if (!m_enabled)
+        return;
+
+    // A segment without frames is not written, its phase timings still count toward the total
+    if (m_segment->frame.GetCount() > 0)
+        WriteSegment(m_segmentName, *m_segment);
+    m_total->Add(*m_segment);
+    m_segment->Reset();
+    m_segmentName = name;
+}
+
+void FrameMetrics::WriteSegment(const std::string& name, const Histograms& histograms)
+{
+    const LogHistogram& frame = histograms.frame;
+    double frameSeconds = frame.GetMean() * frame.GetCount() * 1e-9;
+    double fps = frameSeconds > 0.0 ? frame.GetCount() / frameSeconds : 0.0;
+    auto us = [](double nanoseconds) { return nanoseconds * 1e-3; };
+
+    if (m_isJson) {
+        if (!m_isFirstSegment)
+            m_output << ",";
+        m_output << "\n{\"segment\":\"" << EscapeJson(name) << "\",\"frames\":" << frame.GetCount() << ",\"fps\":" << fps
+                 << ",\"frame_us\":{\"mean\":" << us(frame.GetMean()) << ",\"p50\":" << us(frame.GetPercentile(50))
+                 << ",\"p90\":" << us(frame.GetPercentile(90)) << ",\"p95\":" << us(frame.GetPercentile(95))
+                 << ",\"p99\":" << us(frame.GetPercentile(99)) << ",\"max\":" << us(frame.GetMax())
+                 << ",\"std_dev\":" << us(frame.GetStdDev()) << "},\"phases\":{";
+        for (size_t i = 0; i < histograms.phases.size(); i++) {
+            const LogHistogram& phase = histograms.phases[i];
+            m_output << (i ? "," : "") << "\"" << GetCpuPhaseName(ECpuPhase(i)) << "\":{\"count\":" << phase.GetCount()
+                     << ",\"mean_us\":" << us(phase.GetMean()) << ",\"p99_us\":" << us(phase.GetPercentile(99)) << "}";
+        }
+        m_output << "}}";
+    } else {
+        m_output << EscapeCsv(name) << "," << frame.GetCount() << "," << fps << "," << us(frame.GetMean())
+                 << "," << us(frame.GetPercentile(50)) << "," << us(frame.GetPercentile(90)) << "," << us(frame.GetPercentile(95))
+                 << "," << us(frame.GetPercentile(99)) << "," << us(frame.GetMax()) << "," << us(frame.GetStdDev());
+        for (const auto& phase : histograms.phases)
+            m_output << "," << phase.GetCount() << "," << us(phase.GetMean()) << "," << us(phase.GetPercentile(99));
+        m_output << "\n";
+    }
+    m_isFirstSegment = false;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "FrameProfiler.hpp"
+#include "pch.hpp"
+
+#include <atomic>
+
+namespace Utility {
+
+// HDR style histogram of non-negative integers: every power of two range is split into kSubBucketCount linear buckets, so values
+// are kept to within ~3% over the whole 64 bit range in a fixed array. Record() is O(1), lock free and never allocates; a
+// percentile walks the buckets once. Reset() and Add() must not run concurrently with Record().
+class LogHistogram {
+public:
+    void Record(uint64_t value);
+    void Add(const LogHistogram& other);
+    void Reset();
+
+    uint64_t GetCount() const { return m_count.load(std::memory_order_relaxed); }
+    uint64_t GetMin() const { return GetCount() ? m_min.load(std::memory_order_relaxed) : 0; }
+    uint64_t GetMax() const { return m_max.load(std::memory_order_relaxed); }
+    double GetMean() const;
+    double GetStdDev() const; // From the bucket midpoints
+    uint64_t GetPercentile(double percentile) const; // percentile in [0, 100], 0 without values
+
+private:
+    static constexpr uint32_t kSubBucketBits = 5;
+    static constexpr uint32_t kSubBucketCount = 1u << kSubBucketBits;
+    static constexpr uint32_t kBucketCount = (64 - kSubBucketBits + 1) * kSubBucketCount;
+
+    static uint32_t GetBucketIndex(uint64_t value);
+    static uint64_t GetBucketValue(uint32_t index); // Midpoint of the bucket
+
+private:
+    std::array<std::atomic<uint64_t>, kBucketCount> m_counts {};
+    std::atomic<uint64_t> m_count { 0 };
+    std::atomic<uint64_t> m_sum { 0 };
+    std::atomic<uint64_t> m_min { std::numeric_limits<uint64_t>::max() };
+    std::atomic<uint64_t> m_max { 0 };
+};
+
+// Aggregated frame time and CPU phase statistics (-metrics-output), cheap enough to leave on: recording only bumps histogram
+// buckets. A headless MARK event closes the current segment and starts one named after the mark, so a run can be split into
+// the parts of its timeline. Each segment is written when it closes, the whole run at Shutdown. The format follows the extension,
+// .json or anything else for CSV.
+class FrameMetrics {
+public:
+    FrameMetrics(const FrameMetrics&) = delete;
+    FrameMetrics& operator=(const FrameMetrics&) = delete;
+
+    static FrameMetrics& GetInstance()
+    {
+        static FrameMetrics instance;
+        return instance;
+    }
+
+    void Init(const std::filesystem::path& outputPath);
+    void Shutdown();
+
+    bool IsEnabled() const { return m_enabled; }
+
+    // Render thread, time since the previous rendered frame
+    void RecordFrame(std::chrono::steady_clock::duration frameTime);
+    // Thread safe
+    void RecordCpuTime(ECpuPhase phase, std::chrono::steady_clock::duration duration);
+    // Main thread, between frames while no phase is timed
+    void BeginSegment(const std::string& name);
+
+private:
+    FrameMetrics() = default;
+
+    struct Histograms {
+        LogHistogram frame; // Nanoseconds
+        std::array<LogHistogram, size_t(ECpuPhase::COUNT)> phases; // Nanoseconds
+
+        void Add(const Histograms& other);
+        void Reset();
+    };
+
+    void WriteSegment(const std::string& name, const Histograms& histograms);
+
+private:
+    bool m_enabled = false;
+    bool m_isJson = false;
+    bool m_isFirstSegment = true;
+    std::ofstream m_output;
+
+    std::string m_segmentName;
+    std::unique_ptr<Histograms> m_segment; // Large, allocated once in Init
+    std::unique_ptr<Histograms> m_total;
+};
+
+} // namespace Utility
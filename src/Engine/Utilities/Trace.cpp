@@ -0,0 +1,111 @@
+#include "Trace.hpp"
+
+#include <iomanip>
+#include <iostream>
+
+using namespace Utility;
+
+void Tracer::Init(const std::filesystem::path& outputPath)
+{
+    m_output.open(outputPath, std::ios::trunc);
+    if (!m_output) {
+        std::cerr << "Tracer: failed to open " << outputPath.string() << ", tracing is disabled" << std::endl;
+        return;
+    }
+
+    m_startTime = std::chrono::steady_clock::now();
+    m_isFirstEvent = true;
+    m_output << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    s_enabled.store(true, std::memory_order_relaxed);
+    std::cout << "Tracer: writing trace events to " << outputPath.string() << std::endl;
+}
+
+void Tracer::Shutdown()
+{
+    if (!IsEnabled())
+        return;
+    s_enabled.store(false, std::memory_order_relaxed);
+
+    Flush();
+    std::lock_guard<std::mutex> lock(m_threadsMutex);
+    for (auto& pThread : m_threads) {
+        if (pThread->pChunk) {
+            WriteChunk(*pThread->pChunk);
+            delete pThread->pChunk;
+            pThread->pChunk = nullptr;
+        }
+        if (!pThread->name.empty()) {
+            m_output << (m_isFirstEvent ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << pThread->threadId
+                     << ",\"args\":{\"name\":\"" << pThread->name << "\"}}";
+            m_isFirstEvent = false;
+        }
+    }
+    m_output << "\n]}\n";
+    m_output.close();
+}
+
+void Tracer::Flush()
+{
+    Chunk* pChunk = m_fullChunks.exchange(nullptr, std::memory_order_acquire);
+    while (pChunk) {
+        Chunk* pNext = pChunk->pNext;
+        WriteChunk(*pChunk);
+        delete pChunk;
+        pChunk = pNext;
+    }
+}
+
+void Tracer::SetThreadName(const std::string& name)
+{
+    ThreadBuffer& buffer = GetThreadBuffer();
+    std::lock_guard<std::mutex> lock(m_threadsMutex);
+    buffer.name = name;
+}
+
+Tracer::ThreadBuffer& Tracer::GetThreadBuffer()
+{
+    // Buffers stay registered until the process exits, the thread keeps pointing at its own
+    thread_local ThreadBuffer* t_pBuffer = nullptr;
+    if (!t_pBuffer) {
+        std::lock_guard<std::mutex> lock(m_threadsMutex);
+        m_threads.push_back(std::make_unique<ThreadBuffer>(ThreadBuffer { .threadId = static_cast<uint32_t>(m_threads.size()) }));
+        t_pBuffer = m_threads.back().get();
+    }
+    return *t_pBuffer;
+}
+
+void Tracer::Record(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+    if (!IsEnabled())
+        return;
+
+    ThreadBuffer& buffer = GetThreadBuffer();
+    if (!buffer.pChunk)
+        buffer.pChunk = new Chunk { .threadId = buffer.threadId };
+
+    Chunk& chunk = *buffer.pChunk;
+    chunk.events[chunk.count++] = Event {
+        .name = name,
+        .startNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(start - m_startTime).count(),
+        .durationNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(),
+    };
+
+    if (chunk.count == Chunk::kCapacity) {
+        Chunk* pHead = m_fullChunks.load(std::memory_order_relaxed);
+        do {
+            chunk.pNext = pHead;
+        } while (!m_fullChunks.compare_exchange_weak(pHead, &chunk, std::memory_order_release, std::memory_order_relaxed));
+        buffer.pChunk = nullptr;
+    }
+}
+
+void Tracer::WriteChunk(const Chunk& chunk)
+{
+    // Complete events, timestamps in microseconds
+    for (uint32_t i = 0; i < chunk.count; i++) {
+        const Event& event = chunk.events[i];
+        m_output << (m_isFirstEvent ? "\n" : ",\n") << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << chunk.threadId
+                 << ",\"ts\":" << event.startNanoseconds * 1e-3 << ",\"dur\":" << event.durationNanoseconds * 1e-3 << "}";
+        m_isFirstEvent = false;
+    }
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+// Standard headers only, the zones are also used in sources that do not include the precompiled header (blur_cube)
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Build with -DUSE_TRACE=0 to compile the zones out
+#ifndef USE_TRACE
+#define USE_TRACE 1
+#endif
+
+namespace Utility {
+
+// Scoped zones written as Chrome trace events (-trace out.json), open the file in https://ui.perfetto.dev or chrome://tracing.
+// Every thread appends its zones to its own fixed size chunks; a full chunk is pushed onto a lock-free list that the main thread
+// drains to the file once per frame (Flush), so recording never takes a lock. Disabled at runtime a zone costs one relaxed atomic
+// load, with USE_TRACE 0 the macros compile to nothing. Zone names must outlive the tracer, e.g. string literals.
+class Tracer {
+public:
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    static Tracer& GetInstance()
+    {
+        static Tracer instance;
+        return instance;
+    }
+
+    static bool IsEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    void Init(const std::filesystem::path& outputPath);
+    // Every other thread must have stopped recording, writes what is left and closes the file
+    void Shutdown();
+    // Main thread, writes the full chunks
+    void Flush();
+
+    // Names the calling thread in the trace
+    void SetThreadName(const std::string& name);
+    void Record(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+
+private:
+    Tracer() = default;
+
+    struct Event {
+        const char* name;
+        int64_t startNanoseconds; // Since Init
+        int64_t durationNanoseconds;
+    };
+
+    struct Chunk {
+        static constexpr uint32_t kCapacity = 4096;
+        std::array<Event, kCapacity> events;
+        uint32_t count = 0;
+        uint32_t threadId = 0;
+        Chunk* pNext = nullptr; // In the list of full chunks
+    };
+
+    struct ThreadBuffer {
+        uint32_t threadId;
+        std::string name;
+        Chunk* pChunk = nullptr;
+    };
+
+    ThreadBuffer& GetThreadBuffer();
+    void WriteChunk(const Chunk& chunk);
+
+private:
+    static inline std::atomic<bool> s_enabled { false };
+
+    std::chrono::steady_clock::time_point m_startTime;
+    std::ofstream m_output;
+    bool m_isFirstEvent = true;
+
+    std::atomic<Chunk*> m_fullChunks { nullptr };
+
+    std::mutex m_threadsMutex; // Only taken the first time a thread records
+    std::vector<std::unique_ptr<ThreadBuffer>> m_threads;
+};
+
+class TraceZone {
+public:
+    explicit TraceZone(const char* name)
+        : m_name(Tracer::IsEnabled() ? name : nullptr)
+    {
+        if (m_name)
+            m_start = std::chrono::steady_clock::now();
+    }
+    ~TraceZone()
+    {
+        if (m_name)
+            Tracer::GetInstance().Record(m_name, m_start, std::chrono::steady_clock::now());
+    }
+    TraceZone(const TraceZone&) = delete;
+    TraceZone& operator=(const TraceZone&) = delete;
+
+private:
+    const char* m_name;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+} // namespace Utility
+
+#if USE_TRACE
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_ZONE(name) Utility::TraceZone TRACE_CONCAT(traceZone, __LINE__)(name)
+#else
+#define TRACE_ZONE(name) ((void)0)
+#endif
@@ -1,11 +1,12 @@
 #include "blur_cube.h"
 #include "load_save_png.hpp"
 #include "rgbe.hpp"
+#include "Threading/JobSystem.hpp"
+#include "Utilities/Trace.hpp"
 
 #include <algorithm>
 #include <functional>
 #include <iostream>
-#include <random>
 #define M_PI 3.14159265358979323846f
 
 void save_tone_mapped_png(std::string const& filename, glm::uvec2 size, std::vector<glm::vec3> const& data)
@@ -42,24 +43,162 @@ enum Face {
     NegativeZ = 5,
 };
 
+// See OpenGL 4.4 Core Profile specification, Table 8.18:
+static void face_axes(uint32_t f, glm::vec3& sc, glm::vec3& tc, glm::vec3& ma)
+{
+    // sc maps to rightward axis on face, tc to upward axis on face, ma is the direction to face
+    if (f == PositiveX) {
+        sc = glm::vec3(0.0f, 0.0f, -1.0f);
+        tc = glm::vec3(0.0f, -1.0f, 0.0f);
+        ma = glm::vec3(1.0f, 0.0f, 0.0f);
+    } else if (f == NegativeX) {
+        sc = glm::vec3(0.0f, 0.0f, 1.0f);
+        tc = glm::vec3(0.0f, -1.0f, 0.0f);
+        ma = glm::vec3(-1.0f, 0.0f, 0.0f);
+    } else if (f == PositiveY) {
+        sc = glm::vec3(1.0f, 0.0f, 0.0f);
+        tc = glm::vec3(0.0f, 0.0f, 1.0f);
+        ma = glm::vec3(0.0f, 1.0f, 0.0f);
+    } else if (f == NegativeY) {
+        sc = glm::vec3(1.0f, 0.0f, 0.0f);
+        tc = glm::vec3(0.0f, 0.0f, -1.0f);
+        ma = glm::vec3(0.0f, -1.0f, 0.0f);
+    } else if (f == PositiveZ) {
+        sc = glm::vec3(1.0f, 0.0f, 0.0f);
+        tc = glm::vec3(0.0f, -1.0f, 0.0f);
+        ma = glm::vec3(0.0f, 0.0f, 1.0f);
+    } else if (f == NegativeZ) {
+        sc = glm::vec3(-1.0f, 0.0f, 0.0f);
+        tc = glm::vec3(0.0f, -1.0f, 0.0f);
+        ma = glm::vec3(0.0f, 0.0f, -1.0f);
+    } else
+        assert(0 && "Invalid face.");
+}
+
+// Counter based random numbers in [0, 1): the value only depends on (texel, sample), so the output is the same for any
+// thread count and order the texels are processed in. splitmix64 finalizer over both counters.
+static glm::vec2 sample_random(uint32_t texel, uint32_t sample)
+{
+    uint64_t x = ((uint64_t(texel) << 32) | sample) + 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    constexpr float Scale = 1.0f / float(1u << 24);
+    return glm::vec2(float(x >> 40) * Scale, float((x >> 16) & 0xffffff) * Scale);
+}
+
+struct BrightDirection {
+    glm::vec3 direction = glm::vec3(0.0f);
+    glm::vec3 light = glm::vec3(0.0f); // already multiplied by solid angle, I guess?
+};
+
+// Node of a bounding cone hierarchy over the bright directions. The sums let a cluster that lies entirely on one side of the
+// boundary of the lighting function be summed at once, without an approximation: sum(light) where the function is one and
+// sum(light * dot(direction, n)) = moment_x * n.x + moment_y * n.y + moment_z * n.z where it is the cosine.
+struct BrightCluster {
+    glm::vec3 axis = glm::vec3(0.0f);
+    float angle = 0.0f; // every direction of the cluster is within this angle of axis
+    glm::vec3 light = glm::vec3(0.0f);
+    glm::vec3 moment_x = glm::vec3(0.0f);
+    glm::vec3 moment_y = glm::vec3(0.0f);
+    glm::vec3 moment_z = glm::vec3(0.0f);
+    uint32_t begin = 0, end = 0; // range of the directions, ordered by the build
+    uint32_t second = 0; // index of the second child, the first directly follows the node; 0 for leaves
+};
+
+static float angle_between(glm::vec3 const& a, glm::vec3 const& b)
+{
+    // accurate for small angles too, unlike acos of the dot product
+    return std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b));
+}
+
+// Splits [begin, end) at the median of the coordinate the directions spread most along, until at most LeafSize are left
+static uint32_t build_bright_clusters(std::vector<BrightDirection>& directions, uint32_t begin, uint32_t end, std::vector<BrightCluster>& clusters)
+{
+    constexpr uint32_t LeafSize = 8;
+    constexpr float AnglePadding = 1.0e-5f; // rounding of the angles below
+
+    BrightCluster cluster;
+    cluster.begin = begin;
+    cluster.end = end;
+    glm::vec3 lo = directions[begin].direction, hi = lo, mean = glm::vec3(0.0f);
+    for (uint32_t i = begin; i < end; ++i) {
+        BrightDirection const& bd = directions[i];
+        lo = glm::vec3(std::min(lo.x, bd.direction.x), std::min(lo.y, bd.direction.y), std::min(lo.z, bd.direction.z));
+        hi = glm::vec3(std::max(hi.x, bd.direction.x), std::max(hi.y, bd.direction.y), std::max(hi.z, bd.direction.z));
+        mean += bd.direction;
+        cluster.light += bd.light;
+        cluster.moment_x += bd.light * bd.direction.x;
+        cluster.moment_y += bd.light * bd.direction.y;
+        cluster.moment_z += bd.light * bd.direction.z;
+    }
+    cluster.axis = glm::length(mean) > 1.0e-6f ? glm::normalize(mean) : directions[begin].direction;
+    for (uint32_t i = begin; i < end; ++i) {
+        cluster.angle = std::max(cluster.angle, angle_between(cluster.axis, directions[i].direction));
+    }
+    cluster.angle += AnglePadding;
+
+    uint32_t index = uint32_t(clusters.size());
+    clusters.emplace_back(cluster);
+    if (end - begin > LeafSize) {
+        glm::vec3 extent = hi - lo;
+        int split = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+        uint32_t mid = begin + (end - begin) / 2;
+        std::nth_element(directions.begin() + begin, directions.begin() + mid, directions.begin() + end, [split](BrightDirection const& a, BrightDirection const& b) {
+            return a.direction[split] < b.direction[split];
+        });
+        build_bright_clusters(directions, begin, mid, clusters);
+        uint32_t second = build_bright_clusters(directions, mid, end, clusters);
+        clusters[index].second = second;
+    }
+    return index;
+}
+
+// Calls inside for the clusters entirely within boundary (an angle) of n and leaf for every direction of the leaves the boundary
+// passes through, clusters entirely outside are skipped. The margin keeps rounding from putting a direction on the wrong side.
+template <typename Inside, typename Leaf>
+static void visit_bright_clusters(std::vector<BrightCluster> const& clusters, std::vector<BrightDirection> const& directions, glm::vec3 const& n, float boundary, Inside const& inside, Leaf const& leaf)
+{
+    constexpr float Margin = 1.0e-4f;
+    if (clusters.empty())
+        return;
+
+    uint32_t stack[64]; // the median splits keep the depth at log2 of the direction count
+    uint32_t stack_size = 0;
+    stack[stack_size++] = 0;
+    while (stack_size > 0) {
+        uint32_t index = stack[--stack_size];
+        BrightCluster const& cluster = clusters[index];
+        float alpha = angle_between(cluster.axis, n);
+        if (alpha - cluster.angle > boundary + Margin)
+            continue;
+        if (alpha + cluster.angle < boundary - Margin) {
+            inside(cluster);
+        } else if (cluster.second == 0) {
+            for (uint32_t i = cluster.begin; i < cluster.end; ++i) {
+                leaf(directions[i]);
+            }
+        } else {
+            stack[stack_size++] = cluster.second;
+            stack[stack_size++] = index + 1;
+        }
+    }
+}
+
 // Borrowed from blur_cube.cpp: https://github.com/ixchow/15-466-ibl/blob/master/cubes/blur_cube.cpp
 void blur_cube(std::string mode, glm::ivec2& out_size, int32_t& samples, std::string& in_file, int32_t brightest, std::string out_file)
 {
-    struct BrightDirection {
-        glm::vec3 direction = glm::vec3(0.0f);
-        glm::vec3 light = glm::vec3(0.0f); // already multiplied by solid angle, I guess?
-    };
+    TRACE_ZONE("blur_cube");
     std::vector<BrightDirection> bright_directions;
+    std::vector<BrightCluster> bright_clusters;
 
-    std::function<glm::vec3()> make_sample; // returns an upper hemisphere direction
+    std::function<glm::vec3(glm::vec2)> make_sample; // returns an upper hemisphere direction for a pair of uniform random numbers
     std::function<glm::vec3(glm::vec3)> sum_bright_directions; // run lighting for bright directions, given normal
 
     if (mode == "diffuse") {
-        make_sample = []() -> glm::vec3 {
+        make_sample = [](glm::vec2 rv) -> glm::vec3 {
             // attempt to importance sample upper hemisphere (cos-weighted):
             // based on: http://www.rorydriscoll.com/2009/01/07/better-sampling/
-            static std::mt19937 mt(0x12341234);
-            glm::vec2 rv(mt() / float(mt.max()), mt() / float(mt.max()));
             float phi = rv.x * 2.0f * M_PI;
             float r = std::sqrt(rv.y);
             return glm::vec3(
@@ -67,21 +206,20 @@ void blur_cube(std::string mode, glm::ivec2& out_size, int32_t& samples, std::st
                 std::sin(phi) * r,
                 std::sqrt(1.0f - rv.y));
         };
-        sum_bright_directions = [&bright_directions](glm::vec3 n) -> glm::vec3 {
+        sum_bright_directions = [&bright_directions, &bright_clusters](glm::vec3 n) -> glm::vec3 {
             glm::vec3 ret = glm::vec3(0.0f);
-            for (auto const& bd : bright_directions) {
-                ret += std::max(0.0f, glm::dot(bd.direction, n)) * bd.light;
-            }
+            visit_bright_clusters(
+                bright_clusters, bright_directions, n, 0.5f * M_PI,
+                [&](BrightCluster const& cluster) { ret += cluster.moment_x * n.x + cluster.moment_y * n.y + cluster.moment_z * n.z; },
+                [&](BrightDirection const& bd) { ret += std::max(0.0f, glm::dot(bd.direction, n)) * bd.light; });
             return ret;
         };
     } else if (mode == "bokeh") {
         constexpr float angle = 0.7f / 180.0f * float(M_PI);
         float max_r = std::sin(angle);
         float min_y = std::sqrt(1.0f - max_r * max_r);
-        make_sample = [min_y]() -> glm::vec3 {
+        make_sample = [min_y](glm::vec2 rv) -> glm::vec3 {
             // try to uniformly sample a disc...
-            static std::mt19937 mt(0x12341234);
-            glm::vec2 rv(mt() / float(mt.max()), mt() / float(mt.max()));
             float phi = rv.x * 2.0f * M_PI;
             // float r = max_r * std::sqrt(rv.y);
             rv.y = min_y + (1.0f - min_y) * rv.y;
@@ -92,17 +230,20 @@ void blur_cube(std::string mode, glm::ivec2& out_size, int32_t& samples, std::st
                 rv.y);
         };
         float thresh = std::cos(angle); // hmmmmmmm
-        sum_bright_directions = [&bright_directions, thresh](glm::vec3 n) -> glm::vec3 {
+        sum_bright_directions = [&bright_directions, &bright_clusters, angle, thresh](glm::vec3 n) -> glm::vec3 {
             glm::vec3 ret = glm::vec3(0.0f);
-            for (auto const& bd : bright_directions) {
-                if (glm::dot(bd.direction, n) > thresh) {
-                    ret += bd.light;
-                }
-            }
+            visit_bright_clusters(
+                bright_clusters, bright_directions, n, angle,
+                [&](BrightCluster const& cluster) { ret += cluster.light; },
+                [&](BrightDirection const& bd) {
+                    if (glm::dot(bd.direction, n) > thresh) {
+                        ret += bd.light;
+                    }
+                });
             return ret;
         };
     } else if (mode == "sharp") {
-        make_sample = []() -> glm::vec3 {
+        make_sample = [](glm::vec2) -> glm::vec3 {
             return glm::vec3(0.0f, 0.0f, 1.0f);
         };
     } else {
@@ -152,43 +293,16 @@ void blur_cube(std::string mode, glm::ivec2& out_size, int32_t& samples, std::st
         for (auto const& px : in_data) {
             pixels.emplace_back(std::max(px.r, std::max(px.g, px.b)), pixels.size());
         }
-        std::stable_sort(pixels.begin(), pixels.end());
+        // only which pixels are the brightest matters, not their order; of equally bright ones the later are taken
+        std::nth_element(pixels.begin(), pixels.begin() + bright, pixels.end(), std::greater<>());
         for (uint32_t b = 0; b < bright; ++b) {
-            uint32_t i = pixels[pixels.size() - 1 - b].second;
+            uint32_t i = pixels[b].second;
             uint32_t s = i % in_size.x;
             uint32_t t = (i / in_size.x) % in_size.x;
             uint32_t f = i / (in_size.x * in_size.x);
 
-            glm::vec3 sc; // maps to rightward axis on face
-            glm::vec3 tc; // maps to upward axis on face
-            glm::vec3 ma; // direction to face
-            // See OpenGL 4.4 Core Profile specification, Table 8.18:
-            if (f == PositiveX) {
-                sc = glm::vec3(0.0f, 0.0f, -1.0f);
-                tc = glm::vec3(0.0f, -1.0f, 0.0f);
-                ma = glm::vec3(1.0f, 0.0f, 0.0f);
-            } else if (f == NegativeX) {
-                sc = glm::vec3(0.0f, 0.0f, 1.0f);
-                tc = glm::vec3(0.0f, -1.0f, 0.0f);
-                ma = glm::vec3(-1.0f, 0.0f, 0.0f);
-            } else if (f == PositiveY) {
-                sc = glm::vec3(1.0f, 0.0f, 0.0f);
-                tc = glm::vec3(0.0f, 0.0f, 1.0f);
-                ma = glm::vec3(0.0f, 1.0f, 0.0f);
-            } else if (f == NegativeY) {
-                sc = glm::vec3(1.0f, 0.0f, 0.0f);
-                tc = glm::vec3(0.0f, 0.0f, -1.0f);
-                ma = glm::vec3(0.0f, -1.0f, 0.0f);
-            } else if (f == PositiveZ) {
-                sc = glm::vec3(1.0f, 0.0f, 0.0f);
-                tc = glm::vec3(0.0f, -1.0f, 0.0f);
-                ma = glm::vec3(0.0f, 0.0f, 1.0f);
-            } else if (f == NegativeZ) {
-                sc = glm::vec3(-1.0f, 0.0f, 0.0f);
-                tc = glm::vec3(0.0f, -1.0f, 0.0f);
-                ma = glm::vec3(0.0f, 0.0f, -1.0f);
-            } else
-                assert(0 && "Invalid face.");
+            glm::vec3 sc, tc, ma;
+            face_axes(f, sc, tc, ma);
 
             glm::vec3 dir = glm::normalize(ma
                 + (2.0f * (s + 0.5f) / in_size.x - 1.0f) * sc
@@ -201,6 +315,9 @@ void blur_cube(std::string mode, glm::ivec2& out_size, int32_t& samples, std::st
 
             in_data[i] = glm::vec3(0.0f, 0.0f, 0.0f); // remove from input data
         }
+        if (!bright_directions.empty()) {
+            build_bright_clusters(bright_directions, 0, uint32_t(bright_directions.size()), bright_clusters);
+        }
         std::cout << " done." << std::endl;
     }
 
@@ -267,50 +384,24 @@ void blur_cube(std::string mode, glm::ivec2& out_size, int32_t& samples, std::st
         return in_data[(f * in_size.x + t) * in_size.x + s];
     };
 
-    std::vector<glm::vec3> out_data;
-    out_data.reserve(out_size.x * out_size.y);
+    // every texel only depends on its own random numbers, rows of all faces are sampled in parallel
+    uint32_t const size = uint32_t(out_size.x);
+    std::vector<glm::vec3> out_data(6 * size * size);
 
-    std::cout << "Using " << samples << " samples per texel." << std::endl;
-
-    for (uint32_t f = 0; f < 6; ++f) {
-        std::cout << "Sampling face " << f << "/6 ...";
-        std::cout.flush();
-        glm::vec3 sc; // maps to rightward axis on face
-        glm::vec3 tc; // maps to upward axis on face
-        glm::vec3 ma; // direction to face
-        // See OpenGL 4.4 Core Profile specification, Table 8.18:
-        if (f == PositiveX) {
-            sc = glm::vec3(0.0f, 0.0f, -1.0f);
-            tc = glm::vec3(0.0f, -1.0f, 0.0f);
-            ma = glm::vec3(1.0f, 0.0f, 0.0f);
-        } else if (f == NegativeX) {
-            sc = glm::vec3(0.0f, 0.0f, 1.0f);
-            tc = glm::vec3(0.0f, -1.0f, 0.0f);
-            ma = glm::vec3(-1.0f, 0.0f, 0.0f);
-        } else if (f == PositiveY) {
-            sc = glm::vec3(1.0f, 0.0f, 0.0f);
-            tc = glm::vec3(0.0f, 0.0f, 1.0f);
-            ma = glm::vec3(0.0f, 1.0f, 0.0f);
-        } else if (f == NegativeY) {
-            sc = glm::vec3(1.0f, 0.0f, 0.0f);
-            tc = glm::vec3(0.0f, 0.0f, -1.0f);
-            ma = glm::vec3(0.0f, -1.0f, 0.0f);
-        } else if (f == PositiveZ) {
-            sc = glm::vec3(1.0f, 0.0f, 0.0f);
-            tc = glm::vec3(0.0f, -1.0f, 0.0f);
-            ma = glm::vec3(0.0f, 0.0f, 1.0f);
-        } else if (f == NegativeZ) {
-            sc = glm::vec3(-1.0f, 0.0f, 0.0f);
-            tc = glm::vec3(0.0f, -1.0f, 0.0f);
-            ma = glm::vec3(0.0f, 0.0f, -1.0f);
-        } else
-            assert(0 && "Invalid face.");
-
-        for (uint32_t t = 0; t < uint32_t(out_size.x); ++t) {
-            for (uint32_t s = 0; s < uint32_t(out_size.x); ++s) {
+    std::cout << "Sampling 6 faces with " << samples << " samples per texel...";
+    std::cout.flush();
+    EngineCore::JobSystem::GetInstance().ParallelFor("blur_cube", 6 * size, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t row = begin; row < end; ++row) {
+            uint32_t f = row / size;
+            uint32_t t = row % size;
+            glm::vec3 sc, tc, ma;
+            face_axes(f, sc, tc, ma);
+
+            for (uint32_t s = 0; s < size; ++s) {
+                uint32_t texel = row * size + s;
                 glm::vec3 N = glm::normalize(ma
-                    + (2.0f * (s + 0.5f) / out_size.x - 1.0f) * sc
-                    + (2.0f * (t + 0.5f) / out_size.x - 1.0f) * tc);
+                    + (2.0f * (s + 0.5f) / size - 1.0f) * sc
+                    + (2.0f * (t + 0.5f) / size - 1.0f) * tc);
                 glm::vec3 temp = (abs(N.z) < 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f));
                 glm::vec3 TX = glm::normalize(glm::cross(N, temp));
                 glm::vec3 TY = glm::cross(N, TX);
@@ -319,7 +410,7 @@ void blur_cube(std::string mode, glm::ivec2& out_size, int32_t& samples, std::st
                 for (uint32_t i = 0; i < uint32_t(samples); ++i) {
                     // very inspired by the SampleGGX code in "Real Shading in Unreal" (https://cdn2.unrealengine.com/Resources/files/2013SiggraphPresentationsNotes-26915738.pdf):
 
-                    glm::vec3 dir = make_sample();
+                    glm::vec3 dir = make_sample(sample_random(texel, i));
 
                     acc += lookup(dir.x * TX + dir.y * TY + dir.z * N);
                     // acc += (dir.x * TX + dir.y * TY + dir.z * N) * 0.5f + 0.5f; //DEBUG
@@ -328,11 +419,11 @@ void blur_cube(std::string mode, glm::ivec2& out_size, int32_t& samples, std::st
                 if (sum_bright_directions) {
                     acc += sum_bright_directions(N);
                 }
-                out_data.emplace_back(acc);
+                out_data[texel] = acc;
             }
         }
-        std::cout << " done." << std::endl;
-    }
+    });
+    std::cout << " done." << std::endl;
 
     // write a single +x/-x/+y/-y/+z/-z (all stacked in a column with +x at the bottom) file for storage:
     std::cout << "Writing final rgbe png...";
@@ -211,7 +211,7 @@ JsonValue JsonValue::parseNumber(const std::string& json, size_t& pos)
     }
 
     std::string_view numberStr(json.data() + startPos, pos - startPos);
-    if (numberStr.find('.') != std::string_view::npos) { // Float
+    if (numberStr.find_first_of(".eE") != std::string_view::npos) { // Float, also 1e+06 as streams write it
         try {
             float value = std::stof(std::string(numberStr));
             return JsonValue(value);
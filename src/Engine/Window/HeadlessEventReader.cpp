@@ -0,0 +1,185 @@
+#include "HeadlessEventReader.hpp"
+
+#include <charconv>
+
+static std::string_view NextToken(std::string_view& line)
+{
+    size_t begin = line.find_first_not_of(" \t");
+    if (begin == std::string_view::npos) {
+        line = {};
+        return {};
+    }
+    size_t end = line.find_first_of(" \t", begin);
+    std::string_view token = line.substr(begin, end == std::string_view::npos ? std::string_view::npos : end - begin);
+    line.remove_prefix(end == std::string_view::npos ? line.size() : end);
+    return token;
+}
+
+void HeadlessEventReader::Open(const std::string& eventsPath)
+{
+    m_eventsPath = eventsPath;
+    m_file.open(eventsPath, std::ios::in | std::ios::binary);
+    if (!m_file)
+        throw std::runtime_error("Failed to open headless events file: " + eventsPath);
+}
+
+const HeadlessEvent* HeadlessEventReader::Peek()
+{
+    if (m_events.size() < kMinBufferedEvents)
+        Refill();
+    return m_events.empty() ? nullptr : &m_events.front();
+}
+
+void HeadlessEventReader::Pop()
+{
+    const HeadlessEvent& event = m_events.front();
+    if (event.text != HeadlessEvent::kNoText)
+        Release(event.text);
+    m_lastPoppedTs = event.ts;
+    m_events.pop_front();
+}
+
+void HeadlessEventReader::Refill()
+{
+    while (!m_endOfFile && m_events.size() < kMinBufferedEvents)
+        ParseChunk();
+}
+
+void HeadlessEventReader::ParseChunk()
+{
+    size_t leftover = m_chunk.size();
+    m_chunk.resize(leftover + kChunkSize);
+    m_file.read(m_chunk.data() + leftover, kChunkSize);
+    size_t size = leftover + static_cast<size_t>(m_file.gcount());
+    m_chunk.resize(size);
+    if (!m_file)
+        m_endOfFile = true;
+
+    // Complete lines only, a partial line waits for the next chunk unless the file ended
+    const char* pData = m_chunk.data();
+    size_t lineStart = 0;
+    while (lineStart < size) {
+        const void* pNewline = std::memchr(pData + lineStart, '\n', size - lineStart);
+        if (!pNewline)
+            break;
+        size_t lineEnd = static_cast<const char*>(pNewline) - pData;
+        ParseLine(std::string_view(pData + lineStart, lineEnd - lineStart));
+        lineStart = lineEnd + 1;
+    }
+    if (m_endOfFile && lineStart < size) {
+        ParseLine(std::string_view(pData + lineStart, size - lineStart));
+        lineStart = size;
+    }
+    m_chunk.erase(m_chunk.begin(), m_chunk.begin() + lineStart);
+}
+
+void HeadlessEventReader::ParseLine(std::string_view line)
+{
+    m_lineNumber++;
+    if (!line.empty() && line.back() == '\r')
+        line.remove_suffix(1);
+
+    std::string_view tsToken = NextToken(line);
+    if (tsToken.empty())
+        return;
+
+    auto malformed = [this](const std::string& what) {
+        return std::runtime_error(m_eventsPath + ":" + std::to_string(m_lineNumber) + ": " + what);
+    };
+
+    HeadlessEvent event { .ts = 0, .type = HeadlessEventType::AVAILABLE };
+    auto [pEnd, error] = std::from_chars(tsToken.data(), tsToken.data() + tsToken.size(), event.ts);
+    if (error != std::errc() || pEnd != tsToken.data() + tsToken.size())
+        throw malformed("invalid timestamp " + std::string(tsToken));
+    event.type = StringToEventType(NextToken(line));
+
+    switch (event.type) {
+    case HeadlessEventType::AVAILABLE:
+        break;
+    case HeadlessEventType::PLAY: {
+        auto parseFloat = [&](std::string_view token) {
+            // strtof needs a terminated string, the chunk is not
+            std::array<char, 64> buffer {};
+            if (token.empty() || token.size() >= buffer.size())
+                throw malformed("PLAY expects a time and a rate");
+            std::memcpy(buffer.data(), token.data(), token.size());
+            char* pParseEnd = nullptr;
+            float value = std::strtof(buffer.data(), &pParseEnd);
+            if (pParseEnd != buffer.data() + token.size())
+                throw malformed("invalid number " + std::string(token));
+            return value;
+        };
+        event.playbackTime = parseFloat(NextToken(line));
+        event.playbackRate = parseFloat(NextToken(line));
+        break;
+    }
+    case HeadlessEventType::SAVE: {
+        std::string_view path = NextToken(line);
+        if (path.empty())
+            throw malformed("SAVE expects a path");
+        event.text = Intern(path);
+        break;
+    }
+    case HeadlessEventType::MARK: {
+        std::string text;
+        for (std::string_view token = NextToken(line); !token.empty(); token = NextToken(line)) {
+            if (!text.empty())
+                text += ' ';
+            text += token;
+        }
+        event.text = Intern(text);
+        break;
+    }
+    }
+
+    if (m_lastPoppedTs && event.ts < *m_lastPoppedTs)
+        std::cerr << m_eventsPath << ":" << m_lineNumber << ": event is earlier than one already processed, it runs late" << std::endl;
+
+    if (m_events.empty() || m_events.back().ts <= event.ts) {
+        m_events.push_back(event);
+    } else {
+        auto it = std::upper_bound(m_events.begin(), m_events.end(), event.ts, [](long long ts, const HeadlessEvent& other) { return ts < other.ts; });
+        m_events.insert(it, event);
+    }
+}
+
+uint32_t HeadlessEventReader::Intern(std::string_view text)
+{
+    auto [it, inserted] = m_strings.try_emplace(std::string(text), StringEntry { .id = 0, .references = 0 });
+    if (inserted) {
+        if (!m_freeStringIds.empty()) {
+            it->second.id = m_freeStringIds.back();
+            m_freeStringIds.pop_back();
+        } else {
+            it->second.id = static_cast<uint32_t>(m_stringsById.size());
+            m_stringsById.push_back(nullptr);
+        }
+        m_stringsById[it->second.id] = &*it;
+    }
+    it->second.references++;
+    return it->second.id;
+}
+
+void HeadlessEventReader::Release(uint32_t id)
+{
+    auto* pEntry = m_stringsById[id];
+    if (--pEntry->second.references > 0)
+        return;
+    m_stringsById[id] = nullptr;
+    m_freeStringIds.push_back(id);
+    m_strings.erase(m_strings.find(pEntry->first));
+}
+
+HeadlessEventType StringToEventType(std::string_view eventStr)
+{
+    if (eventStr == "AVAILABLE")
+        return HeadlessEventType::AVAILABLE;
+    if (eventStr == "PLAY")
+        return HeadlessEventType::PLAY;
+    if (eventStr == "SAVE")
+        return HeadlessEventType::SAVE;
+    if (eventStr == "MARK")
+        return HeadlessEventType::MARK;
+    // Add more event types as needed
+    throw std::runtime_error("Unknown event type: " + std::string(eventStr));
+}
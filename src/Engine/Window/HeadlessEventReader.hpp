@@ -0,0 +1,69 @@
+#pragma once
+#include "pch.hpp"
+
+#include <unordered_map>
+
+enum class HeadlessEventType : uint8_t {
+    AVAILABLE,
+    PLAY,
+    SAVE,
+    MARK
+};
+
+HeadlessEventType StringToEventType(std::string_view eventStr);
+
+struct HeadlessEvent {
+    static constexpr uint32_t kNoText = std::numeric_limits<uint32_t>::max();
+
+    long long ts; // Timestamp in microseconds
+    HeadlessEventType type; // The type of the event
+    float playbackTime = 0.0f; // PLAY
+    float playbackRate = 0.0f; // PLAY
+    uint32_t text = kNoText; // SAVE path or MARK text, see HeadlessEventReader::GetText
+};
+
+// Streams a headless events file ("<ts> <TYPE> <params...>" per line) in fixed size chunks and keeps a bounded window of parsed
+// events, so memory does not grow with the length of the script. Timestamps are expected to be non-decreasing; lines that are
+// slightly out of order are sorted into the buffered window, events with the same timestamp keep their order in the file.
+// SAVE paths and MARK texts are interned while buffered events reference them, a stream written by many SAVE events is stored once.
+class HeadlessEventReader {
+public:
+    void Open(const std::string& eventsPath);
+
+    // Next event in timestamp order, nullptr once the file is exhausted. Valid until the next Peek() or Pop().
+    const HeadlessEvent* Peek();
+    void Pop();
+    bool Empty() { return Peek() == nullptr; }
+
+    const std::string& GetText(const HeadlessEvent& event) const { return m_stringsById[event.text]->first; }
+
+private:
+    struct StringEntry {
+        uint32_t id;
+        uint32_t references; // Buffered events using the string
+    };
+
+    // Parses chunks until enough events are buffered or the file ends
+    void Refill();
+    void ParseChunk();
+    void ParseLine(std::string_view line);
+    uint32_t Intern(std::string_view text);
+    void Release(uint32_t id);
+
+private:
+    static constexpr size_t kChunkSize = 64 * 1024;
+    static constexpr size_t kMinBufferedEvents = 1024;
+
+    std::string m_eventsPath;
+    std::ifstream m_file;
+    bool m_endOfFile = false;
+    std::vector<char> m_chunk; // Unparsed bytes, starts at a line
+    size_t m_lineNumber = 0;
+
+    std::deque<HeadlessEvent> m_events;
+    std::optional<long long> m_lastPoppedTs;
+
+    std::unordered_map<std::string, StringEntry> m_strings;
+    std::vector<std::pair<const std::string, StringEntry>*> m_stringsById; // nullptr once released
+    std::vector<uint32_t> m_freeStringIds;
+};
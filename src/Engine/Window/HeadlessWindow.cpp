@@ -1,4 +1,5 @@
 #include "HeadlessWindow.hpp"
+#include "Utilities/Metrics.hpp"
 
 void HeadlessWindow::Create(const std::string& title, int width, int height, EngineCore::IApp& app)
 {
@@ -8,6 +9,9 @@ void HeadlessWindow::Create(const std::string& title, int width, int height, Eng
 
     m_startTime = std::chrono::high_resolution_clock::now();
     m_lastUpdateTime = m_startTime;
+
+    m_virtualTime = app.args.virtualTime;
+    m_saveLatency = app.args.pipelined ? 2 : 1;
 }
 void HeadlessWindow::Destroy()
 {
@@ -15,20 +19,88 @@ void HeadlessWindow::Destroy()
 
 void HeadlessWindow::Update()
 {
+    if (m_virtualTime) {
+        UpdateVirtualTime();
+        return;
+    }
+
+    // SAVE captures the frame recorded last. Pipelined, that frame was simulated one step before the one the serial mode would
+    // capture, so the saves wait for one more frame.
+    const uint32_t saveDelay = m_saveLatency - 1;
+    FlushPendingSaves(saveDelay);
+
     auto currentTime = std::chrono::high_resolution_clock::now();
     auto elapsedTime = std::chrono::duration_cast<std::chrono::microseconds>(currentTime - m_startTime).count();
 
-    while (!events.empty() && events.front().ts <= elapsedTime) {
-        ProcessEvent(events.front());
-        events.erase(events.begin());
+    std::vector<std::string> saves;
+    for (const HeadlessEvent* pEvent = m_events.Peek(); pEvent && pEvent->ts <= elapsedTime; pEvent = m_events.Peek()) {
+        if (saveDelay > 0 && pEvent->type == HeadlessEventType::SAVE)
+            saves.push_back(m_events.GetText(*pEvent));
+        else
+            ProcessEvent(*pEvent);
+        m_events.Pop();
     }
+    if (saveDelay > 0)
+        m_pendingSaves.push_back(std::move(saves));
 
     m_lastUpdateTime = currentTime;
 }
 
+void HeadlessWindow::FlushPendingSaves(uint32_t latency)
+{
+    if (latency > 0 && m_pendingSaves.size() == latency) {
+        for (const auto& savePath : m_pendingSaves.front())
+            m_app->SaveFrame(savePath);
+        m_pendingSaves.pop_front();
+    }
+}
+
+void HeadlessWindow::UpdateVirtualTime()
+{
+    // The frame simulated at the timestamp of these SAVE events is the one recorded last
+    FlushPendingSaves(m_saveLatency);
+
+    std::vector<std::string> saves;
+    m_frameDeltaTime = 0.0f;
+    if (const HeadlessEvent* pEvent = m_events.Peek()) {
+        long long frameTime = pEvent->ts;
+        m_frameDeltaTime = static_cast<float>(static_cast<double>(std::max(frameTime - m_virtualTimeUs, 0LL)) * 1e-6);
+        m_virtualTimeUs = frameTime;
+
+        for (; pEvent && pEvent->ts == frameTime; pEvent = m_events.Peek()) {
+            if (pEvent->type == HeadlessEventType::SAVE) {
+                saves.push_back(m_events.GetText(*pEvent));
+            } else {
+                // PLAY sets the animation time of this timestamp, stepping past it would skip ahead
+                if (pEvent->type == HeadlessEventType::PLAY)
+                    m_frameDeltaTime = 0.0f;
+                ProcessEvent(*pEvent);
+            }
+            m_events.Pop();
+        }
+    }
+    m_pendingSaves.push_back(std::move(saves));
+}
+
+std::optional<float> HeadlessWindow::GetFrameDeltaTime() const
+{
+    if (!m_virtualTime)
+        return std::nullopt;
+    return m_frameDeltaTime;
+}
+
+std::optional<std::chrono::high_resolution_clock::time_point> HeadlessWindow::GetNextEventTime()
+{
+    // Virtual time never waits for the clock
+    const HeadlessEvent* pEvent = m_virtualTime ? nullptr : m_events.Peek();
+    if (!pEvent)
+        return std::nullopt;
+    return m_startTime + std::chrono::microseconds(pEvent->ts);
+}
+
 bool HeadlessWindow::ShouldClose()
 {
-    return events.empty();
+    return m_events.Empty() && std::all_of(m_pendingSaves.begin(), m_pendingSaves.end(), [](const auto& saves) { return saves.empty(); });
 }
 
 void HeadlessWindow::GetWindowSize(int& width, int& height) const
@@ -47,33 +119,6 @@ bool HeadlessWindow::IsHeadless() const
     return true;
 }
 
-void HeadlessWindow::ParseEvents()
-{
-    std::ifstream eventsFile(m_eventsPath);
-    std::string line;
-
-    while (getline(eventsFile, line)) {
-        std::istringstream iss(line);
-        long long ts;
-        std::string eventStr;
-        std::vector<std::string> params;
-
-        iss >> ts >> eventStr;
-
-        // Convert the event string to an event type
-        HeadlessEventType eventType = StringToEventType(eventStr);
-
-        // Read remaining parameters into params vector
-        std::copy(std::istream_iterator<std::string>(iss),
-            std::istream_iterator<std::string>(),
-            std::back_inserter(params));
-
-        events.emplace_back(ts, eventType, params);
-    }
-
-    std::sort(events.begin(), events.end());
-}
-
 void HeadlessWindow::ProcessEvent(const HeadlessEvent& event)
 {
     switch (event.type) {
@@ -81,37 +126,14 @@ void HeadlessWindow::ProcessEvent(const HeadlessEvent& event)
         m_app->PresentImage();
         break;
     case HeadlessEventType::PLAY: // Set animation playback time and rate
-    {
-        // std::cout<< "PLAY " << event.params[0] << " " << event.params[1] << std::endl;
-        float playbackTime = std::stof(event.params[0]);
-        float playbackRate = std::stof(event.params[1]);
-        m_app->SetPlaybackTimeAndRate(playbackTime, playbackRate);
+        m_app->SetPlaybackTimeAndRate(event.playbackTime, event.playbackRate);
         break;
-    }
-    case HeadlessEventType::SAVE: // Save the current frame as a PPM file
-        // std::cout << "SAVE " << event.params[0] << std::endl;
-        m_app->SaveFrame(event.params[0]);
+    case HeadlessEventType::SAVE: // Save the current frame, the format follows the extension (see Utility::FrameSinks)
+        m_app->SaveFrame(m_events.GetText(event));
         break;
     case HeadlessEventType::MARK: // Output a debug mark
-        std::cout << "MARK ";
-        for (auto& param : event.params) {
-            std::cout << param << " ";
-        }
-        std::cout << std::endl;
+        std::cout << "MARK " << m_events.GetText(event) << std::endl;
+        Utility::FrameMetrics::GetInstance().BeginSegment(m_events.GetText(event));
         break;
     }
 }
-
-HeadlessEventType StringToEventType(const std::string& eventStr)
-{
-    if (eventStr == "AVAILABLE")
-        return HeadlessEventType::AVAILABLE;
-    if (eventStr == "PLAY")
-        return HeadlessEventType::PLAY;
-    if (eventStr == "SAVE")
-        return HeadlessEventType::SAVE;
-    if (eventStr == "MARK")
-        return HeadlessEventType::MARK;
-    // Add more event types as needed
-    throw std::runtime_error("Unknown event type: " + eventStr);
-}
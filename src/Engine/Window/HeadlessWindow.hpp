@@ -1,37 +1,14 @@
 #pragma once
+#include "HeadlessEventReader.hpp"
 #include "IWindow.hpp"
 #include "pch.hpp"
 
-enum class HeadlessEventType {
-    AVAILABLE,
-    PLAY,
-    SAVE,
-    MARK
-};
-
-HeadlessEventType StringToEventType(const std::string& eventStr);
-
-struct HeadlessEvent {
-    long long ts; // Timestamp in microseconds
-    HeadlessEventType type; // The type of the event
-    std::vector<std::string> params; // Event parameters
-
-    HeadlessEvent(long long ts, HeadlessEventType type, std::vector<std::string> params)
-        : ts(ts)
-        , type(type)
-        , params(std::move(params)) {};
-    bool operator<(const HeadlessEvent& other) const
-    {
-        return ts < other.ts;
-    }
-};
-
 class HeadlessWindow : public IWindow {
 public:
     HeadlessWindow(std::string eventsPath)
         : m_eventsPath(eventsPath)
     {
-        ParseEvents();
+        m_events.Open(m_eventsPath);
     };
     virtual void Create(const std::string& title, int width, int height, EngineCore::IApp& app) override;
     virtual void Destroy() override;
@@ -40,12 +17,16 @@ public:
     virtual void GetWindowSize(int& width, int& height) const override;
     virtual std::optional<VkSurfaceKHR> CreateSurface(VkInstance instance) override;
     bool IsHeadless() const override;
+    std::optional<float> GetFrameDeltaTime() const override;
+    std::optional<std::chrono::high_resolution_clock::time_point> GetNextEventTime() override;
 
 private:
-    void ParseEvents();
-    std::vector<HeadlessEvent> events;
+    HeadlessEventReader m_events;
 
-    void ProcessEvent(const HeadlessEvent& param1);
+    void ProcessEvent(const HeadlessEvent& event);
+    void UpdateVirtualTime();
+    // Saves the oldest pending frame's SAVE paths once latency Updates have been queued
+    void FlushPendingSaves(uint32_t latency);
 
 private:
     std::string m_eventsPath;
@@ -57,4 +38,13 @@ private:
 private:
     std::chrono::high_resolution_clock::time_point m_startTime;
     std::chrono::high_resolution_clock::time_point m_lastUpdateTime;
+
+    // Virtual time (--virtual-time): every Update jumps to the next event timestamp and the frame simulated after it lands exactly
+    // there. SAVE events are held back until that frame has been recorded.
+    bool m_virtualTime = false;
+    long long m_virtualTimeUs = 0; // Timestamp of the frame being simulated
+    float m_frameDeltaTime = 0.0f;
+    uint32_t m_saveLatency = 1; // Updates until the frame simulated after an Update is recorded, 2 when pipelined
+    std::deque<std::vector<std::string>> m_pendingSaves; // SAVE paths of the last m_saveLatency frames, oldest first
+    // With wall-clock time the pipelined mode holds SAVE events back one Update too, see Update()
 };
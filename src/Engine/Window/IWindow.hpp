@@ -13,4 +13,8 @@ public:
     virtual std::optional<VkSurfaceKHR> CreateSurface(VkInstance instance) = 0; // For Vulkan surface creation
     virtual ~IWindow() = default;
     virtual bool IsHeadless() const = 0;
+    // Simulation time step of the coming frame, nullopt steps by the wall clock
+    virtual std::optional<float> GetFrameDeltaTime() const { return std::nullopt; }
+    // When Update() next has something to process, nullopt if the window cannot tell
+    virtual std::optional<std::chrono::high_resolution_clock::time_point> GetNextEventTime() { return std::nullopt; }
 };
@@ -0,0 +1,363 @@
+#include "Benchmark.hpp"
+
+#include <cmath>
+#include <iomanip>
+
+using Utility::json::JsonValue;
+
+namespace Benchmark {
+
+// Options the matrix sets on every run, from -bench-<option> or else the option itself, never forwarded as they are
+static const std::set<std::string> kMatrixArgs = { "scene", "headless", "culling", "frames-in-flight", "threads", "pipelined", "metrics-output" };
+
+struct Config {
+    std::string name;
+    std::vector<std::string> args;
+};
+
+// name -> one value per successful run
+using Samples = std::map<std::string, std::vector<double>>;
+
+struct ConfigResults {
+    std::string name;
+    Samples samples;
+    int failures = 0;
+};
+
+struct Summary {
+    size_t count = 0;
+    double mean = 0.0;
+    double variance = 0.0; // Sample variance
+};
+
+static Summary Summarize(const std::vector<double>& values)
+{
+    Summary summary { .count = values.size() };
+    if (values.empty())
+        return summary;
+    for (double value : values)
+        summary.mean += value;
+    summary.mean /= values.size();
+    if (values.size() > 1) {
+        for (double value : values)
+            summary.variance += (value - summary.mean) * (value - summary.mean);
+        summary.variance /= values.size() - 1;
+    }
+    return summary;
+}
+
+// Two sided 95% quantile of Student's t distribution
+static double StudentT975(double degreesOfFreedom)
+{
+    static constexpr double kTable[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+    };
+    if (!std::isfinite(degreesOfFreedom))
+        return 1.960;
+    if (degreesOfFreedom < 31.0)
+        return kTable[std::clamp(static_cast<int>(degreesOfFreedom), 1, 30) - 1]; // Rounding down stays conservative
+    // Cornish-Fisher expansion around the normal quantile
+    double z = 1.959964, z3 = z * z * z, z5 = z3 * z * z;
+    double df = degreesOfFreedom;
+    return z + (z3 + z) / (4 * df) + (5 * z5 + 16 * z3 + 3 * z) / (96 * df * df);
+}
+
+static std::string QuoteArgument(const std::string& argument)
+{
+#ifdef _WIN32
+    return "\"" + argument + "\"";
+#else
+    std::string quoted = "'";
+    for (char c : argument) {
+        if (c == '\'')
+            quoted += "'\\''";
+        else
+            quoted += c;
+    }
+    return quoted + "'";
+#endif
+}
+
+// Configuration names are written to the results unescaped and matched by the compare mode
+static std::string MakeLabel(std::string text)
+{
+    std::replace(text.begin(), text.end(), '\\', '/');
+    std::erase(text, '"');
+    return text;
+}
+
+// Values of a matrix dimension. Without -bench-<option> the value of the plain option, so the runs get it and the configuration
+// names record it; a single empty value when neither is given so the run keeps the default.
+static std::vector<std::string> GetValues(const Utility::ArgsParser& argsParser, const std::string& option)
+{
+    auto arg = argsParser.GetArg("bench-" + option);
+    if (!arg.has_value() || arg.value().empty())
+        arg = argsParser.GetArg(option);
+    if (!arg.has_value() || arg.value().empty())
+        return { "" };
+    return arg.value();
+}
+
+static std::vector<Config> BuildConfigs(const Utility::ArgsParser& argsParser)
+{
+    auto scenes = argsParser.GetArg("bench-scenes");
+    if (!scenes.has_value() || scenes.value().empty())
+        scenes = argsParser.GetArg("scene");
+    if (!scenes.has_value() || scenes.value().empty())
+        throw std::runtime_error("--bench needs -bench-scenes or -scene.");
+
+    auto events = argsParser.GetArg("bench-events");
+    if (!events.has_value() || events.value().empty())
+        events = argsParser.GetArg("headless");
+    if (!events.has_value() || events.value().empty())
+        throw std::runtime_error("--bench needs -bench-events or -headless.");
+
+    std::vector<Config> configs;
+    for (const auto& scene : scenes.value())
+        configs.push_back({ .name = "scene=" + MakeLabel(scene), .args = { "-scene", scene, "-headless", events.value()[0] } });
+
+    // Every dimension multiplies the configurations so far
+    auto expand = [&configs](const std::vector<std::string>& values, const std::string& label, auto&& appendArgs) {
+        std::vector<Config> expanded;
+        for (const auto& config : configs) {
+            for (const auto& value : values) {
+                Config next = config;
+                if (!value.empty()) {
+                    next.name += " " + label + "=" + MakeLabel(value);
+                    appendArgs(next.args, value);
+                }
+                expanded.push_back(std::move(next));
+            }
+        }
+        configs = std::move(expanded);
+    };
+    auto appendOption = [](const std::string& option) {
+        return [option](std::vector<std::string>& args, const std::string& value) {
+            args.push_back("-" + option);
+            args.push_back(value);
+        };
+    };
+
+    expand(GetValues(argsParser, "culling"), "culling", appendOption("culling"));
+    expand(GetValues(argsParser, "frames-in-flight"), "frames-in-flight", appendOption("frames-in-flight"));
+    expand(GetValues(argsParser, "threads"), "threads", appendOption("threads"));
+    // --pipelined is a flag, it stands for -bench-threading pipelined
+    std::vector<std::string> threading = GetValues(argsParser, "threading");
+    if (threading == std::vector<std::string> { "" } && argsParser.GetArg("pipelined").has_value())
+        threading = { "pipelined" };
+    expand(threading, "threading", [](std::vector<std::string>& args, const std::string& value) {
+        if (value == "pipelined")
+            args.push_back("--pipelined");
+        else if (value != "serial")
+            throw std::runtime_error("Unknown -bench-threading value: " + value + " (serial or pipelined).");
+    });
+    return configs;
+}
+
+// The whole run statistics of a -metrics-output json file
+static Samples ReadRunMetrics(const std::filesystem::path& path)
+{
+    JsonValue metrics = JsonValue::parseJsonFromFile(path.string());
+    const JsonValue& total = metrics["total"];
+    const JsonValue& frame = total["frame_us"];
+
+    Samples samples;
+    samples["fps"] = { total["fps"].getFloat() };
+    for (const char* key : { "mean", "p50", "p90", "p95", "p99" })
+        samples[std::string("frame_") + key + "_us"] = { frame[key].getFloat() };
+    for (const auto& [phase, stats] : total["phases"].getObject()) {
+        if (stats["count"].getFloat() > 0)
+            samples[phase + "_mean_us"] = { stats["mean_us"].getFloat() };
+    }
+    return samples;
+}
+
+static void WriteResults(const std::filesystem::path& path, int repetitions, const std::vector<ConfigResults>& results)
+{
+    std::ofstream output(path, std::ios::trunc);
+    if (!output)
+        throw std::runtime_error("Failed to open " + path.string());
+
+    output << std::setprecision(9) << "{\"repetitions\":" << repetitions << ",\"configs\":[";
+    for (size_t i = 0; i < results.size(); i++) {
+        output << (i ? "," : "") << "\n{\"name\":\"" << results[i].name << "\",\"failures\":" << results[i].failures << ",\"samples\":{";
+        bool isFirstMetric = true;
+        for (const auto& [metric, values] : results[i].samples) {
+            output << (isFirstMetric ? "" : ",") << "\"" << metric << "\":[";
+            for (size_t j = 0; j < values.size(); j++)
+                output << (j ? "," : "") << values[j];
+            output << "]";
+            isFirstMetric = false;
+        }
+        output << "}}";
+    }
+    output << "\n]}\n";
+}
+
+static std::vector<ConfigResults> ReadResults(const std::string& path)
+{
+    JsonValue json = JsonValue::parseJsonFromFile(path);
+    std::vector<ConfigResults> results;
+    for (const auto& config : json["configs"].getArray()) {
+        ConfigResults& result = results.emplace_back();
+        result.name = config["name"].getString();
+        result.failures = config["failures"].getInt();
+        for (const auto& [metric, values] : config["samples"].getObject()) {
+            auto& samples = result.samples[metric];
+            for (const auto& value : values.getArray())
+                samples.push_back(value.getFloat());
+        }
+    }
+    return results;
+}
+
+int Run(const Utility::ArgsParser& argsParser)
+{
+    std::vector<Config> configs = BuildConfigs(argsParser);
+
+    int repetitions = 5;
+    auto repeatArg = argsParser.GetArg("bench-repeat");
+    if (repeatArg.has_value() && !repeatArg.value().empty())
+        repetitions = std::max(1, std::stoi(repeatArg.value()[0]));
+
+    std::filesystem::path outputPath = "bench_results.json";
+    auto outputArg = argsParser.GetArg("bench-output");
+    if (outputArg.has_value() && !outputArg.value().empty())
+        outputPath = outputArg.value()[0];
+    std::filesystem::path runMetricsPath = outputPath;
+    runMetricsPath.replace_extension(".run.json");
+
+    // Everything that is neither a bench option nor set by the matrix goes to every run
+    std::string baseCommand = QuoteArgument(argsParser.GetProgramPath());
+    for (const auto& [name, values] : argsParser.GetAllArgs()) {
+        if (name == "bench" || name.starts_with("bench-") || kMatrixArgs.contains(name))
+            continue;
+        if (values.empty()) {
+            baseCommand += " --" + name;
+        } else {
+            baseCommand += " -" + name;
+            for (const auto& value : values)
+                baseCommand += " " + QuoteArgument(value);
+        }
+    }
+
+    std::vector<ConfigResults> results(configs.size());
+    for (size_t i = 0; i < configs.size(); i++)
+        results[i].name = configs[i].name;
+
+    std::cout << "Benchmark: " << configs.size() << " configurations x " << repetitions << " repetitions" << std::endl;
+    for (int repetition = 0; repetition < repetitions; repetition++) {
+        for (size_t i = 0; i < configs.size(); i++) {
+            std::string command = baseCommand;
+            for (const auto& arg : configs[i].args)
+                command += " " + QuoteArgument(arg);
+            command += " -metrics-output " + QuoteArgument(runMetricsPath.string());
+#ifdef _WIN32
+            // cmd /c strips the first and the last quote of the line, which would break the quoted program path
+            command = "\"" + command + "\"";
+#endif
+
+            std::cout << "Benchmark: [" << repetition + 1 << "/" << repetitions << "] " << configs[i].name << std::endl;
+#if VERBOSE
+            std::cout << command << std::endl;
+#endif
+            std::filesystem::remove(runMetricsPath);
+            int status = std::system(command.c_str());
+            if (status != 0 || !std::filesystem::exists(runMetricsPath)) {
+                std::cerr << "Benchmark: run failed with status " << status << ": " << configs[i].name << std::endl;
+                results[i].failures++;
+                continue;
+            }
+
+            try {
+                for (const auto& [metric, values] : ReadRunMetrics(runMetricsPath))
+                    results[i].samples[metric].push_back(values[0]);
+            } catch (const std::exception& e) {
+                std::cerr << "Benchmark: unreadable metrics of " << configs[i].name << ": " << e.what() << std::endl;
+                results[i].failures++;
+            }
+        }
+    }
+    std::filesystem::remove(runMetricsPath);
+
+    WriteResults(outputPath, repetitions, results);
+    std::cout << "Benchmark: results written to " << outputPath.string() << std::endl;
+
+    bool hasSamples = false;
+    std::cout << std::fixed << std::setprecision(2);
+    for (const auto& result : results) {
+        std::cout << result.name;
+        if (result.failures)
+            std::cout << " (" << result.failures << " failed)";
+        std::cout << std::endl;
+        for (const char* metric : { "fps", "frame_mean_us", "frame_p99_us" }) {
+            auto it = result.samples.find(metric);
+            if (it == result.samples.end())
+                continue;
+            Summary summary = Summarize(it->second);
+            double halfWidth = summary.count > 1 ? StudentT975(summary.count - 1.0) * std::sqrt(summary.variance / summary.count) : 0.0;
+            std::cout << "    " << std::left << std::setw(16) << metric << std::right << std::setw(12) << summary.mean << " +- " << halfWidth << std::endl;
+            hasSamples = true;
+        }
+    }
+    std::cout << std::defaultfloat;
+    return hasSamples ? 0 : 1;
+}
+
+int Compare(const std::string& basePath, const std::string& newPath)
+{
+    std::vector<ConfigResults> baseResults = ReadResults(basePath);
+    std::vector<ConfigResults> newResults = ReadResults(newPath);
+
+    std::cout << "Change of the mean from " << basePath << " to " << newPath << ", 95% Welch confidence interval, * when it excludes 0" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    for (const auto& newResult : newResults) {
+        auto baseIt = std::find_if(baseResults.begin(), baseResults.end(), [&](const ConfigResults& result) { return result.name == newResult.name; });
+        if (baseIt == baseResults.end()) {
+            std::cout << newResult.name << ": not in " << basePath << std::endl;
+            continue;
+        }
+
+        std::cout << newResult.name << std::endl;
+        for (const auto& [metric, newValues] : newResult.samples) {
+            auto baseValuesIt = baseIt->samples.find(metric);
+            if (baseValuesIt == baseIt->samples.end())
+                continue;
+            Summary a = Summarize(baseValuesIt->second);
+            Summary b = Summarize(newValues);
+            if (a.count < 2 || b.count < 2) {
+                std::cout << "    " << std::left << std::setw(24) << metric << std::right << " needs two runs on each side" << std::endl;
+                continue;
+            }
+            if (a.mean == 0.0) {
+                std::cout << "    " << std::left << std::setw(24) << metric << std::right << std::setw(12) << a.mean << " -> " << std::setw(12) << b.mean
+                          << ", no relative change from a base mean of 0" << std::endl;
+                continue;
+            }
+
+            double difference = b.mean - a.mean;
+            double varianceA = a.variance / a.count, varianceB = b.variance / b.count;
+            double standardError = std::sqrt(varianceA + varianceB);
+            // Welch-Satterthwaite, infinite when both sides are constant
+            double denominator = varianceA * varianceA / (a.count - 1) + varianceB * varianceB / (b.count - 1);
+            double degreesOfFreedom = denominator > 0.0 ? (varianceA + varianceB) * (varianceA + varianceB) / denominator : INFINITY;
+            double halfWidth = StudentT975(degreesOfFreedom) * standardError;
+
+            auto percent = [&](double value) { return value / a.mean * 100.0; };
+            bool isSignificant = difference - halfWidth > 0.0 || difference + halfWidth < 0.0;
+            std::cout << "    " << std::left << std::setw(24) << metric << std::right << std::setw(12) << a.mean << " -> " << std::setw(12) << b.mean
+                      << std::showpos << std::setw(10) << percent(difference) << "% [" << percent(difference - halfWidth) << "%, "
+                      << percent(difference + halfWidth) << "%]" << std::noshowpos << (isSignificant ? " *" : "") << std::endl;
+        }
+    }
+    for (const auto& baseResult : baseResults) {
+        if (std::none_of(newResults.begin(), newResults.end(), [&](const ConfigResults& result) { return result.name == baseResult.name; }))
+            std::cout << baseResult.name << ": not in " << newPath << std::endl;
+    }
+    std::cout << std::defaultfloat;
+    return 0;
+}
+
+} // namespace Benchmark
@@ -0,0 +1,26 @@
+#pragma once
+#include "../Engine/pch.hpp"
+
+// Headless benchmark runner built into Main.
+//
+// --bench runs every combination of the matrix options as a child process of this executable, -bench-repeat times each, and
+// writes the per run statistics of -metrics-output to one results file (-bench-output, bench_results.json by default).
+// Repetitions are interleaved over the matrix so slow drifts of the machine spread over all configurations.
+//  -bench-scenes <s72...>           Defaults to -scene
+//  -bench-events <events>           Headless events file, defaults to -headless
+//  -bench-culling <mode...>         Values of -culling, defaults to -culling
+//  -bench-frames-in-flight <n...>   Values of -frames-in-flight, defaults to -frames-in-flight
+//  -bench-threads <n...>            Values of -threads, defaults to -threads
+//  -bench-threading <serial|pipelined...>  Defaults to --pipelined
+//  -bench-repeat <n>                Defaults to 5
+// Options that are not part of the matrix are passed on to every run.
+//
+// -bench-compare <base.json> <new.json> prints, per configuration and metric, the change of the mean from the base results with
+// its 95% Welch confidence interval.
+namespace Benchmark {
+
+// Both return the exit code of the process
+int Run(const Utility::ArgsParser& argsParser);
+int Compare(const std::string& basePath, const std::string& newPath);
+
+} // namespace Benchmark
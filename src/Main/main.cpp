@@ -1,7 +1,11 @@
 #define _CRT_SECURE_NO_WARNINGS
 #include "main.hpp"
+#include "Benchmark.hpp"
 #include "Scene/CameraManager.hpp"
 #include "Scene/Scene.hpp"
+#include "Utilities/FrameProfiler.hpp"
+#include "Utilities/Metrics.hpp"
+#include "Utilities/Trace.hpp"
 
 CREATE_APPLICATION(MainApplication)
 
@@ -29,6 +33,16 @@ void MainApplication::ParseArguments(const Utility::ArgsParser& argsParser)
         exit(0);
     }
 
+    if (argsParser.GetArg("bench")) {
+        exit(Benchmark::Run(argsParser));
+    }
+    auto benchCompareArg = argsParser.GetArg("bench-compare");
+    if (benchCompareArg.has_value()) {
+        if (benchCompareArg.value().size() != 2)
+            throw std::runtime_error("-bench-compare needs two result files.");
+        exit(Benchmark::Compare(benchCompareArg.value()[0], benchCompareArg.value()[1]));
+    }
+
     // if (argsParser.GetArg("get-device-info")) {
     //    exit(0);
     //}
@@ -45,6 +59,11 @@ void MainApplication::ParseArguments(const Utility::ArgsParser& argsParser)
         args.cameraName = cameraArg.value()[0];
     }
 
+    auto renderCamerasArg = argsParser.GetArg("render-cameras");
+    if (renderCamerasArg.has_value() && !renderCamerasArg.value().empty()) {
+        args.renderCameras = renderCamerasArg.value();
+    }
+
     auto windowSizeArg = argsParser.GetArg("drawing-size");
     if (windowSizeArg.has_value()) {
         args.windowSize.first = std::stoi(windowSizeArg.value()[0]);
@@ -56,6 +75,28 @@ void MainApplication::ParseArguments(const Utility::ArgsParser& argsParser)
         args.cullingType = cullingTypeArg.value()[0];
     }
 
+    auto lambertianArg = argsParser.GetArg("lambertian");
+    if (lambertianArg.has_value() && !lambertianArg.value().empty()) {
+        args.lambertianMode = lambertianArg.value()[0];
+        if (args.lambertianMode != "sh" && args.lambertianMode != "montecarlo")
+            throw std::runtime_error("Unknown -lambertian mode: " + args.lambertianMode + " (sh or montecarlo).");
+    }
+
+    auto iblCacheArg = argsParser.GetArg("ibl-cache");
+    if (iblCacheArg.has_value() && !iblCacheArg.value().empty()) {
+        args.iblCachePath = iblCacheArg.value()[0];
+    }
+
+    auto noIblCacheArg = argsParser.GetArg("no-ibl-cache");
+    if (noIblCacheArg.has_value()) {
+        args.iblCachePath.clear();
+    }
+
+    auto iblAssetsArg = argsParser.GetArg("ibl-assets");
+    if (iblAssetsArg.has_value()) {
+        args.iblAssetPaths = iblAssetsArg.value();
+    }
+
     auto headlessEventsPathArg = argsParser.GetArg("headless");
     if (headlessEventsPathArg.has_value()) {
         args.headlessEventsPath = headlessEventsPathArg.value()[0];
@@ -74,15 +115,101 @@ void MainApplication::ParseArguments(const Utility::ArgsParser& argsParser)
     if (headlessIgnoreSaveFrameArg.has_value()) {
         args.headlessIgnoreSaveFrame = true;
     }
+
+    auto threadsArg = argsParser.GetArg("threads");
+    if (threadsArg.has_value()) {
+        args.workerThreads = static_cast<uint32_t>(std::stoul(threadsArg.value()[0]));
+    }
+
+    auto pinThreadsArg = argsParser.GetArg("pin-threads");
+    if (pinThreadsArg.has_value()) {
+        args.pinThreads = true;
+    }
+
+    auto pipelinedArg = argsParser.GetArg("pipelined");
+    if (pipelinedArg.has_value()) {
+        args.pipelined = true;
+    }
+
+    auto uberShaderArg = argsParser.GetArg("uber-shader");
+    if (uberShaderArg.has_value()) {
+        args.uberShader = true;
+    }
+
+    auto bindlessArg = argsParser.GetArg("bindless");
+    if (bindlessArg.has_value()) {
+        args.bindless = true;
+    }
+
+    auto pipelineCacheArg = argsParser.GetArg("pipeline-cache");
+    if (pipelineCacheArg.has_value() && !pipelineCacheArg.value().empty()) {
+        args.pipelineCachePath = pipelineCacheArg.value()[0];
+    }
+
+    auto noPipelineCacheArg = argsParser.GetArg("no-pipeline-cache");
+    if (noPipelineCacheArg.has_value()) {
+        args.pipelineCachePath.clear();
+    }
+
+    auto profileOutputArg = argsParser.GetArg("profile-output");
+    if (profileOutputArg.has_value() && !profileOutputArg.value().empty()) {
+        args.profileOutputPath = profileOutputArg.value()[0];
+    }
+
+    auto depthPrepassArg = argsParser.GetArg("depth-prepass");
+    if (depthPrepassArg.has_value()) {
+        args.depthPrepass = true;
+    }
+
+    auto framesInFlightArg = argsParser.GetArg("frames-in-flight");
+    if (framesInFlightArg.has_value() && !framesInFlightArg.value().empty()) {
+        args.framesInFlight = static_cast<uint32_t>(std::stoul(framesInFlightArg.value()[0]));
+    }
+
+    auto headlessImagesArg = argsParser.GetArg("headless-images");
+    if (headlessImagesArg.has_value() && !headlessImagesArg.value().empty()) {
+        args.headlessImages = static_cast<uint32_t>(std::stoul(headlessImagesArg.value()[0]));
+    }
+
+    auto metricsOutputArg = argsParser.GetArg("metrics-output");
+    if (metricsOutputArg.has_value() && !metricsOutputArg.value().empty()) {
+        args.metricsOutputPath = metricsOutputArg.value()[0];
+    }
+
+    auto traceArg = argsParser.GetArg("trace");
+    if (traceArg.has_value() && !traceArg.value().empty()) {
+        args.traceOutputPath = traceArg.value()[0];
+    }
+
+    auto virtualTimeArg = argsParser.GetArg("virtual-time");
+    if (virtualTimeArg.has_value()) {
+        args.virtualTime = true;
+        // Every frame of the virtual timeline has to be drawn, AVAILABLE events must not hold frames back
+        if (args.limitFPS) {
+            std::cerr << "--virtual-time renders every frame, ignoring --limitfps" << std::endl;
+            args.limitFPS = false;
+        }
+    }
 }
 
 void MainApplication::Startup(void)
 {
-    m_Scene = Scene::loadSceneFromFile(args.scenePath);
+    m_Scene = Scene::loadSceneFromFile(args.scenePath, EnvironmentOptions {
+        .lambertianMode = args.lambertianMode == "montecarlo" ? ELambertianMode::MONTE_CARLO : ELambertianMode::SPHERICAL_HARMONICS,
+        .cacheDirectory = args.iblCachePath,
+        .assetDirectories = args.iblAssetPaths,
+    });
     m_Scene->RegisterEventHandlers(this);
     m_Scene->PrintStatistics();
 
     CameraManager::GetInstance().Init(this);
+
+    // Before the renderer, which only creates its queries when profiling is on
+    if (args.profileOutputPath.has_value())
+        Utility::FrameProfiler::GetInstance().Init(args.profileOutputPath.value());
+    if (args.metricsOutputPath.has_value())
+        Utility::FrameMetrics::GetInstance().Init(args.metricsOutputPath.value());
+
     m_VulkanCore.Init(this);
 }
 
@@ -91,64 +218,85 @@ void MainApplication::Cleanup(void)
     m_VulkanCore.WaitIdle();
     m_Scene->Cleanup();
     m_VulkanCore.Shutdown();
+    Utility::FrameProfiler::GetInstance().Shutdown();
+    Utility::FrameMetrics::GetInstance().Shutdown();
 }
 
 void MainApplication::Update(float deltaT)
 {
+    TRACE_ZONE("MainApplication::Update");
+    Utility::ScopedCpuTimer updateTimer(Utility::ECpuPhase::Update);
     ProcessEvents();
     CameraManager::GetInstance().Update(deltaT);
     m_Scene->Update(deltaT);
 }
 
+void MainApplication::ExtractRenderSnapshot(void)
+{
+    TRACE_ZONE("MainApplication::ExtractRenderSnapshot");
+    Utility::ScopedCpuTimer traverseTimer(Utility::ECpuPhase::Traverse);
+    m_Scene->ExtractRenderSnapshot(m_RenderSnapshots[1 - m_FrontSnapshotIndex]);
+}
+
+void MainApplication::PublishRenderSnapshot(void)
+{
+    auto& backSnapshot = m_RenderSnapshots[1 - m_FrontSnapshotIndex];
+    if (!backSnapshot.isValid)
+        return; // Nothing extracted yet, keep drawing the old one
+
+    backSnapshot.frameIndex = m_RenderSnapshots[m_FrontSnapshotIndex].frameIndex + 1;
+    m_FrontSnapshotIndex = 1 - m_FrontSnapshotIndex;
+    m_RenderSnapshots[1 - m_FrontSnapshotIndex].isValid = false;
+}
+
 void MainApplication::RenderScene(void)
 {
-    if (args.measure)
+    if (args.measure || Utility::FrameMetrics::GetInstance().IsEnabled())
         Measure();
-    m_VulkanCore.drawFrame(*m_Scene);
+
+    const auto& snapshot = m_RenderSnapshots[m_FrontSnapshotIndex];
+    if (!snapshot.isValid)
+        return;
+    m_VulkanCore.drawFrame(snapshot);
+}
+
+bool MainApplication::IsIdle(void)
+{
+    // drawFrame skips frames until the next AVAILABLE event
+    return args.headlessEventsPath.has_value() && args.limitFPS && !m_VulkanCore.IsReadyForNextImage();
 }
 
 void MainApplication::Measure()
 {
-    static std::vector<float> frameTimes;
-    static auto lastFrameTime = std::chrono::high_resolution_clock::now();
-    static auto lastOutputTime = std::chrono::high_resolution_clock::now();
-    static float deltaOutputTime = 0.0f;
-    auto currentTime = std::chrono::high_resolution_clock::now();
-    float frameTimeInMicrosec = std::chrono::duration<float, std::chrono::microseconds::period>(currentTime - lastFrameTime).count();
-    deltaOutputTime += frameTimeInMicrosec;
-
-    if (args.headlessEventsPath) {
-        if (m_VulkanCore.readyForNextImage || !args.limitFPS) {
-            frameTimes.push_back(frameTimeInMicrosec);
-        }
-    } else {
-        frameTimes.push_back(frameTimeInMicrosec);
+    auto currentTime = std::chrono::steady_clock::now();
+    if (!m_lastFrameTime) {
+        m_lastFrameTime = currentTime;
+        return;
     }
+    auto frameTime = currentTime - *m_lastFrameTime;
 
-    // Calculate statistics every second or every N frames
-    if (deltaOutputTime >= 1000000.f) { // N is the number of frames after which you want to calculate statistics
-        float averageFrameTime = deltaOutputTime / frameTimes.size();
-        float fps = 1000000.0f / averageFrameTime;
-
-        // Sort frame times for percentile calculations
-        std::sort(frameTimes.begin(), frameTimes.end());
-        float p99 = frameTimes.at(std::lround(frameTimes.size() * 0.99) - 1);
-        float p95 = frameTimes.at(std::lround(frameTimes.size() * 0.95) - 1);
-        float p90 = frameTimes.at(std::lround(frameTimes.size() * 0.90) - 1);
+    // With -limitfps headless frames waiting for an AVAILABLE event are skipped, they are not frames
+    if (!args.headlessEventsPath || !args.limitFPS || m_VulkanCore.IsReadyForNextImage()) {
+        Utility::FrameMetrics::GetInstance().RecordFrame(frameTime);
+        if (args.measure)
+            m_measuredFrameTimes.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(frameTime).count());
+    }
 
-        // Calculate standard deviation
-        float sumOfSquaredDifferences = std::accumulate(frameTimes.begin(), frameTimes.end(), 0.0f,
-            [averageFrameTime](float acc, float ft) { return acc + (ft - averageFrameTime) * (ft - averageFrameTime); });
-        float std_dev = std::sqrt(sumOfSquaredDifferences / frameTimes.size());
+    // Print statistics every second
+    m_measureOutputTime += frameTime;
+    if (args.measure && m_measureOutputTime >= std::chrono::seconds(1) && m_measuredFrameTimes.GetCount() > 0) {
+        auto us = [](double nanoseconds) { return static_cast<float>(nanoseconds * 1e-3); };
+        float averageFrameTime = us(std::chrono::duration<double, std::nano>(m_measureOutputTime).count()) / m_measuredFrameTimes.GetCount();
+        float fps = 1000000.0f / averageFrameTime;
 
         std::cout << "FPS: " << fps << ", Avg Frame Time: " << averageFrameTime
-                  << "us , P99: " << p99 << "us , P95: " << p95 << "us , P90: " << p90
-                  << "us , Std Dev: " << std_dev << std::endl;
+                  << "us , P99: " << us(m_measuredFrameTimes.GetPercentile(99)) << "us , P95: " << us(m_measuredFrameTimes.GetPercentile(95))
+                  << "us , P90: " << us(m_measuredFrameTimes.GetPercentile(90)) << "us , Std Dev: " << us(m_measuredFrameTimes.GetStdDev()) << std::endl;
 
-        frameTimes.clear(); // Reset for next batch
-        deltaOutputTime = 0.0f;
+        m_measuredFrameTimes.Reset(); // Reset for next batch
+        m_measureOutputTime = {};
     }
-    lastFrameTime = std::chrono::high_resolution_clock::now(); // To eliminate the time taken to print statistics from the next batch
+    m_lastFrameTime = std::chrono::steady_clock::now(); // To eliminate the time taken to print statistics from the next batch
 }
 
 void MainApplication::PresentImage()
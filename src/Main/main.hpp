@@ -2,6 +2,8 @@
 #include "../Engine/EngineCore.hpp"
 #include "../Engine/Graphics/Vulkan/VulkanCore.hpp"
 #include "../Engine/Graphics/Vulkan/VulkanHelper.hpp"
+#include "../Engine/Scene/RenderSnapshot.hpp"
+#include "../Engine/Utilities/Metrics.hpp"
 #include "../Engine/pch.hpp"
 
 class MainApplication : public EngineCore::IApp {
@@ -15,8 +17,14 @@ public:
 
     void Update(float deltaT) override;
 
+    void ExtractRenderSnapshot(void) override;
+
+    void PublishRenderSnapshot(void) override;
+
     void RenderScene(void) override;
 
+    bool IsIdle(void) override;
+
     void Measure();
 
     std::pair<int, int> GetWindowSize() override { return args.windowSize; };
@@ -35,4 +43,13 @@ private:
 private:
     VulkanCore m_VulkanCore;
     std::shared_ptr<Scene> m_Scene;
+
+    // Double-buffered: the simulation extracts into the back one while the front one is rendered
+    std::array<RenderSnapshot, 2> m_RenderSnapshots;
+    uint32_t m_FrontSnapshotIndex = 0;
+
+    // Measure(): frame times of the current one second window of -measure
+    std::optional<std::chrono::steady_clock::time_point> m_lastFrameTime;
+    std::chrono::steady_clock::duration m_measureOutputTime {};
+    Utility::LogHistogram m_measuredFrameTimes;
 };
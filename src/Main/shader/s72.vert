@@ -8,8 +8,6 @@ layout(set = 0, binding = 0) uniform CameraData {
     vec4 position;
 } ubo_cam;
 
-layout (set = 1, binding = 3) uniform sampler2D NORMAL;
-
 layout(location = 0) in vec3 inPosition; 
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec4 inTangent;
@@ -25,12 +23,15 @@ struct FragData {
     vec3 bitangent;
 };
 layout(location = 0) out FragData fragData;
+layout(location = 6) flat out uint outMaterialIndex; // Only read by s72_bindless.frag
 
 layout(push_constant) uniform PushConstants {
     mat4 matWorld;
     mat4 matNormal; //transpose(inv(matWorld))
 } pushConstants;
 
+invariant gl_Position; // Same computation as s72_depth.vert, the depth pre-pass relies on matching depth
+
 
 void main() {
     fragData.position = vec3(pushConstants.matWorld * vec4(inPosition, 1.0)); // Transform position by light matrix
@@ -39,6 +40,7 @@ void main() {
     fragData.texCoord = inTexCoord;
     fragData.tangent = mat3(pushConstants.matWorld) * inTangent.rgb;
     fragData.bitangent = inTangent.w * cross(fragData.normal, fragData.tangent);
+    outMaterialIndex = uint(gl_InstanceIndex);
 
     gl_Position = ubo_cam.proj * ubo_cam.view * pushConstants.matWorld * vec4(inPosition,  1.0);
 }
\ No newline at end of file
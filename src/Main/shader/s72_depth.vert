@@ -0,0 +1,24 @@
+#version 450
+
+// Depth pre-pass (--depth-prepass): positions only, from the geometry pool's packed position stream.
+// gl_Position must match s72.vert bit for bit for the EQUAL depth test of the shading pass.
+
+layout(set = 0, binding = 0) uniform CameraData {
+    mat4 view;
+    mat4 proj;
+    mat4 viewproj;
+    vec4 position;
+} ubo_cam;
+
+layout(location = 0) in vec3 inPosition;
+
+layout(push_constant) uniform PushConstants {
+    mat4 matWorld;
+    mat4 matNormal; // Unused
+} pushConstants;
+
+invariant gl_Position;
+
+void main() {
+    gl_Position = ubo_cam.proj * ubo_cam.view * pushConstants.matWorld * vec4(inPosition,  1.0);
+}
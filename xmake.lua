@@ -17,6 +17,9 @@ target("Engine")
     add_includedirs("src/Engine")
     add_files("src/Engine/**/*.cpp")
     add_files("src/Engine/**.cpp")
+    if is_arch("x86_64", "x64", "i386", "x86") then
+        add_vectorexts("ssse3")
+    end
 
 
 target("Main")